@@ -0,0 +1,20 @@
+# stage benchmarks of the engine on a generated corpus
+
+QT       += core
+QT       -= gui
+
+TARGET = FindDuplicatesBench
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../core/core.pri)
+
+SOURCES += \
+    main.cpp \
+    corpus.cpp
+
+HEADERS += \
+    corpus.h
@@ -0,0 +1,127 @@
+#include "corpus.h"
+
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QVector>
+
+#include <cmath>
+
+#include <unistd.h>
+
+namespace {
+
+class Random {
+public:
+    explicit Random(quint64 seed) : state(seed * 0x9e3779b97f4a7c15ULL + 1) {}
+
+    quint64 next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    double uniform() {
+        return (next() >> 11) * (1.0 / (1ULL << 53));
+    }
+
+    int below(int bound) {
+        return static_cast<int>(next() % quint64(bound));
+    }
+
+private:
+    quint64 state;
+};
+
+// content is a function of its seed, copies are written from the same seed
+struct Original {
+    QString path;
+    qint64 size;
+    quint64 seed;
+};
+
+bool write_file(QString const& path, qint64 size, quint64 seed, bool flip_tail) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    Random random(seed);
+    QByteArray block(64 * 1024, Qt::Uninitialized);
+    for (qint64 written = 0; written < size; written += block.size()) {
+        auto words = reinterpret_cast<quint64*>(block.data());
+        for (int i = 0; i < block.size() / 8; i++) {
+            words[i] = random.next();
+        }
+        qint64 length = qMin<qint64>(block.size(), size - written);
+        if (flip_tail && written + length == size) {
+            block[int(length - 1)] = char(~block.at(int(length - 1)));
+        }
+        if (file.write(block.constData(), length) != length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+bool Corpus::generate(QString const& root, CorpusOptions const& options, CorpusStats& stats) {
+    Random random(options.seed);
+    stats = CorpusStats();
+
+    QStringList dirs = {root};
+    for (int level = 0, first = 0; level < options.depth; level++) {
+        int last = dirs.size();
+        for (int i = first; i < last; i++) {
+            for (int j = 0; j < options.fanout; j++) {
+                dirs.push_back(dirs[i] + "/d" + QString::number(j));
+            }
+        }
+        first = last;
+    }
+    for (auto const& dir : dirs) {
+        if (!QDir().mkpath(dir)) {
+            return false;
+        }
+    }
+    stats.directories = dirs.size();
+
+    QVector<Original> originals;
+    double log_min = std::log(double(qMax<qint64>(options.min_size, 1)));
+    double log_max = std::log(double(qMax(options.max_size, options.min_size)));
+    for (int i = 0; i < options.files; i++) {
+        QString path = dirs[random.below(dirs.size())] + "/f" + QString::number(i);
+        double kind = random.uniform();
+        bool ok;
+
+        if (!originals.empty() && kind < options.duplicate_ratio) {
+            auto const& original = originals[random.below(originals.size())];
+            ok = write_file(path, original.size, original.seed, false);
+            stats.duplicates++;
+            stats.bytes += original.size;
+        } else if (!originals.empty() && kind < options.duplicate_ratio + options.hardlink_ratio) {
+            auto const& original = originals[random.below(originals.size())];
+            ok = link(QFile::encodeName(original.path).constData(), QFile::encodeName(path).constData()) == 0;
+            stats.hardlinks++;
+        } else if (!originals.empty()
+                   && kind < options.duplicate_ratio + options.hardlink_ratio + options.tail_ratio) {
+            auto const& original = originals[random.below(originals.size())];
+            ok = write_file(path, original.size, original.seed, true);
+            stats.tails++;
+            stats.bytes += original.size;
+        } else {
+            qint64 size = options.min_size == 0 && random.below(64) == 0
+                    ? 0 : qint64(std::exp(log_min + (log_max - log_min) * random.uniform()));
+            quint64 seed = random.next();
+            ok = write_file(path, size, seed, false);
+            originals.push_back({path, size, seed});
+            stats.bytes += size;
+        }
+        if (!ok) {
+            return false;
+        }
+        stats.files++;
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <QString>
+#include <QtGlobal>
+
+struct CorpusOptions {
+    int files = 10000;
+    quint64 seed = 1;
+    // sizes are spread evenly over the orders of magnitude in between
+    qint64 min_size = 1;
+    qint64 max_size = 1 << 20;
+    // shares of the files that copy, hard link, or copy all but the last
+    // byte of an earlier file, the rest is random content
+    double duplicate_ratio = 0.2;
+    double hardlink_ratio = 0.02;
+    double tail_ratio = 0.05;
+    int depth = 3;
+    int fanout = 8;
+};
+
+struct CorpusStats {
+    int files = 0;
+    int directories = 0;
+    int duplicates = 0;
+    int hardlinks = 0;
+    int tails = 0;
+    qint64 bytes = 0;
+};
+
+// writes the same tree for the same options and seed
+class Corpus {
+public:
+    static bool generate(QString const& root, CorpusOptions const& options, CorpusStats& stats);
+};
+
+#endif // CORPUS_H
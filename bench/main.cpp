@@ -0,0 +1,377 @@
+#include "corpus.h"
+#include "dirwalker.h"
+#include "filereader.h"
+#include "flatindex.h"
+#include "scanengine.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+#include <cstdio>
+
+namespace {
+
+// one JSON object per line, rates are derived from files, bytes and msecs
+class Report {
+public:
+    Report() : out(stdout) {}
+
+    void add(QString const& bench, qint64 files, qint64 bytes, qint64 msecs, QJsonObject extra = QJsonObject()) {
+        double seconds = qMax<qint64>(msecs, 1) / 1000.0;
+        extra["bench"] = bench;
+        extra["files"] = files;
+        extra["bytes"] = bytes;
+        extra["msecs"] = msecs;
+        extra["files_per_s"] = qRound64(files / seconds);
+        extra["gb_per_s"] = bytes / seconds / 1e9;
+        out << QJsonDocument(extra).toJson(QJsonDocument::Compact) << '\n';
+        out.flush();
+    }
+
+private:
+    QTextStream out;
+};
+
+// digests of the index benchmark are random words, like real ones
+quint64 next_random(quint64& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+QVector<DigestKey> make_keys(int count) {
+    QVector<DigestKey> keys(count);
+    quint64 state = 88172645463325252ULL;
+    for (auto& key : keys) {
+        key.size = next_random(state) % (1 << 20);
+        for (int i = 0; i < Digest::width; i += 8) {
+            quint64 word = next_random(state);
+            memcpy(key.digest + i, &word, 8);
+        }
+    }
+    return keys;
+}
+
+QByteArray to_bytes(DigestKey const& key) {
+    return QByteArray::number(key.size) + ':' + QByteArray(key.digest, Digest::width);
+}
+
+// insert every key, look every key up, then remove every key
+template <typename Insert, typename Find, typename Remove>
+void run_index(Report& report, QString const& name, int count, Insert insert, Find find, Remove remove) {
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; i++) {
+        insert(i);
+    }
+    qint64 insert_ms = timer.restart();
+    qint64 found = 0;
+    for (int i = 0; i < count; i++) {
+        found += find(i);
+    }
+    qint64 find_ms = timer.restart();
+    for (int i = 0; i < count; i++) {
+        remove(i);
+    }
+    qint64 remove_ms = timer.elapsed();
+
+    report.add("index." + name, count, 0, insert_ms + find_ms + remove_ms,
+               {{"insert_msecs", insert_ms}, {"lookup_msecs", find_ms}, {"remove_msecs", remove_ms},
+                {"ok", found == count}});
+}
+
+// the flat index against the Qt containers it replaced
+void bench_index(Report& report, int count, bool skip_qt) {
+    auto keys = make_keys(count);
+    {
+        FlatIndex<DigestKey, int> index;
+        run_index(report, "flat_digest", count,
+                  [&](int i) { index.insert(keys[i], i); },
+                  [&](int i) { return index.find(keys[i]) != nullptr; },
+                  [&](int i) { index.remove(keys[i]); });
+    }
+    {
+        FlatIndex<qint64, int> index;
+        run_index(report, "flat_size", count,
+                  [&](int i) { index.insert(qint64(i) * 4099, i); },
+                  [&](int i) { return index.find(qint64(i) * 4099) != nullptr; },
+                  [&](int i) { index.remove(qint64(i) * 4099); });
+    }
+    if (skip_qt) { return; }
+
+    QVector<QByteArray> bytes(count);
+    for (int i = 0; i < count; i++) {
+        bytes[i] = to_bytes(keys[i]);
+    }
+    {
+        QHash<QByteArray, int> index;
+        run_index(report, "qhash", count,
+                  [&](int i) { index.insert(bytes[i], i); },
+                  [&](int i) { return index.contains(bytes[i]); },
+                  [&](int i) { index.remove(bytes[i]); });
+    }
+    {
+        QMap<QByteArray, int> index;
+        run_index(report, "qmap", count,
+                  [&](int i) { index.insert(bytes[i], i); },
+                  [&](int i) { return index.contains(bytes[i]); },
+                  [&](int i) { index.remove(bytes[i]); });
+    }
+}
+
+void bench_walk(Report& report, QString const& root, int threads, RecordStore& store) {
+    QAtomicInt stop_flag(0);
+    QAtomicInteger<qint64> files(0);
+    QElapsedTimer timer;
+    timer.start();
+    DirWalker walker(stop_flag, &store, [&](QVector<quint32>& batch) {
+        files.fetchAndAddRelaxed(batch.size());
+    });
+    walker.walk({root}, threads);
+    qint64 msecs = timer.elapsed();
+
+    qint64 bytes = 0;
+    for (quint32 file = 0; file < store.count(); file++) {
+        bytes += store.size(file);
+    }
+    report.add("walk", files.load(), bytes, msecs,
+               {{"entries", walker.entries()}, {"directories", walker.directories()},
+                {"record_bytes", store.bytes_used()}});
+}
+
+// the size stage alone: first file of every size, files whose size repeats
+void bench_bucket(Report& report, RecordStore const& store) {
+    QElapsedTimer timer;
+    timer.start();
+    FlatIndex<qint64, quint32> size_to_file;
+    qint64 colliding = 0;
+    for (quint32 file = 0; file < store.count(); file++) {
+        colliding += !size_to_file.insert(store.size(file), file);
+    }
+    report.add("bucket", store.count(), 0, timer.elapsed(),
+               {{"sizes", size_to_file.size()}, {"colliding", colliding}});
+}
+
+// reads every file once without a digest, then once per digest. Without
+// drop_cache the first pass warms the page cache for the others.
+void bench_hash(Report& report, RecordStore const& store, ScanOptions const& options) {
+    QScopedPointer<FileReader> reader(FileReader::create(options.read_strategy, options.drop_cache));
+    QVector<ReadRange> whole = {{0, -1}};
+    qint64 bytes = 0;
+    for (quint32 file = 0; file < store.count(); file++) {
+        bytes += store.size(file);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (quint32 file = 0; file < store.count(); file++) {
+        reader->read(store.native_path(file), whole, nullptr);
+    }
+    report.add("hash.read." + FileReader::key(options.read_strategy), store.count(), bytes, timer.elapsed());
+
+    for (auto type : Digest::types()) {
+        QScopedPointer<Digest> digest(Digest::create(type));
+        timer.restart();
+        for (quint32 file = 0; file < store.count(); file++) {
+            digest->reset();
+            reader->read(store.native_path(file), whole, digest.data());
+            digest->result();
+        }
+        report.add("hash." + Digest::key(type), store.count(), bytes, timer.elapsed());
+    }
+}
+
+// stands in for the model: counts what the engine publishes
+class CountingListener : public EngineListener {
+public:
+    qint64 inserts = 0;
+    qint64 removes = 0;
+    qint64 confirmed = 0;
+
+    void begin_insert(int, int first, int last) override { inserts += last - first + 1; }
+    void begin_remove(int, int first, int last) override { removes += last - first + 1; }
+    void group_confirmed(int) override { confirmed++; }
+};
+
+void run_scan(ScanEngine& engine, QString const& root) {
+    QEventLoop loop;
+    QObject::connect(&engine, &ScanEngine::end_scan, &loop, &QEventLoop::quit);
+    engine.start_scan({root});
+    loop.exec();
+}
+
+// a whole scan, then the share of it spent grouping results
+void bench_scan(Report& report, ScanEngine& engine, CountingListener const& listener, QString const& root) {
+    QElapsedTimer timer;
+    timer.start();
+    run_scan(engine, root);
+    qint64 msecs = timer.elapsed();
+
+    auto const& stats = engine.stats();
+    report.add("scan", stats.records, stats.bytes_read, msecs,
+               {{"groups", engine.group_count() - 1}, {"size_unique", stats.size_unique},
+                {"partial_unique", stats.partial_unique}, {"full_hashed", stats.full_hashed},
+                {"hardlinks", stats.hardlinks}, {"shared_extents", stats.shared_extents},
+                {"bytes_total", stats.bytes_total}});
+    report.add("group", stats.records, 0, stats.group_msecs,
+               {{"inserted_rows", listener.inserts}, {"removed_rows", listener.removes},
+                {"confirmed", listener.confirmed}});
+}
+
+// keeps the first file of every group of copies and deletes the rest
+void bench_delete(Report& report, ScanEngine& engine) {
+    QVector<int> ids;
+    qint64 files = 0;
+    qint64 bytes = 0;
+    for (int row = 0; row < engine.group_count(); row++) {
+        int id = engine.group_at(row);
+        auto const& group = engine.group(id);
+        if (id == ScanEngine::unique_group || group.kind != GroupKind::Copies) { continue; }
+        ids.push_back(id);
+        files += group.files.size() - 1;
+        bytes += group.size * (group.files.size() - 1);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QEventLoop loop;
+    QObject::connect(&engine, &ScanEngine::reclaimed, &loop, &QEventLoop::quit);
+    engine.reclaim(ids, ReclaimAction::Delete);
+    loop.exec();
+    report.add("delete", files, bytes, timer.elapsed(), {{"groups", ids.size()}});
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("FindDuplicatesBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the stages of a scan on a generated tree or a given one. "
+                                     "Prints one JSON object per result.");
+    parser.addHelpOption();
+    QCommandLineOption stage_option("stage", "Comma separated stages: walk, bucket, hash, scan, delete, index.",
+                                    "stages", "walk,bucket,hash,scan");
+    QCommandLineOption dir_option("dir", "Tree to scan instead of a generated one.", "path");
+    QCommandLineOption generate_option("generate", "Write the corpus into --dir and keep it.");
+    QCommandLineOption files_option("files", "Files of the corpus.", "count", "10000");
+    QCommandLineOption seed_option("seed", "Seed of the corpus.", "number", "1");
+    QCommandLineOption min_option("min-size", "Smallest file of the corpus.", "bytes", "1");
+    QCommandLineOption max_option("max-size", "Largest file of the corpus.", "bytes", "1048576");
+    QCommandLineOption duplicates_option("duplicates", "Share of files copying another one.", "ratio", "0.2");
+    QCommandLineOption hardlinks_option("hardlinks", "Share of files linking another one.", "ratio", "0.02");
+    QCommandLineOption tails_option("tails", "Share of copies that differ in the last byte.", "ratio", "0.05");
+    QCommandLineOption depth_option("depth", "Directory levels of the corpus.", "count", "3");
+    QCommandLineOption fanout_option("fanout", "Subdirectories per directory.", "count", "8");
+    QCommandLineOption digest_option({"d", "digest"}, "Digest of the scan.", "digest", "sha3");
+    QCommandLineOption read_option("read", "Read files with: buffered, mmap or uring.", "strategy", "buffered");
+    QCommandLineOption drop_option("drop-cache", "Drop page cache behind the reader.");
+    QCommandLineOption bytes_option("byte-compare", "Scan comparing bytes instead of hashing.");
+    QCommandLineOption walk_option("walk-threads", "Threads walking the tree.", "count");
+    QCommandLineOption entries_option({"n", "entries"}, "Keys of the index stage.", "count", "10000000");
+    QCommandLineOption qt_option("skip-qt", "Time only the flat index in the index stage.");
+    parser.addOptions({stage_option, dir_option, generate_option, files_option, seed_option, min_option,
+                       max_option, duplicates_option, hardlinks_option, tails_option, depth_option,
+                       fanout_option, digest_option, read_option, drop_option, bytes_option, walk_option,
+                       entries_option, qt_option});
+    parser.process(a);
+
+    QTextStream err(stderr);
+    auto stages = parser.value(stage_option).split(',', Qt::SkipEmptyParts);
+    Report report;
+
+    ScanOptions options;
+    if (!Digest::parse(parser.value(digest_option), options.digest)) {
+        err << "unknown digest: " << parser.value(digest_option) << '\n';
+        return 1;
+    }
+    if (!FileReader::parse(parser.value(read_option), options.read_strategy)) {
+        err << "unknown read strategy: " << parser.value(read_option) << '\n';
+        return 1;
+    }
+    if (parser.isSet(walk_option)) {
+        options.walk_threads = parser.value(walk_option).toInt();
+    }
+    options.drop_cache = parser.isSet(drop_option);
+    options.compare_bytes = parser.isSet(bytes_option);
+
+    if (stages.contains("index")) {
+        bench_index(report, parser.value(entries_option).toInt(), parser.isSet(qt_option));
+        stages.removeAll("index");
+        if (stages.empty()) {
+            return 0;
+        }
+    }
+
+    // a generated tree is ours to delete from, a given one is not
+    QTemporaryDir temporary;
+    QString root = parser.value(dir_option);
+    bool generate = root.isEmpty() || parser.isSet(generate_option);
+    if (root.isEmpty()) {
+        root = temporary.path();
+    }
+    if (stages.contains("delete") && !generate) {
+        err << "the delete stage only runs on a generated corpus\n";
+        return 1;
+    }
+
+    if (generate) {
+        CorpusOptions corpus;
+        corpus.files = parser.value(files_option).toInt();
+        corpus.seed = parser.value(seed_option).toULongLong();
+        corpus.min_size = parser.value(min_option).toLongLong();
+        corpus.max_size = parser.value(max_option).toLongLong();
+        corpus.duplicate_ratio = parser.value(duplicates_option).toDouble();
+        corpus.hardlink_ratio = parser.value(hardlinks_option).toDouble();
+        corpus.tail_ratio = parser.value(tails_option).toDouble();
+        corpus.depth = parser.value(depth_option).toInt();
+        corpus.fanout = parser.value(fanout_option).toInt();
+
+        CorpusStats stats;
+        QElapsedTimer timer;
+        timer.start();
+        if (!Corpus::generate(root, corpus, stats)) {
+            err << "cannot write the corpus to " << root << '\n';
+            return 1;
+        }
+        report.add("corpus", stats.files, stats.bytes, timer.elapsed(),
+                   {{"seed", QString::number(corpus.seed)}, {"directories", stats.directories},
+                    {"duplicates", stats.duplicates}, {"hardlinks", stats.hardlinks}, {"tails", stats.tails}});
+    }
+
+    if (stages.contains("walk") || stages.contains("bucket") || stages.contains("hash")) {
+        RecordStore store;
+        bench_walk(report, root, options.walk_threads, store);
+        if (stages.contains("bucket")) {
+            bench_bucket(report, store);
+        }
+        if (stages.contains("hash")) {
+            bench_hash(report, store, options);
+        }
+    }
+
+    if (stages.contains("scan") || stages.contains("delete")) {
+        CountingListener listener;
+        ScanEngine engine;
+        engine.set_listener(&listener);
+        engine.set_options(options);
+        bench_scan(report, engine, listener, root);
+        if (stages.contains("delete")) {
+            bench_delete(report, engine);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+# command line front end, streams duplicate groups as JSON lines or CSV
+
+QT       += core
+QT       -= gui
+
+TARGET = FindDuplicatesCli
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../core/core.pri)
+
+SOURCES += \
+    main.cpp \
+    groupwriter.cpp
+
+HEADERS += \
+    groupwriter.h
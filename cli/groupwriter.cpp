@@ -0,0 +1,76 @@
+#include "groupwriter.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <cstdio>
+
+GroupWriter::GroupWriter(ScanEngine const* engine, Format format) : engine(engine), format(format), out(), stream(), written(0) {
+    out.open(stdout, QIODevice::WriteOnly);
+    stream.setDevice(&out);
+    stream.setCodec("UTF-8");
+    if (format == Format::Csv) {
+        stream << "group,kind,size,digest,path\n";
+        stream.flush();
+    }
+}
+
+void GroupWriter::group_confirmed(int id) {
+    auto const& group = engine->group(id);
+    QString digest = QString::fromLatin1(group.hash.toHex());
+    QString kind = kind_name(group.kind);
+    if (format == Format::JsonLines) {
+        QJsonArray files;
+        for (auto file : group.files) {
+            files.append(engine->member_path(id, file));
+        }
+        QJsonObject line;
+        line["kind"] = kind;
+        line["size"] = static_cast<double>(group.size);
+        line["digest"] = digest;
+        line["files"] = files;
+        if (group.kind == GroupKind::Referenced) {
+            line["reference"] = engine->reference_path(id);
+        }
+        if (engine->approximate(id)) {
+            line["approximate"] = true;
+        }
+        stream << QJsonDocument(line).toJson(QJsonDocument::Compact) << '\n';
+    } else {
+        for (auto file : group.files) {
+            stream << written << ',' << kind << ',' << group.size << ',' << digest << ',' << csv_field(engine->member_path(id, file)) << '\n';
+        }
+    }
+    stream.flush();
+    written++;
+}
+
+// links are names of the same data, copies are what deleting frees
+QString GroupWriter::kind_name(GroupKind kind) {
+    switch (kind) {
+    case GroupKind::Hardlinks:
+        return "hardlinks";
+    case GroupKind::SharedExtents:
+        return "shared";
+    case GroupKind::Directories:
+        return "directories";
+    case GroupKind::Referenced:
+        return "referenced";
+    default:
+        return "copies";
+    }
+}
+
+int GroupWriter::groups_written() const {
+    return written;
+}
+
+QString GroupWriter::csv_field(QString const& value) {
+    if (!value.contains(',') && !value.contains('"') && !value.contains('\n')) {
+        return value;
+    }
+    QString quoted = value;
+    quoted.replace("\"", "\"\"");
+    return '"' + quoted + '"';
+}
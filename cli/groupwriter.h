@@ -0,0 +1,34 @@
+#ifndef GROUPWRITER_H
+#define GROUPWRITER_H
+
+#include "scanengine.h"
+
+#include <QFile>
+#include <QTextStream>
+
+// prints every duplicate group as soon as the engine confirms it
+class GroupWriter : public EngineListener {
+public:
+    enum class Format {
+        JsonLines,
+        Csv
+    };
+
+    GroupWriter(ScanEngine const* engine, Format format);
+
+    void group_confirmed(int group) override;
+
+    int groups_written() const;
+
+private:
+    static QString csv_field(QString const& value);
+    static QString kind_name(GroupKind kind);
+
+    ScanEngine const* engine;
+    Format format;
+    QFile out;
+    QTextStream stream;
+    int written;
+};
+
+#endif // GROUPWRITER_H
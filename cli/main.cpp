@@ -0,0 +1,440 @@
+#include "groupwriter.h"
+#include "referenceindex.h"
+#include "scanengine.h"
+#include "scanprofile.h"
+#include "snapshotmerger.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSocketNotifier>
+#include <QSysInfo>
+#include <QTextStream>
+
+#include <csignal>
+#include <cstdio>
+
+#include <unistd.h>
+
+namespace {
+
+// signals only write to a pipe, the event loop does the work
+int signal_pipe[2];
+
+void on_signal(int number) {
+    char c = char(number);
+    ssize_t written = write(signal_pipe[1], &c, 1);
+    (void)written;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("FindDuplicatesCli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Finds duplicate files, groups are printed as soon as they are final.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("directories", "Directories to scan.", "[directory...]");
+    QCommandLineOption format_option({"f", "format"}, "Output format: jsonl or csv.", "format", "jsonl");
+    QCommandLineOption digest_option({"d", "digest"}, "Digest: sha3, blake2b, sha256 or xxhash.", "digest", "sha3");
+    QCommandLineOption threads_option({"t", "threads"}, "Hashing threads.", "count");
+    QCommandLineOption walk_option("walk-threads", "Threads walking the tree.", "count");
+    QCommandLineOption block_option("block-size", "Size of head and tail blocks.", "bytes");
+    QCommandLineOption cache_option("cache", "Hash cache file.", "path");
+    QCommandLineOption compact_option("compact-cache", "Drop cached files not seen by the scan.");
+    QCommandLineOption read_option("read", "Read files with: buffered, mmap or uring "
+                                   "(helps files of several MiB only).", "strategy", "buffered");
+    QCommandLineOption hdd_option("hdd-reads", "Files read at once from one rotational disk, 0 for any.", "count", "1");
+    QCommandLineOption ssd_option("ssd-reads", "Files read at once from one other device, 0 for any.", "count", "0");
+    QCommandLineOption drop_option("drop-cache", "Drop page cache behind the reader.");
+    QCommandLineOption bytes_option("byte-compare", "Compare files of equal size byte by byte instead of hashing.");
+    QCommandLineOption extents_option("no-extents", "Do not look for files sharing their extents.");
+    QCommandLineOption compare_option("compare", "Print read and digest throughput instead of scanning.");
+    QCommandLineOption reclaim_option("reclaim", "After the scan, keep the first file of each group and "
+                                      "delete, hardlink or dedupe the others.", "action");
+    QCommandLineOption dry_option("dry-run", "Only count what --reclaim would free.");
+    QCommandLineOption verify_option("no-verify", "Do not compare contents before deleting or linking.");
+    QCommandLineOption telemetry_option("telemetry", "Append stage telemetry as JSON lines, - for stderr.", "path");
+    QCommandLineOption interval_option("telemetry-interval", "Time between telemetry lines.", "msecs", "1000");
+    QCommandLineOption profile_option("profile", "JSON scan profile with roots and filters.", "path");
+    QCommandLineOption exclude_option("exclude", "Leave out names, or paths if it has a slash, matching the glob.", "glob");
+    QCommandLineOption include_option("include", "Only scan file names matching the glob.", "glob");
+    QCommandLineOption ext_option("ext", "Only scan files with the extension.", "extension");
+    QCommandLineOption min_option("min-size", "Smallest file scanned.", "bytes");
+    QCommandLineOption max_option("max-size", "Largest file scanned, 0 for any.", "bytes");
+    QCommandLineOption device_option("one-file-system", "Do not enter directories on other file systems.");
+    QCommandLineOption export_option("export-snapshot", "After the scan, write the digest index to a snapshot file.", "path");
+    QCommandLineOption shard_option("shard", "Name of this shard in the snapshot, the host name by default.", "name");
+    QCommandLineOption merge_option("merge", "Merge the snapshot files given instead of directories into global groups.");
+    QCommandLineOption need_option("need-dir", "Where --merge writes the list of files each shard has to hash.", "dir", ".");
+    QCommandLineOption refine_option("refine", "Hash the files of a --merge list and update the snapshot.", "snapshot");
+    QCommandLineOption list_option("need", "List of files written by --merge, for --refine.", "path");
+    QCommandLineOption reference_option("reference", "Only report files whose content is in the reference index.", "index");
+    QCommandLineOption build_option("build-reference", "Build the --reference index from a snapshot of the reference tree.", "snapshot");
+    QCommandLineOption chunks_option("chunks", "After the scan, find files sharing content defined chunks and "
+                                     "estimate what block level dedupe would free.");
+    QCommandLineOption chunk_size_option("chunk-size", "Average chunk size.", "bytes", "65536");
+    QCommandLineOption chunk_file_option("chunk-min-file", "Smallest file chunked.", "bytes", "1048576");
+    QCommandLineOption chunk_memory_option("chunk-memory", "Memory of the chunk index before it samples chunks.", "bytes",
+                                           "268435456");
+    QCommandLineOption pairs_option("chunk-pairs", "File pairs sharing the most chunks to print.", "count", "20");
+    QCommandLineOption dirs_option("dirs", "Report identical directories as one group instead of the files in them.");
+    QCommandLineOption watch_option("watch", "After the scan, follow changes of the tree until interrupted.");
+    QCommandLineOption checkpoint_option("checkpoint", "Save progress to the file periodically and when interrupted, "
+                                         "digests go to the --cache or next to it.", "path");
+    QCommandLineOption checkpoint_interval_option("checkpoint-interval", "Time between checkpoints.", "secs", "60");
+    QCommandLineOption memory_option("memory", "Spill walked files to disk and group them in batches that fit "
+                                     "about this much memory, for trees larger than RAM.", "bytes");
+    QCommandLineOption spill_option("spill-dir", "Where --memory writes its runs, the temp directory by default.", "dir");
+    QCommandLineOption resume_option("resume", "Resume the scan saved in the checkpoint, with its roots and filter.",
+                                     "path");
+    parser.addOptions({format_option, digest_option, threads_option, walk_option, block_option,
+                       cache_option, compact_option, read_option, hdd_option, ssd_option, drop_option, bytes_option, extents_option, compare_option,
+                       reclaim_option, dry_option, verify_option, telemetry_option, interval_option, watch_option,
+                       profile_option, exclude_option, include_option, ext_option, min_option, max_option, device_option,
+                       export_option, shard_option, merge_option, need_option, refine_option, list_option,
+                       reference_option, build_option,
+                       chunks_option, chunk_size_option, chunk_file_option, chunk_memory_option, pairs_option,
+                       dirs_option, checkpoint_option, checkpoint_interval_option, resume_option,
+                       memory_option, spill_option});
+    parser.process(a);
+
+    QTextStream err(stderr);
+    if (parser.isSet(merge_option)) { // snapshots only, no file is read
+        QFile out;
+        out.open(stdout, QIODevice::WriteOnly);
+        SnapshotMerger merger;
+        if (!merger.merge(parser.positionalArguments(), &out, parser.value(need_option))) {
+            err << merger.error() << '\n';
+            return 1;
+        }
+        auto const& stats = merger.stats();
+        err << "shards: " << stats.shards
+            << ", files: " << stats.files
+            << ", groups: " << stats.groups
+            << ", across shards: " << stats.cross_groups
+            << ", bytes duplicated: " << stats.bytes_duplicated
+            << ", to hash: " << stats.need_partial << " head/tail, " << stats.need_full << " full\n";
+        return 0;
+    }
+
+    // the command line adds to the profile
+    ScanProfile profile;
+    if (parser.isSet(profile_option) && !profile.load(parser.value(profile_option))) {
+        err << "cannot read profile " << parser.value(profile_option) << '\n';
+        return 1;
+    }
+    profile.roots += parser.positionalArguments();
+    profile.filter.exclude += parser.values(exclude_option);
+    profile.filter.include += parser.values(include_option);
+    profile.filter.extensions += parser.values(ext_option);
+    if (parser.isSet(min_option)) {
+        profile.filter.min_size = parser.value(min_option).toLongLong();
+    }
+    if (parser.isSet(max_option)) {
+        profile.filter.max_size = parser.value(max_option).toLongLong();
+    }
+    profile.filter.one_file_system = profile.filter.one_file_system || parser.isSet(device_option);
+    // the interrupted scan is redone as it was, files it hashed come from its cache
+    ScanCheckpoint checkpoint;
+    bool resume = parser.isSet(resume_option);
+    if (resume) {
+        if (!checkpoint.load(parser.value(resume_option))) {
+            err << "cannot read checkpoint " << parser.value(resume_option) << '\n';
+            return 1;
+        }
+        profile = checkpoint.profile;
+    }
+    bool compare = parser.isSet(compare_option);
+    bool refine = parser.isSet(refine_option);
+    bool build = parser.isSet(build_option);
+    if (build ? !parser.isSet(reference_option)
+              : refine ? !parser.isSet(list_option) : (profile.roots.empty() || (compare && profile.roots.size() != 1))) {
+        parser.showHelp(1);
+    }
+
+    ScanOptions options;
+    if (!Digest::parse(parser.value(digest_option), options.digest)) {
+        err << "unknown digest: " << parser.value(digest_option) << '\n';
+        return 1;
+    }
+    if (parser.isSet(walk_option)) {
+        options.walk_threads = parser.value(walk_option).toInt();
+    }
+    if (parser.isSet(block_option)) {
+        options.block_size = parser.value(block_option).toLongLong();
+    }
+    if (!FileReader::parse(parser.value(read_option), options.read_strategy)) {
+        err << "unknown read strategy: " << parser.value(read_option) << '\n';
+        return 1;
+    }
+    options.rotational_reads = parser.value(hdd_option).toInt();
+    options.solid_reads = parser.value(ssd_option).toInt();
+    options.drop_cache = parser.isSet(drop_option);
+    options.shared_extents = !parser.isSet(extents_option);
+    options.compare_bytes = parser.isSet(bytes_option);
+    options.cache_path = parser.value(cache_option);
+    options.compact_cache = parser.isSet(compact_option);
+    options.checkpoint_path = resume ? parser.value(resume_option) : parser.value(checkpoint_option);
+    options.checkpoint_secs = parser.value(checkpoint_interval_option).toInt();
+    if (resume) {
+        options.cache_path = checkpoint.cache_path;
+        options.digest = checkpoint.digest;
+        options.block_size = checkpoint.block_size;
+        options.partial_min_size = checkpoint.partial_min_size;
+    }
+    options.dry_run = parser.isSet(dry_option);
+    options.verify_delete = !parser.isSet(verify_option);
+    options.filter = profile.filter;
+    options.watch = parser.isSet(watch_option);
+    options.chunk_size = parser.value(chunk_size_option).toLongLong();
+    options.chunk_min_file = parser.value(chunk_file_option).toLongLong();
+    options.chunk_memory = parser.value(chunk_memory_option).toLongLong();
+    options.group_dirs = parser.isSet(dirs_option);
+    if (options.watch && options.group_dirs) {
+        err << "--watch keeps file groups current, it does not work with --dirs\n";
+        return 1;
+    }
+    if (parser.isSet(memory_option)) {
+        options.memory_budget = parser.value(memory_option).toLongLong();
+        options.spill_path = parser.value(spill_option);
+        // groups are printed and dropped batch by batch
+        if (options.watch || options.group_dirs || options.compare_bytes || parser.isSet(reclaim_option)
+                || parser.isSet(chunks_option) || parser.isSet(export_option)) {
+            err << "--memory does not work with --watch, --dirs, --byte-compare, --reclaim, --chunks "
+                   "or --export-snapshot\n";
+            return 1;
+        }
+    }
+    if (options.watch && options.compare_bytes) {
+        err << "--watch needs digests, it does not work with --byte-compare\n";
+        return 1;
+    }
+    if (options.compare_bytes && parser.isSet(export_option)) {
+        err << "a snapshot holds digests, --export-snapshot does not work with --byte-compare\n";
+        return 1;
+    }
+    ReclaimAction action = ReclaimAction::Delete;
+    if (parser.isSet(reclaim_option) && !Reclaimer::parse(parser.value(reclaim_option), action)) {
+        err << "unknown reclaim action: " << parser.value(reclaim_option) << '\n';
+        return 1;
+    }
+
+    if (refine) {
+        int hashed = 0;
+        if (!Snapshot::refine(parser.value(refine_option), parser.value(list_option), options.read_strategy, hashed)) {
+            err << "cannot refine " << parser.value(refine_option) << " with " << parser.value(list_option) << '\n';
+            return 1;
+        }
+        err << "files hashed: " << hashed << '\n';
+        return 0;
+    }
+    if (build) {
+        QString error;
+        if (!ReferenceIndex::build(parser.value(build_option), parser.value(reference_option), options.read_strategy, error)) {
+            err << error << '\n';
+            return 1;
+        }
+        return 0;
+    }
+    if (parser.isSet(reference_option)) {
+        ReferenceIndex reference;
+        if (!reference.open(parser.value(reference_option))) {
+            err << "cannot read reference index " << parser.value(reference_option) << '\n';
+            return 1;
+        }
+        options.reference_path = parser.value(reference_option);
+    }
+
+    GroupWriter::Format format;
+    if (parser.value(format_option) == "jsonl") {
+        format = GroupWriter::Format::JsonLines;
+    } else if (parser.value(format_option) == "csv") {
+        format = GroupWriter::Format::Csv;
+    } else {
+        err << "unknown format: " << parser.value(format_option) << '\n';
+        return 1;
+    }
+
+    QFile telemetry;
+    if (parser.isSet(telemetry_option)) {
+        bool opened;
+        if (parser.value(telemetry_option) == "-") {
+            opened = telemetry.open(stderr, QIODevice::WriteOnly);
+        } else {
+            telemetry.setFileName(parser.value(telemetry_option));
+            opened = telemetry.open(QIODevice::WriteOnly | QIODevice::Append);
+        }
+        if (!opened) {
+            err << "cannot open " << parser.value(telemetry_option) << '\n';
+            return 1;
+        }
+        options.telemetry_msecs = qMax(1, parser.value(interval_option).toInt());
+    }
+
+    ScanEngine engine;
+    GroupWriter writer(&engine, format);
+    engine.set_listener(&writer);
+    if (parser.isSet(threads_option)) {
+        engine.set_hash_threads(parser.value(threads_option).toInt());
+    }
+    engine.set_options(options);
+
+    // SIGINT and SIGTERM stop the reads within a chunk and save the
+    // checkpoint, SIGUSR1 pauses the scan and SIGUSR2 resumes it
+    if (pipe(signal_pipe) != 0) {
+        err << "cannot create signal pipe\n";
+        return 1;
+    }
+    QSocketNotifier signal_notifier(signal_pipe[0], QSocketNotifier::Read);
+    QObject::connect(&signal_notifier, &QSocketNotifier::activated, &a, [&]() {
+        char c;
+        if (read(signal_pipe[0], &c, 1) != 1) { return; }
+        if (c == SIGUSR1) {
+            engine.pause_scan();
+            err << "paused\n";
+        } else if (c == SIGUSR2) {
+            engine.resume_scan();
+            err << "resumed\n";
+        } else {
+            engine.stop_scan();
+            if (!options.checkpoint_path.isEmpty()) {
+                err << "interrupted, resume with --resume " << options.checkpoint_path << '\n';
+            }
+            a.exit(128 + c);
+        }
+        err.flush();
+    });
+    for (int number : {SIGINT, SIGTERM, SIGUSR1, SIGUSR2}) {
+        signal(number, on_signal);
+    }
+
+    QObject::connect(&engine, &ScanEngine::telemetry_update, &a, [&](QJsonObject const& report) {
+        telemetry.write(QJsonDocument(report).toJson(QJsonDocument::Compact) + '\n');
+        telemetry.flush();
+    });
+
+    // reclaims once the scan and its chunk analysis are over
+    auto after_scan = [&]() {
+        if (!parser.isSet(reclaim_option)) {
+            if (!options.watch) {
+                a.quit();
+            }
+            return;
+        }
+
+        QVector<int> groups;
+        for (int row = 0; row < engine.group_count(); row++) {
+            groups.push_back(engine.group_at(row));
+        }
+        engine.reclaim(groups, action);
+    };
+    QObject::connect(&engine, &ScanEngine::end_scan, &a, [&](int files_scanned) {
+        auto const& stats = engine.stats();
+        err << "files: " << files_scanned
+            << ", groups: " << writer.groups_written()
+            << ", unique by size: " << stats.size_unique
+            << ", by head/tail: " << stats.partial_unique
+            << ", fully hashed: " << stats.full_hashed
+            << ", cached: " << stats.cache_hits
+            << ", bytes read: " << stats.bytes_read
+            << (options.compare_bytes ? ", hashing would read: " + QString::number(stats.bytes_hash_path) : QString())
+            << ", hard links: " << stats.hardlinks
+            << ", shared extents: " << stats.shared_extents
+            << ", bytes in links: " << stats.bytes_linked
+            << (options.reference_path.isEmpty() ? QString() : ", in reference: " + QString::number(stats.referenced)
+                + ", bytes in reference: " + QString::number(stats.bytes_referenced))
+            << ", bytes per file: " << stats.record_bytes / qMax<qint64>(stats.records, 1)
+            << (options.group_dirs ? ", directory groups: " + QString::number(stats.dir_groups)
+                + ", directories: " + QString::number(stats.dirs_duplicated)
+                + ", file groups collapsed: " + QString::number(stats.groups_collapsed) : QString())
+            << (options.memory_budget > 0 ? ", runs: " + QString::number(stats.spill_runs)
+                + ", bytes spilled: " + QString::number(stats.bytes_spilled)
+                + ", batches: " + QString::number(stats.spill_batches) : QString())
+            << ", pruned: " << stats.entries_pruned
+            << ", bytes pruned: " << stats.bytes_pruned
+            << ", msecs: " << stats.scan_msecs
+            << ", grouping msecs: " << stats.group_msecs << '\n';
+        if (stats.dirs_unwatched > 0) {
+            err << "directories not watched: " << stats.dirs_unwatched << ", " << engine.watch_error() << '\n';
+        }
+        if (parser.isSet(export_option)) {
+            QString shard = parser.isSet(shard_option) ? parser.value(shard_option) : QSysInfo::machineHostName();
+            if (!engine.export_snapshot(parser.value(export_option), shard)) {
+                err << "cannot write snapshot " << parser.value(export_option) << '\n';
+            }
+        }
+        err.flush();
+        if (parser.isSet(chunks_option)) {
+            engine.analyze_chunks();
+        } else {
+            after_scan();
+        }
+    });
+    QObject::connect(&engine, &ScanEngine::scan_failed, &a, [&](QString const& error) {
+        err << error << '\n';
+        err.flush();
+        a.exit(1);
+    });
+    QObject::connect(&engine, &ScanEngine::chunks_analyzed, &a, [&]() {
+        auto report = engine.chunk_report(parser.value(pairs_option).toInt());
+        QTextStream out(stdout);
+        out.setCodec("UTF-8");
+        for (auto const& pair : report.pairs) {
+            QJsonObject line;
+            line["kind"] = "chunks";
+            line["shared"] = static_cast<double>(pair.shared);
+            line["files"] = QJsonArray{engine.file_path(pair.first), engine.file_path(pair.second)};
+            out << QJsonDocument(line).toJson(QJsonDocument::Compact) << '\n';
+        }
+        out.flush();
+        err << "chunked files: " << report.files
+            << ", failed: " << report.failed
+            << ", bytes chunked: " << report.bytes
+            << ", chunks: " << report.chunks
+            << ", sampled: 1 in " << (qint64(1) << report.sample_shift)
+            << ", bytes savable by block dedupe: " << report.bytes_savable << '\n';
+        err.flush();
+        after_scan();
+    });
+    QObject::connect(&engine, &ScanEngine::reclaim_update, &a, [&](int done, int total, qint64 bytes) {
+        err << "reclaimed " << done << " of " << total << " files, " << bytes << " bytes\n";
+        err.flush();
+    });
+    QObject::connect(&engine, &ScanEngine::reclaimed, &a, [&](int files, int failed, qint64 bytes, bool dry_run) {
+        err << (dry_run ? "dry run, files: " : "files: ") << files
+            << ", failed or differing: " << failed
+            << (dry_run ? ", bytes that would be freed: " : ", bytes freed: ") << bytes << '\n';
+        err.flush();
+        if (!options.watch) {
+            a.quit();
+        }
+    });
+    QObject::connect(&engine, &ScanEngine::index_updated, &a, [&](int files) {
+        auto const& stats = engine.stats();
+        err << "files: " << files
+            << ", changed: " << stats.files_changed
+            << ", removed: " << stats.files_removed
+            << ", not watched: " << stats.dirs_unwatched
+            << ", groups: " << engine.group_count() - 1 << '\n';
+        err.flush();
+    });
+
+    if (compare) {
+        QObject::connect(&engine, &ScanEngine::digests_compared, &a, [&](QString const& report) {
+            QTextStream(stdout) << report;
+            a.quit();
+        });
+        engine.compare_digests(profile.roots.first());
+        return a.exec();
+    }
+
+    engine.start_scan(profile.roots);
+    return a.exec();
+}
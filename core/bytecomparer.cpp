@@ -0,0 +1,260 @@
+#include "bytecomparer.h"
+
+#include "resultring.h"
+
+#include <QHash>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <list>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// block compared at a time, open files and distinct blocks kept per bucket
+const int compare_block = 256 * 1024;
+const int max_open = 64;
+const int max_classes = 16;
+
+// open files of one bucket, the least recently used one is closed first.
+// A class larger than the cache is read in the same order block after
+// block, so its least recently used file is always the next one needed:
+// there the files opened first stay and the others take turns in the
+// last slot.
+class FileCache {
+public:
+    explicit FileCache(RecordStore const* store) : store(store), fds(), order(), cycling(false) {}
+
+    ~FileCache() {
+        for (auto const& entry : fds) {
+            close(entry.fd);
+        }
+    }
+
+    // the files read next are more than the cache holds
+    void set_cycling(bool cycling) {
+        this->cycling = cycling;
+    }
+
+    int get(quint32 file) {
+        auto it = fds.find(file);
+        if (it != fds.end()) {
+            if (!cycling) {
+                order.splice(order.end(), order, it->position);
+            }
+            return it->fd;
+        }
+        if (fds.size() >= max_open) {
+            auto victim = cycling ? std::prev(order.end()) : order.begin();
+            close(fds.take(*victim).fd);
+            order.erase(victim);
+        }
+        int fd = open(store->native_path(file).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { return -1; }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        fds.insert(file, {fd, order.insert(order.end(), file)});
+        return fd;
+    }
+
+    void release(quint32 file) {
+        auto it = fds.find(file);
+        if (it == fds.end()) { return; }
+        close(it->fd);
+        order.erase(it->position);
+        fds.erase(it);
+    }
+
+private:
+    struct Entry {
+        int fd;
+        std::list<quint32>::iterator position;
+    };
+
+    RecordStore const* store;
+    QHash<quint32, Entry> fds;
+    std::list<quint32> order;
+    bool cycling;
+};
+
+qint64 read_block(int fd, qint64 offset, int length, char* buffer) {
+    qint64 done = 0;
+    while (done < length) {
+        ssize_t count = pread(fd, buffer + done, length - done, offset + done);
+        if (count < 0 && errno == EINTR) { continue; }
+        if (count <= 0) { break; }
+        done += count;
+    }
+    return done;
+}
+
+}
+
+class CompareThread : public QThread {
+public:
+    CompareThread(ByteComparer* comparer, QAtomicInt const& stop_flag) : comparer(comparer), stop_flag(stop_flag) {}
+
+protected:
+    void run() override {
+        comparer->work(stop_flag);
+    }
+
+private:
+    ByteComparer* comparer;
+    QAtomicInt const& stop_flag;
+};
+
+ByteComparer::ByteComparer() : store(nullptr), ring(nullptr), options(), lock(), buckets(),
+    next_class(0), read_bytes(0), hash_bytes(0) {}
+
+void ByteComparer::set_store(RecordStore* store) {
+    this->store = store;
+}
+
+void ByteComparer::set_ring(ResultRing* ring) {
+    this->ring = ring;
+}
+
+void ByteComparer::set_options(ScanOptions const& options) {
+    this->options = options;
+}
+
+void ByteComparer::add_bucket(QVector<quint32> const& files) {
+    QMutexLocker locker(&lock);
+    buckets.push_back(files);
+}
+
+void ByteComparer::clear() {
+    QMutexLocker locker(&lock);
+    buckets.clear();
+    next_class = 0;
+    read_bytes = 0;
+    hash_bytes = 0;
+}
+
+void ByteComparer::run(QAtomicInt const& stop_flag, int threads) {
+    QVector<CompareThread*> helpers;
+    for (int i = 1; i < threads; i++) {
+        helpers.push_back(new CompareThread(this, stop_flag));
+        helpers.back()->start();
+    }
+    work(stop_flag);
+    for (auto helper : helpers) {
+        helper->wait();
+        delete helper;
+    }
+}
+
+int ByteComparer::pending_buckets() {
+    QMutexLocker locker(&lock);
+    return buckets.size();
+}
+
+qint64 ByteComparer::bytes_read() const {
+    return read_bytes;
+}
+
+qint64 ByteComparer::bytes_hash_path() const {
+    return hash_bytes;
+}
+
+void ByteComparer::work(QAtomicInt const& stop_flag) {
+    while (stop_flag == 0) {
+        QVector<quint32> files;
+        {
+            QMutexLocker locker(&lock);
+            if (buckets.empty()) { break; }
+            files = buckets.takeLast();
+        }
+        compare(files, stop_flag);
+    }
+}
+
+// the bucket is refined block by block. Members agreeing so far form a
+// class, at most max_classes distinct blocks are kept at a time and the
+// files matching none of them are compared again at the same offset.
+void ByteComparer::compare(QVector<quint32> const& files, QAtomicInt const& stop_flag) {
+    struct Pending {
+        QVector<quint32> files;
+        qint64 offset;
+    };
+
+    qint64 size = store->size(files.front());
+    FileCache cache(store);
+    QByteArray scratch(compare_block, Qt::Uninitialized);
+    QVector<QByteArray> blocks(max_classes, QByteArray(compare_block, Qt::Uninitialized));
+    QVector<QVector<quint32>> classes(max_classes);
+
+    QVector<Pending> pending = {{files, 0}};
+    while (!pending.empty() && stop_flag == 0) {
+        Pending current = pending.takeLast();
+        if (current.files.size() < 2 || current.offset >= size) {
+            for (auto file : current.files) {
+                cache.release(file);
+            }
+            finish_class(current.files, stop_flag);
+            continue;
+        }
+
+        int length = static_cast<int>(qMin<qint64>(compare_block, size - current.offset));
+        int count = 0;
+        QVector<quint32> rest;
+        cache.set_cycling(current.files.size() > max_open);
+        for (auto file : current.files) {
+            int fd = cache.get(file);
+            qint64 got = fd < 0 ? -1 : read_block(fd, current.offset, length, scratch.data());
+            if (got != length) { // unreadable or changed since the walk
+                cache.release(file);
+                finish_class({file}, stop_flag);
+                continue;
+            }
+            read_bytes.fetchAndAddRelaxed(length);
+
+            int i = 0;
+            while (i < count && memcmp(blocks[i].constData(), scratch.constData(), length) != 0) {
+                i++;
+            }
+            if (i < count) {
+                classes[i].push_back(file);
+            } else if (count < max_classes) {
+                blocks[count].swap(scratch);
+                classes[count] = {file};
+                count++;
+            } else {
+                rest.push_back(file);
+            }
+        }
+
+        if (!rest.empty()) {
+            pending.push_back({rest, current.offset});
+        }
+        for (int i = 0; i < count; i++) {
+            pending.push_back({classes[i], current.offset + length});
+        }
+    }
+}
+
+// files of a class get the same id as their digest and go back to the engine
+void ByteComparer::finish_class(QVector<quint32> const& files, QAtomicInt const& stop_flag) {
+    if (files.empty()) { return; }
+    quint64 id = next_class.fetchAndAddRelaxed(1);
+    QByteArray digest(Digest::width, 0);
+    memcpy(digest.data(), &id, sizeof(id));
+
+    qint64 size = store->size(files.front());
+    bool partial = size >= options.partial_min_size && size > 2 * options.block_size;
+    if (files.size() > 1 || !partial) {
+        hash_bytes.fetchAndAddRelaxed(size * files.size());
+    } else {
+        hash_bytes.fetchAndAddRelaxed(2 * options.block_size);
+    }
+
+    for (auto file : files) {
+        store->set_digest(file, digest);
+        ring->push(file, stop_flag);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef BYTECOMPARER_H
+#define BYTECOMPARER_H
+
+#include "scanoptions.h"
+#include "recordstore.h"
+
+#include <QMutex>
+#include <QVector>
+
+class ResultRing;
+
+// splits size buckets into groups of identical files by reading all
+// members side by side and comparing their blocks. A file leaves its
+// bucket at the first block that differs, so most files that are not
+// duplicates cost a single block. Nothing is hashed: every final class
+// gets an id in place of a digest, equal ids mean equal bytes.
+class ByteComparer {
+public:
+    ByteComparer();
+
+    void set_store(RecordStore* store);
+    void set_ring(ResultRing* ring);
+    void set_options(ScanOptions const& options);
+
+    // engine side, files of a bucket have the same size
+    void add_bucket(QVector<quint32> const& files);
+    void clear();
+
+    // blocks until every bucket is split or stop_flag is set
+    void run(QAtomicInt const& stop_flag, int threads);
+
+    // buckets no thread has taken yet
+    int pending_buckets();
+
+    qint64 bytes_read() const;
+    // what hashing would have read at least for the same buckets
+    qint64 bytes_hash_path() const;
+
+private:
+    friend class CompareThread;
+
+    void work(QAtomicInt const& stop_flag);
+    void compare(QVector<quint32> const& files, QAtomicInt const& stop_flag);
+    void finish_class(QVector<quint32> const& files, QAtomicInt const& stop_flag);
+
+    RecordStore* store;
+    ResultRing* ring;
+    ScanOptions options;
+
+    QMutex lock;
+    QVector<QVector<quint32>> buckets;
+
+    QAtomicInteger<quint64> next_class;
+    QAtomicInteger<qint64> read_bytes;
+    QAtomicInteger<qint64> hash_bytes;
+};
+
+#endif // BYTECOMPARER_H
@@ -0,0 +1,105 @@
+#include "chunker.h"
+
+namespace {
+
+// one random word per byte value, the same on every run
+struct GearTable {
+    quint64 words[256];
+
+    GearTable() {
+        quint64 state = 0x9e3779b97f4a7c15ULL;
+        for (auto& word : words) { // splitmix64
+            state += 0x9e3779b97f4a7c15ULL;
+            quint64 x = state;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            word = x ^ (x >> 31);
+        }
+    }
+};
+
+const GearTable gear;
+
+// bit i of the gear hash depends on the last i + 1 bytes only, masks take
+// the top bits so a cut depends on a 64 byte window
+quint64 top_bits(int bits) {
+    return bits <= 0 ? 0 : ~quint64(0) << (64 - bits);
+}
+
+}
+
+Chunker::Chunker(qint64 average_size, Sink const& sink) : sink(sink), fingerprint(Digest::create(DigestType::XxHash64x4)),
+    minimum(0), normal(0), maximum(0), mask_small(0), mask_large(0), hash(0), position(0) {
+    int bits = 8;
+    while (bits < 30 && (qint64(1) << (bits + 1)) <= average_size) {
+        bits++;
+    }
+    normal = qint64(1) << bits;
+    minimum = normal / 4;
+    maximum = normal * 8;
+    // two bits either way of the average, as FastCDC normalizes
+    mask_small = top_bits(bits + 2);
+    mask_large = top_bits(bits - 2);
+}
+
+void Chunker::reset() {
+    fingerprint->reset();
+    hash = 0;
+    position = 0;
+}
+
+void Chunker::add_data(char const* data, qint64 length) {
+    auto bytes = reinterpret_cast<uchar const*>(data);
+    qint64 begin = 0;
+    qint64 i = 0;
+    while (i < length) {
+        if (position < minimum) { // nothing cuts here, the bytes are not even rolled
+            qint64 skip = qMin(length - i, minimum - position);
+            i += skip;
+            position += skip;
+            continue;
+        }
+
+        quint64 mask = position < normal ? mask_small : mask_large;
+        qint64 end = qMin(length, i + (position < normal ? normal : maximum) - position);
+        quint64 h = hash;
+        qint64 j = i;
+        bool found = false;
+        while (j < end) {
+            h = (h << 1) + gear.words[bytes[j++]];
+            if ((h & mask) == 0) {
+                found = true;
+                break;
+            }
+        }
+        hash = h;
+        position += j - i;
+        i = j;
+        if (found || position == maximum) {
+            fingerprint->add_data(data + begin, i - begin);
+            begin = i;
+            cut();
+        }
+    }
+    fingerprint->add_data(data + begin, length - begin);
+}
+
+QByteArray Chunker::result() {
+    if (position > 0) {
+        cut();
+    }
+    return QByteArray();
+}
+
+qint64 Chunker::min_size() const {
+    return minimum;
+}
+
+qint64 Chunker::max_size() const {
+    return maximum;
+}
+
+void Chunker::cut() {
+    sink(position, fingerprint->result());
+    reset();
+}
@@ -0,0 +1,50 @@
+#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include "digest.h"
+
+#include <QByteArray>
+#include <QScopedPointer>
+
+#include <functional>
+
+// content defined chunking in the FastCDC way: a gear hash rolls over the
+// bytes and cuts where its top bits are zero. No cut is looked for below
+// a quarter of the average size, a stricter mask applies up to the average
+// and a looser one after it, so chunk sizes bunch around the average, and
+// a chunk never grows past eight times it. Equal data cuts at equal places
+// whatever precedes it, so files that share most of their content share
+// most of their chunks.
+//
+// It takes file contents as a digest does, so any FileReader feeds it, and
+// reports each chunk with a fingerprint of its bytes.
+class Chunker : public Digest {
+public:
+    typedef std::function<void(qint64 length, QByteArray const& fingerprint)> Sink;
+
+    // the average is rounded down to a power of two
+    Chunker(qint64 average_size, Sink const& sink);
+
+    void reset() override;
+    void add_data(char const* data, qint64 length) override;
+    // cuts the last chunk, there is no digest of the whole
+    QByteArray result() override;
+
+    qint64 min_size() const;
+    qint64 max_size() const;
+
+private:
+    void cut();
+
+    Sink sink;
+    QScopedPointer<Digest> fingerprint;
+    qint64 minimum;
+    qint64 normal;
+    qint64 maximum;
+    quint64 mask_small;
+    quint64 mask_large;
+    quint64 hash;
+    qint64 position;
+};
+
+#endif // CHUNKER_H
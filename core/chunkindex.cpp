@@ -0,0 +1,176 @@
+#include "chunkindex.h"
+
+#include "chunker.h"
+#include "filereader.h"
+
+#include <QElapsedTimer>
+#include <QScopedPointer>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <functional>
+
+namespace {
+
+const int progress_interval = 100;
+// a slot and its flag at the lowest load the table keeps, with the old
+// slots alive while it grows
+const qint64 owner_bytes = 100;
+// a hash node with its allocation
+const qint64 pair_bytes = 64;
+
+}
+
+ChunkIndex::ChunkIndex() : store(nullptr), options(), files(), owners(), max_owners(0), pairs(), max_pairs(0), current(),
+    sample_shift(0), files_done(0), files_failed(0), bytes_read(0), chunks_seen(0), bytes_savable(0) {}
+
+void ChunkIndex::set_store(RecordStore const* store) {
+    this->store = store;
+}
+
+void ChunkIndex::set_options(ScanOptions const& options) {
+    this->options = options;
+}
+
+// the rate is the highest at which the chunks expected from these files fit
+void ChunkIndex::set_files(QVector<quint32> const& files) {
+    clear();
+    this->files = files;
+    max_owners = int(qBound<qint64>(16, options.chunk_memory * 3 / 4 / owner_bytes, INT_MAX / 4));
+    max_pairs = int(qBound<qint64>(2, options.chunk_memory / 4 / pair_bytes, INT_MAX / 4));
+
+    qint64 bytes = 0;
+    for (auto file : files) {
+        bytes += store->size(file);
+    }
+    qint64 expected = bytes / qMax<qint64>(options.chunk_size, 1) + files.size();
+    while (sample_shift < 32 && (expected >> sample_shift) >= max_owners) {
+        sample_shift++;
+    }
+    owners.reserve(int(qMin<qint64>(expected >> sample_shift, max_owners)));
+}
+
+void ChunkIndex::clear() {
+    files.clear();
+    owners.clear();
+    pairs.clear();
+    current.clear();
+    sample_shift = 0;
+    files_done = 0;
+    files_failed = 0;
+    bytes_read = 0;
+    chunks_seen = 0;
+    bytes_savable = 0;
+}
+
+void ChunkIndex::run(QAtomicInt const& stop_flag, Progress const& progress) {
+    QScopedPointer<FileReader> reader(FileReader::create(options.read_strategy, options.drop_cache));
+    quint32 file = RecordStore::none;
+    Chunker chunker(options.chunk_size, [this, &file](qint64 length, QByteArray const& fingerprint) {
+        add_chunk(file, length, fingerprint);
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < files.size() && stop_flag == 0; i++) {
+        file = files[i];
+        chunker.reset();
+        current.clear();
+        if (reader->read(store->native_path(file), {{0, -1}}, &chunker)) {
+            chunker.result();
+            end_file(file);
+            files_done++;
+            bytes_read += store->size(file);
+        } else {
+            files_failed++; // chunks read before the error stay indexed
+        }
+
+        if (timer.elapsed() >= progress_interval) {
+            progress(files_done + files_failed, files.size(), bytes_read);
+            timer.restart();
+        }
+    }
+    progress(files_done + files_failed, files.size(), bytes_read);
+}
+
+ChunkReport ChunkIndex::report(int limit) const {
+    ChunkReport report;
+    report.files = files_done;
+    report.failed = files_failed;
+    report.bytes = bytes_read;
+    report.chunks = chunks_seen;
+    report.sample_shift = sample_shift;
+    report.bytes_savable = bytes_savable;
+    for (auto it = pairs.begin(); it != pairs.end(); ++it) {
+        report.pairs.push_back({quint32(it.key() >> 32), quint32(it.key()), it.value()});
+    }
+    std::sort(report.pairs.begin(), report.pairs.end(), [](ChunkPair const& a, ChunkPair const& b) {
+        return a.shared > b.shared;
+    });
+    if (report.pairs.size() > limit) {
+        report.pairs.resize(limit);
+    }
+    return report;
+}
+
+void ChunkIndex::add_chunk(quint32 file, qint64 length, QByteArray const& fingerprint) {
+    chunks_seen++;
+    ChunkKey key;
+    memcpy(&key, fingerprint.constData(), sizeof(key));
+    if (key.high & ((quint64(1) << sample_shift) - 1)) { return; }
+
+    auto owner = owners.find(key);
+    if (owner == nullptr) {
+        owners.insert(key, file);
+        if (owners.size() >= max_owners) {
+            sample_less();
+        }
+        return;
+    }
+    qint64 scaled = length << sample_shift;
+    bytes_savable += scaled;
+    if (*owner != file) { // repeats within a file are savable but shared with no one
+        current[*owner] += scaled;
+    }
+}
+
+void ChunkIndex::end_file(quint32 file) {
+    for (auto it = current.begin(); it != current.end(); ++it) {
+        pairs[(quint64(it.key()) << 32) | file] += it.value();
+    }
+    current.clear();
+    if (pairs.size() > max_pairs) {
+        prune_pairs();
+    }
+}
+
+// bytes counted so far keep the scale they were counted at
+void ChunkIndex::sample_less() {
+    sample_shift++;
+    quint64 mask = (quint64(1) << sample_shift) - 1;
+    owners.remove_if([mask](ChunkKey const& key, quint32) {
+        return (key.high & mask) != 0;
+    });
+}
+
+// keeps the half sharing the most
+void ChunkIndex::prune_pairs() {
+    QVector<qint64> shared;
+    shared.reserve(pairs.size());
+    for (auto value : pairs) {
+        shared.push_back(value);
+    }
+    int keep = max_pairs / 2;
+    std::nth_element(shared.begin(), shared.begin() + keep, shared.end(), std::greater<qint64>());
+    qint64 threshold = shared[keep];
+    int excess = pairs.size() - keep;
+    for (auto it = pairs.begin(); it != pairs.end() && excess > 0;) {
+        if (it.value() <= threshold) {
+            it = pairs.erase(it);
+            excess--;
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef CHUNKINDEX_H
+#define CHUNKINDEX_H
+
+#include "flatindex.h"
+#include "recordstore.h"
+#include "scanoptions.h"
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QVector>
+
+#include <functional>
+
+// two files and the bytes of chunks they share, first is the earlier file
+struct ChunkPair {
+    quint32 first;
+    quint32 second;
+    qint64 shared;
+};
+
+// what chunk level dedupe would add to the groups of whole files.
+// Byte counts of sampled chunks are scaled up, so they are estimates
+// once sample_shift is above 0.
+struct ChunkReport {
+    int files = 0;
+    int failed = 0;
+    qint64 bytes = 0;
+    qint64 chunks = 0;
+    // one chunk fingerprint in 2^sample_shift is indexed
+    int sample_shift = 0;
+    qint64 bytes_savable = 0;
+    // pairs sharing the most bytes first
+    QVector<ChunkPair> pairs;
+};
+
+// splits files into content defined chunks and indexes the chunk
+// fingerprints, off the GUI thread like the reclaimer. Each chunk seen
+// before counts as savable, and as shared between its file and the file
+// that had it first.
+//
+// Memory stays within options.chunk_memory however much is read: the
+// sampling rate is chosen from the bytes to read so the expected chunks
+// fit, and if the index fills up anyway the rate is halved and the
+// fingerprints no longer sampled are dropped. Fingerprints are sampled
+// by their value, so a chunk is either indexed in every file or in none
+// and shared chunks are found at any rate. Pairs get a quarter of the
+// budget, the ones sharing least are dropped when it is spent.
+class ChunkIndex {
+public:
+    typedef std::function<void(int done, int total, qint64 bytes)> Progress;
+
+    ChunkIndex();
+
+    void set_store(RecordStore const* store);
+    // must not be called while it runs
+    void set_options(ScanOptions const& options);
+    void set_files(QVector<quint32> const& files);
+    void clear();
+
+    void run(QAtomicInt const& stop_flag, Progress const& progress);
+    // complete once run has returned
+    ChunkReport report(int limit) const;
+
+private:
+    void add_chunk(quint32 file, qint64 length, QByteArray const& fingerprint);
+    void end_file(quint32 file);
+    void sample_less();
+    void prune_pairs();
+
+    RecordStore const* store;
+    ScanOptions options;
+    QVector<quint32> files;
+
+    // fingerprint to the first file it was seen in
+    FlatIndex<ChunkKey, quint32> owners;
+    int max_owners;
+    // both files of a pair in one word, the earlier in the high half
+    QHash<quint64, qint64> pairs;
+    int max_pairs;
+    // shared bytes of the current file with each earlier one
+    QHash<quint32, qint64> current;
+
+    int sample_shift;
+    int files_done;
+    int files_failed;
+    qint64 bytes_read;
+    qint64 chunks_seen;
+    qint64 bytes_savable;
+};
+
+#endif // CHUNKINDEX_H
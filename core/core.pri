@@ -0,0 +1,9 @@
+# link against the engine library from a sibling project
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+LIBS += -L$$OUT_PWD/../core -lfindduplicates-core
+PRE_TARGETDEPS += $$OUT_PWD/../core/libfindduplicates-core.a
+
+include($$PWD/liburing.pri)
@@ -0,0 +1,64 @@
+# scan, group and hash engine, depends on QtCore only
+
+QT       += core
+QT       -= gui
+
+TARGET = findduplicates-core
+TEMPLATE = lib
+CONFIG += staticlib c++11
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(liburing.pri)
+
+SOURCES += \
+    hashworker.cpp \
+    hashpool.cpp \
+    digest.cpp \
+    hashcache.cpp \
+    dirwalker.cpp \
+    scanengine.cpp \
+    resultring.cpp \
+    recordstore.cpp \
+    filereader.cpp \
+    bytecomparer.cpp \
+    telemetry.cpp \
+    devicescheduler.cpp \
+    reclaimer.cpp \
+    treewatcher.cpp \
+    pathfilter.cpp \
+    scanprofile.cpp \
+    snapshot.cpp \
+    snapshotmerger.cpp \
+    referenceindex.cpp \
+    chunker.cpp \
+    chunkindex.cpp \
+    scancontrol.cpp \
+    sizeruns.cpp
+
+HEADERS += \
+    hashworker.h \
+    hashpool.h \
+    scanoptions.h \
+    digest.h \
+    hashcache.h \
+    dirwalker.h \
+    scanengine.h \
+    resultring.h \
+    recordstore.h \
+    flatindex.h \
+    filereader.h \
+    bytecomparer.h \
+    telemetry.h \
+    devicescheduler.h \
+    reclaimer.h \
+    treewatcher.h \
+    pathfilter.h \
+    scanprofile.h \
+    snapshot.h \
+    snapshotmerger.h \
+    referenceindex.h \
+    chunker.h \
+    chunkindex.h \
+    scancontrol.h \
+    sizeruns.h
@@ -0,0 +1,152 @@
+#include "devicescheduler.h"
+
+#include <QFile>
+#include <QMutexLocker>
+
+#include <sys/sysmacros.h>
+
+DeviceScheduler::DeviceScheduler() : lock(), has_work(), queues(), devices(), next(0), waiting(0), running(0),
+    rotational_limit(1), solid_limit(0) {}
+
+DeviceScheduler::~DeviceScheduler() {
+    qDeleteAll(queues);
+}
+
+void DeviceScheduler::set_limits(int rotational, int solid) {
+    QMutexLocker locker(&lock);
+    rotational_limit = rotational;
+    solid_limit = solid;
+    has_work.wakeAll();
+}
+
+bool DeviceScheduler::rotational(quint64 device) {
+    QMutexLocker locker(&lock);
+    return queue(device)->rotational;
+}
+
+// a partition has no queue of its own, the one of its disk is one level up
+DeviceScheduler::Queue* DeviceScheduler::queue(quint64 device) {
+    auto it = queues.find(device);
+    if (it != queues.end()) {
+        return it.value();
+    }
+
+    QString base = QString("/sys/dev/block/%1:%2/").arg(major(device)).arg(minor(device));
+    QFile file(base + "queue/rotational");
+    if (!file.exists()) {
+        file.setFileName(base + "../queue/rotational");
+    }
+    bool rotational = file.open(QIODevice::ReadOnly) && file.read(1) == "1";
+
+    auto queue = new Queue{rotational, 0, 0, QMultiMap<qint64, quint32>(), QList<quint32>(), QList<quint32>()};
+    queues.insert(device, queue);
+    devices.push_back(device);
+    return queue;
+}
+
+int DeviceScheduler::limit(Queue const* queue) const {
+    return queue->rotational ? rotational_limit : solid_limit;
+}
+
+void DeviceScheduler::add(quint32 file, quint64 device) {
+    QMutexLocker locker(&lock);
+    auto queue = this->queue(device);
+    if (queue->rotational) {
+        queue->unplaced.push_back(file);
+    } else {
+        queue->fifo.push_back(file);
+    }
+    waiting++;
+    has_work.wakeOne();
+}
+
+// the head moves up the disk and starts over at the lowest offset
+bool DeviceScheduler::take_from(Queue* queue, quint32& file, bool& unplaced) {
+    unplaced = !queue->unplaced.empty();
+    if (unplaced) {
+        file = queue->unplaced.takeFirst();
+        return true;
+    }
+    if (!queue->fifo.empty()) {
+        file = queue->fifo.takeFirst();
+        return true;
+    }
+    if (queue->by_position.empty()) {
+        return false;
+    }
+    auto it = queue->by_position.lowerBound(queue->head);
+    if (it == queue->by_position.end()) {
+        it = queue->by_position.begin();
+    }
+    queue->head = it.key();
+    file = it.value();
+    queue->by_position.erase(it);
+    return true;
+}
+
+// devices take turns, so one with a long queue does not starve the others
+bool DeviceScheduler::take(QAtomicInt const& quit, quint32& file, quint64& device, bool& unplaced) {
+    QMutexLocker locker(&lock);
+    while (quit == 0) {
+        for (int i = 0; waiting > 0 && i < devices.size(); i++) {
+            int index = (next + i) % devices.size();
+            auto queue = queues[devices[index]];
+            int max = limit(queue);
+            if (max > 0 && queue->active >= max) { continue; }
+            if (!take_from(queue, file, unplaced)) { continue; }
+            queue->active++;
+            waiting--;
+            running++;
+            device = devices[index];
+            next = index + 1;
+            return true;
+        }
+        has_work.wait(&lock);
+    }
+    return false;
+}
+
+void DeviceScheduler::done(quint64 device) {
+    QMutexLocker locker(&lock);
+    queues[device]->active--;
+    running--;
+    has_work.wakeOne();
+}
+
+void DeviceScheduler::place(quint32 file, quint64 device, qint64 position) {
+    QMutexLocker locker(&lock);
+    auto queue = queues[device];
+    queue->by_position.insert(position, file);
+    queue->active--;
+    running--;
+    waiting++;
+    has_work.wakeOne();
+}
+
+void DeviceScheduler::wake_all() {
+    QMutexLocker locker(&lock);
+    has_work.wakeAll();
+}
+
+int DeviceScheduler::clear() {
+    QMutexLocker locker(&lock);
+    for (auto queue : queues) {
+        queue->by_position.clear();
+        queue->fifo.clear();
+        queue->unplaced.clear();
+        queue->head = 0;
+    }
+    int dropped = waiting;
+    waiting = 0;
+    return dropped;
+}
+
+int DeviceScheduler::queued() {
+    QMutexLocker locker(&lock);
+    return waiting;
+}
+
+int DeviceScheduler::active() {
+    QMutexLocker locker(&lock);
+    return running;
+}
@@ -0,0 +1,68 @@
+#ifndef DEVICESCHEDULER_H
+#define DEVICESCHEDULER_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
+
+// files waiting to be read, queued per block device. Each device has its
+// own limit of files read at once, so a slow disk takes few threads and
+// the others keep the rest busy. Rotational disks are read in one sweep
+// over the platter, by the physical offset of each file. Offsets are
+// looked up by the threads that read, a file of a rotational disk is
+// handed out once to be placed and once to be read.
+class DeviceScheduler {
+public:
+    DeviceScheduler();
+    ~DeviceScheduler();
+
+    // limits of rotational and other devices, 0 for no limit
+    void set_limits(int rotational, int solid);
+    // read from sysfs once per device, devices without a queue count as solid
+    bool rotational(quint64 device);
+
+    void add(quint32 file, quint64 device);
+    // waits for a file of a device below its limit, false once quit is set.
+    // unplaced files of rotational devices come first, with unplaced set
+    bool take(QAtomicInt const& quit, quint32& file, quint64& device, bool& unplaced);
+    // the file taken from device is read
+    void done(quint64 device);
+    // queues the unplaced file taken from device by where its data starts
+    void place(quint32 file, quint64 device, qint64 position);
+    void wake_all();
+
+    // drops queued files, files being read are still reported done
+    int clear();
+    int queued();
+    int active();
+
+private:
+    struct Queue {
+        bool rotational;
+        int active;
+        qint64 head;
+        QMultiMap<qint64, quint32> by_position;
+        QList<quint32> fifo;
+        QList<quint32> unplaced;
+    };
+
+    Queue* queue(quint64 device);
+    bool take_from(Queue* queue, quint32& file, bool& unplaced);
+    int limit(Queue const* queue) const;
+
+    QMutex lock;
+    QWaitCondition has_work;
+    QHash<quint64, Queue*> queues;
+    QVector<quint64> devices;
+    int next;
+    int waiting;
+    int running;
+    int rotational_limit;
+    int solid_limit;
+};
+
+#endif // DEVICESCHEDULER_H
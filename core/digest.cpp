@@ -0,0 +1,391 @@
+#include "digest.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+
+#include <cstring>
+
+namespace {
+
+const qint64 read_chunk = 1 << 20;
+
+class CryptoDigest : public Digest {
+public:
+    explicit CryptoDigest(QCryptographicHash::Algorithm algorithm) : hash(algorithm) {}
+
+    void reset() override {
+        hash.reset();
+    }
+
+    void add_data(char const* data, qint64 length) override {
+        hash.addData(data, static_cast<int>(length));
+    }
+
+    QByteArray result() override {
+        return hash.result().left(width);
+    }
+
+private:
+    QCryptographicHash hash;
+};
+
+const quint64 prime1 = 11400714785074694791ULL;
+const quint64 prime2 = 14029467366897019727ULL;
+const quint64 prime3 = 1609587929392839161ULL;
+const quint64 prime4 = 9650029242287828579ULL;
+const quint64 prime5 = 2870177450012600261ULL;
+
+inline quint64 rotl(quint64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline quint64 read64(uchar const* p) {
+    quint64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline quint64 read32(uchar const* p) {
+    quint32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline quint64 xx_round(quint64 acc, quint64 input) {
+    acc += input * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
+
+inline quint64 merge_round(quint64 acc, quint64 value) {
+    acc ^= xx_round(0, value);
+    return acc * prime1 + prime4;
+}
+
+// XXH64 run with several seeds over the same stripes,
+// the lanes are independent so the inner loop vectorizes
+class XxDigest : public Digest {
+public:
+    static const int seeds = width / 8;
+
+    XxDigest() {
+        reset();
+    }
+
+    void reset() override {
+        for (int s = 0; s < seeds; s++) {
+            quint64 seed = s * prime5;
+            lanes[s][0] = seed + prime1 + prime2;
+            lanes[s][1] = seed + prime2;
+            lanes[s][2] = seed;
+            lanes[s][3] = seed - prime1;
+        }
+        total = 0;
+        buffered = 0;
+    }
+
+    void add_data(char const* data, qint64 length) override {
+        auto p = reinterpret_cast<uchar const*>(data);
+        total += length;
+        if (buffered > 0) {
+            qint64 take = qMin(length, 32 - buffered);
+            memcpy(buffer + buffered, p, take);
+            buffered += take;
+            p += take;
+            length -= take;
+            if (buffered < 32) { return; }
+            stripes(buffer, 1);
+            buffered = 0;
+        }
+        qint64 count = length / 32;
+        stripes(p, count);
+        p += count * 32;
+        length -= count * 32;
+        memcpy(buffer, p, length);
+        buffered = length;
+    }
+
+    QByteArray result() override {
+        QByteArray out(width, 0);
+        for (int s = 0; s < seeds; s++) {
+            quint64 h;
+            auto const* v = lanes[s];
+            if (total >= 32) {
+                h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+                for (int i = 0; i < 4; i++) {
+                    h = merge_round(h, v[i]);
+                }
+            } else {
+                h = v[2] + prime5;
+            }
+            h += total;
+
+            uchar const* p = buffer;
+            qint64 left = buffered;
+            while (left >= 8) {
+                h ^= xx_round(0, read64(p));
+                h = rotl(h, 27) * prime1 + prime4;
+                p += 8;
+                left -= 8;
+            }
+            if (left >= 4) {
+                h ^= read32(p) * prime1;
+                h = rotl(h, 23) * prime2 + prime3;
+                p += 4;
+                left -= 4;
+            }
+            while (left > 0) {
+                h ^= *p * prime5;
+                h = rotl(h, 11) * prime1;
+                p++;
+                left--;
+            }
+            h ^= h >> 33;
+            h *= prime2;
+            h ^= h >> 29;
+            h *= prime3;
+            h ^= h >> 32;
+
+            for (int i = 0; i < 8; i++) {
+                out[s * 8 + i] = static_cast<char>(h >> (56 - 8 * i));
+            }
+        }
+        return out;
+    }
+
+private:
+    void stripes(uchar const* p, qint64 count) {
+        for (qint64 i = 0; i < count; i++, p += 32) {
+            for (int s = 0; s < seeds; s++) {
+                for (int l = 0; l < 4; l++) {
+                    lanes[s][l] = xx_round(lanes[s][l], read64(p + 8 * l));
+                }
+            }
+        }
+    }
+
+    quint64 lanes[seeds][4];
+    uchar buffer[32];
+    qint64 buffered;
+    qint64 total;
+};
+
+
+const quint64 blake_iv[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+const uchar blake_sigma[12][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3}
+};
+
+inline quint64 rotr(quint64 x, int r) {
+    return (x >> r) | (x << (64 - r));
+}
+
+// BLAKE2b with a 32 byte result and no key (RFC 7693), QCryptographicHash
+// only has it from Qt 6
+class Blake2Digest : public Digest {
+public:
+    static const int block = 128;
+
+    Blake2Digest() {
+        reset();
+    }
+
+    void reset() override {
+        for (int i = 0; i < 8; i++) {
+            h[i] = blake_iv[i];
+        }
+        h[0] ^= 0x01010000ULL ^ width; // depth 1, fanout 1, no key
+        total = 0;
+        buffered = 0;
+    }
+
+    void add_data(char const* data, qint64 length) override {
+        auto p = reinterpret_cast<uchar const*>(data);
+        // the last block is compressed by result(), so a full buffer waits
+        // until more data comes
+        while (length > 0) {
+            if (buffered == block) {
+                total += block;
+                compress(buffer, false);
+                buffered = 0;
+            }
+            qint64 take = qMin(length, block - buffered);
+            memcpy(buffer + buffered, p, take);
+            buffered += take;
+            p += take;
+            length -= take;
+        }
+    }
+
+    QByteArray result() override {
+        total += buffered;
+        memset(buffer + buffered, 0, block - buffered);
+        compress(buffer, true);
+        QByteArray out(width, 0);
+        for (int i = 0; i < width; i++) {
+            out[i] = static_cast<char>(h[i / 8] >> (8 * (i % 8)));
+        }
+        return out;
+    }
+
+private:
+    static void mix(quint64* v, int a, int b, int c, int d, quint64 x, quint64 y) {
+        v[a] = v[a] + v[b] + x;
+        v[d] = rotr(v[d] ^ v[a], 32);
+        v[c] = v[c] + v[d];
+        v[b] = rotr(v[b] ^ v[c], 24);
+        v[a] = v[a] + v[b] + y;
+        v[d] = rotr(v[d] ^ v[a], 16);
+        v[c] = v[c] + v[d];
+        v[b] = rotr(v[b] ^ v[c], 63);
+    }
+
+    void compress(uchar const* p, bool last) {
+        quint64 m[16];
+        quint64 v[16];
+        for (int i = 0; i < 16; i++) {
+            m[i] = read64(p + 8 * i);
+        }
+        for (int i = 0; i < 8; i++) {
+            v[i] = h[i];
+            v[i + 8] = blake_iv[i];
+        }
+        v[12] ^= total; // files stay far below 2^64 bytes, the high word is 0
+        if (last) { v[14] = ~v[14]; }
+        for (auto const& s : blake_sigma) {
+            mix(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+            mix(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+            mix(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+            mix(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+            mix(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+            mix(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+            mix(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+            mix(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+        }
+        for (int i = 0; i < 8; i++) {
+            h[i] ^= v[i] ^ v[i + 8];
+        }
+    }
+
+    quint64 h[8];
+    uchar buffer[block];
+    qint64 buffered;
+    quint64 total;
+};
+
+}
+
+void Digest::add_data(QByteArray const& data) {
+    add_data(data.constData(), data.size());
+}
+
+bool Digest::add_data(QIODevice* device) {
+    if (!device->isReadable()) {
+        return false;
+    }
+    QByteArray buffer(read_chunk, Qt::Uninitialized);
+    qint64 length;
+    while ((length = device->read(buffer.data(), read_chunk)) > 0) {
+        add_data(buffer.constData(), length);
+    }
+    return length == 0;
+}
+
+Digest* Digest::create(DigestType type) {
+    switch (type) {
+    case DigestType::Blake2b_256:
+        return new Blake2Digest();
+    case DigestType::Sha256:
+        return new CryptoDigest(QCryptographicHash::Sha256);
+    case DigestType::XxHash64x4:
+        return new XxDigest();
+    default:
+        return new CryptoDigest(QCryptographicHash::Sha3_512);
+    }
+}
+
+QString Digest::name(DigestType type) {
+    switch (type) {
+    case DigestType::Blake2b_256:
+        return "BLAKE2b-256";
+    case DigestType::Sha256:
+        return "SHA-256";
+    case DigestType::XxHash64x4:
+        return "xxHash64 x4";
+    default:
+        return "SHA3-512";
+    }
+}
+
+QString Digest::key(DigestType type) {
+    switch (type) {
+    case DigestType::Blake2b_256:
+        return "blake2b";
+    case DigestType::Sha256:
+        return "sha256";
+    case DigestType::XxHash64x4:
+        return "xxhash";
+    default:
+        return "sha3";
+    }
+}
+
+bool Digest::parse(QString const& key, DigestType& type) {
+    for (auto candidate : types()) {
+        if (Digest::key(candidate).compare(key, Qt::CaseInsensitive) == 0) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+QVector<DigestType> Digest::types() {
+    return {DigestType::Sha3_512, DigestType::Blake2b_256, DigestType::Sha256, DigestType::XxHash64x4};
+}
+
+bool Digest::cryptographic(DigestType type) {
+    return type != DigestType::XxHash64x4;
+}
+
+bool same_content(QString const& first, QString const& second) {
+    QFile a(first);
+    QFile b(second);
+    if (!a.open(QIODevice::ReadOnly) || !b.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    QByteArray buffer_a(read_chunk, Qt::Uninitialized);
+    QByteArray buffer_b(read_chunk, Qt::Uninitialized);
+    while (true) {
+        qint64 length_a = a.read(buffer_a.data(), read_chunk);
+        qint64 length_b = b.read(buffer_b.data(), read_chunk);
+        if (length_a != length_b || length_a < 0) {
+            return false;
+        }
+        if (length_a == 0) {
+            return true;
+        }
+        if (memcmp(buffer_a.constData(), buffer_b.constData(), length_a) != 0) {
+            return false;
+        }
+    }
+}
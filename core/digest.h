@@ -0,0 +1,42 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <QVector>
+
+enum class DigestType {
+    Sha3_512,
+    Blake2b_256,
+    Sha256,
+    XxHash64x4
+};
+
+// content hash of a file, result is always width bytes of binary
+class Digest {
+public:
+    static const int width = 32;
+
+    virtual ~Digest() {}
+
+    virtual void reset() = 0;
+    virtual void add_data(char const* data, qint64 length) = 0;
+    virtual QByteArray result() = 0;
+
+    void add_data(QByteArray const& data);
+    bool add_data(QIODevice* device);
+
+    static Digest* create(DigestType type);
+    static QString name(DigestType type);
+    // short name for command lines: sha3, blake2b, sha256, xxhash
+    static QString key(DigestType type);
+    static bool parse(QString const& key, DigestType& type);
+    static QVector<DigestType> types();
+    static bool cryptographic(DigestType type);
+};
+
+// byte by byte comparison, used to verify before anything is deleted
+bool same_content(QString const& first, QString const& second);
+
+#endif // DIGEST_H
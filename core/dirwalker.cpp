@@ -0,0 +1,308 @@
+#include "dirwalker.h"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <algorithm>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+namespace {
+
+// FNV-1a of a name the walk leaves out, directories are only compared
+// by the sum of these within one scan
+quint64 name_hash(char const* name) {
+    quint64 hash = 14695981039346656037ULL;
+    for (; *name != 0; name++) {
+        hash = (hash ^ uchar(*name)) * 1099511628211ULL;
+    }
+    return hash | 1; // never 0, so a sum of one is not taken for none
+}
+
+// effective ids of the process, read once
+struct Identity {
+    uid_t uid;
+    gid_t gid;
+    QVector<gid_t> groups;
+
+    Identity() : uid(geteuid()), gid(getegid()), groups() {
+        int count = getgroups(0, nullptr);
+        if (count > 0) {
+            groups.resize(count);
+            groups.resize(qMax(getgroups(count, groups.data()), 0));
+        }
+    }
+};
+
+// the mode bits that apply to this process, as the kernel picks them.
+// ACLs are not seen, the hash thread still fails on a file it cannot open.
+bool may_read(struct statx const& st) {
+    static Identity const identity;
+    if (identity.uid == 0) { return true; }
+    if (st.stx_uid == identity.uid) { return st.stx_mode & S_IRUSR; }
+    if (st.stx_gid == identity.gid || identity.groups.contains(st.stx_gid)) { return st.stx_mode & S_IRGRP; }
+    return st.stx_mode & S_IROTH;
+}
+
+}
+
+class WalkThread : public QThread {
+public:
+    explicit WalkThread(DirWalker* walker) : walker(walker) {}
+
+protected:
+    void run() override {
+        walker->work();
+    }
+
+private:
+    DirWalker* walker;
+};
+
+DirWalker::DirWalker(QAtomicInt const& stop_flag, RecordStore* store, Sink const& sink, int batch_size) :
+    stop_flag(stop_flag), store(store), sink(sink), batch_size(batch_size), filter(), control(nullptr), runs(nullptr), lock(), has_work(), pending(),
+    busy(0), entry_count(0), dir_count(0), pruned_count(0), pruned_bytes(0) {}
+
+void DirWalker::set_filter(PathFilter const& filter) {
+    this->filter = filter;
+}
+
+void DirWalker::set_control(ScanControl* control) {
+    this->control = control;
+}
+
+void DirWalker::set_runs(SizeRuns* runs) {
+    this->runs = runs;
+}
+
+void DirWalker::walk(QStringList const& roots, int threads) {
+    QVector<QByteArray> paths;
+    for (auto const& root : roots) {
+        QByteArray path = QFile::encodeName(root);
+        while (path.size() > 1 && path.endsWith('/')) { // the file system root stays "/"
+            path.chop(1);
+        }
+        paths.push_back(path);
+    }
+    std::sort(paths.begin(), paths.end());
+    for (auto const& path : paths) { // outer roots sort first
+        bool nested = false;
+        for (auto const& outer : pending) {
+            nested = nested || path == outer.path || path.startsWith(RecordStore::join_path(outer.path, QByteArray()));
+        }
+        if (nested) { continue; }
+        quint64 device = 0;
+        struct statx st;
+        if (filter.one_file_system()
+                && statx(AT_FDCWD, path.constData(), 0, STATX_TYPE, &st) == 0) {
+            device = makedev(st.stx_dev_major, st.stx_dev_minor);
+        }
+        pending.push_back({path, store->add_dir(RecordStore::none, path), device});
+    }
+    busy = 0;
+
+    QVector<WalkThread*> helpers;
+    for (int i = 1; i < threads; i++) {
+        helpers.push_back(new WalkThread(this));
+        helpers.back()->start();
+    }
+    work();
+    for (auto helper : helpers) {
+        helper->wait();
+        delete helper;
+    }
+}
+
+void DirWalker::work() {
+    QVector<quint32> batch;
+    while (true) {
+        if (control != nullptr) {
+            control->pass(); // a stop is seen below
+        }
+        PendingDir dir;
+        {
+            QMutexLocker locker(&lock);
+            while (pending.empty() && busy > 0 && stop_flag == 0) {
+                has_work.wait(&lock);
+            }
+            if (pending.empty() || stop_flag != 0) {
+                has_work.wakeAll();
+                break;
+            }
+            dir = pending.takeLast();
+            busy++;
+        }
+
+        scan_dir(dir, batch);
+
+        QMutexLocker locker(&lock);
+        busy--;
+        if (busy == 0 && pending.empty()) {
+            has_work.wakeAll();
+        }
+    }
+
+    if (stop_flag == 0 && !batch.empty()) {
+        sink(batch);
+    }
+}
+
+// the entry type from readdir spares the stat of directories and symlinks,
+// files get a single statx relative to the directory
+void DirWalker::scan_dir(PendingDir const& dir, QVector<quint32>& batch) {
+    DIR* handle = opendir(dir.path.constData());
+    if (handle == nullptr) { // its content is not known at all
+        store->set_left_out(dir.id, name_hash(""));
+        return;
+    }
+    int fd = dirfd(handle);
+    dir_count.fetchAndAddRelaxed(1);
+
+    // every entry counts for the directory's digest, walked or not
+    quint64 left_out = 0;
+    QVector<QByteArray> subdirs;
+    QVector<RecordStore::FileInfo> files;
+    dirent* entry;
+    while ((entry = readdir(handle)) != nullptr && stop_flag == 0) {
+        char const* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) {
+            continue;
+        }
+        if (name[0] == '.') { // hidden files, as QDir skips them
+            left_out += name_hash(name);
+            continue;
+        }
+        entry_count.fetchAndAddRelaxed(1);
+
+        if (entry->d_type == DT_DIR) {
+            if (enter_dir(dir, fd, name)) {
+                subdirs.push_back(name);
+            } else {
+                left_out += name_hash(name);
+            }
+            continue;
+        }
+        if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN) {
+            left_out += name_hash(name);
+            continue;
+        }
+        if (entry->d_type == DT_REG && filter.skip_file(dir.path, name)) {
+            pruned_count.fetchAndAddRelaxed(1);
+            left_out += name_hash(name);
+            continue;
+        }
+
+        RecordStore::FileInfo info;
+        bool directory;
+        if (!stat_file(fd, name, info, directory)) {
+            left_out += name_hash(name);
+            continue;
+        }
+        if (directory) {
+            if (enter_dir(dir, fd, name)) {
+                subdirs.push_back(name);
+            } else {
+                left_out += name_hash(name);
+            }
+            continue;
+        }
+        if ((entry->d_type == DT_UNKNOWN && filter.skip_file(dir.path, name)) || filter.skip_size(info.size)) {
+            pruned_count.fetchAndAddRelaxed(1);
+            pruned_bytes.fetchAndAddRelaxed(info.size);
+            left_out += name_hash(name);
+            continue;
+        }
+        files.push_back(info);
+
+        if (files.size() >= batch_size) {
+            add_files(dir.id, files, batch);
+        }
+    }
+    closedir(handle);
+    add_files(dir.id, files, batch);
+    if (left_out != 0) {
+        store->set_left_out(dir.id, left_out);
+    }
+
+    if (subdirs.empty() || stop_flag != 0) { return; }
+    QVector<PendingDir> queued;
+    for (auto const& name : subdirs) {
+        queued.push_back({RecordStore::join_path(dir.path, name), store->add_dir(dir.id, name), dir.device});
+    }
+    QMutexLocker locker(&lock);
+    pending += queued;
+    has_work.wakeAll();
+}
+
+// an excluded directory or a mount point the walk must not cross is
+// left out with everything under it
+bool DirWalker::enter_dir(PendingDir const& dir, int fd, char const* name) {
+    bool skip = filter.skip_dir(dir.path, name);
+    if (!skip && filter.one_file_system() && dir.device != 0) {
+        struct statx st;
+        skip = statx(fd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, STATX_TYPE, &st) == 0
+                && makedev(st.stx_dev_major, st.stx_dev_minor) != dir.device;
+    }
+    if (skip) {
+        pruned_count.fetchAndAddRelaxed(1);
+    }
+    return !skip;
+}
+
+bool DirWalker::stat_file(int dir_fd, char const* name, RecordStore::FileInfo& info, bool& directory) {
+    struct statx st;
+    if (statx(dir_fd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+              STATX_TYPE | STATX_MODE | STATX_UID | STATX_GID | STATX_NLINK | STATX_SIZE | STATX_INO | STATX_MTIME
+              | STATX_CTIME, &st) != 0) {
+        return false;
+    }
+    directory = S_ISDIR(st.stx_mode);
+    if (directory) { return true; }
+    if (!S_ISREG(st.stx_mode)) { return false; }
+
+    info.name = name;
+    info.size = static_cast<qint64>(st.stx_size);
+    info.device = makedev(st.stx_dev_major, st.stx_dev_minor);
+    info.inode = st.stx_ino;
+    info.mtime = qint64(st.stx_mtime.tv_sec) * 1000000000 + st.stx_mtime.tv_nsec;
+    info.ctime = qint64(st.stx_ctime.tv_sec) * 1000000000 + st.stx_ctime.tv_nsec;
+    info.unreadable = !may_read(st);
+    info.linked = st.stx_nlink > 1;
+    return true;
+}
+
+void DirWalker::add_files(quint32 dir, QVector<RecordStore::FileInfo>& files, QVector<quint32>& batch) {
+    if (files.empty() || stop_flag != 0) { return; }
+    if (runs != nullptr) {
+        runs->add(dir, files);
+        files.clear();
+        return;
+    }
+    store->add_files(dir, files, batch);
+    files.clear();
+    if (batch.size() >= batch_size) {
+        sink(batch);
+        batch.clear();
+    }
+}
+
+qint64 DirWalker::entries() const {
+    return entry_count;
+}
+
+qint64 DirWalker::directories() const {
+    return dir_count;
+}
+
+qint64 DirWalker::pruned() const {
+    return pruned_count;
+}
+
+qint64 DirWalker::bytes_pruned() const {
+    return pruned_bytes;
+}
@@ -0,0 +1,79 @@
+#ifndef DIRWALKER_H
+#define DIRWALKER_H
+
+#include "recordstore.h"
+#include "pathfilter.h"
+#include "scancontrol.h"
+#include "sizeruns.h"
+
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QStringList>
+
+#include <functional>
+
+// walks a tree on several threads, one directory at a time per thread.
+// Files are added to the store and their ids reach the sink in batches.
+class DirWalker {
+public:
+    typedef std::function<void(QVector<quint32>&)> Sink;
+
+    DirWalker(QAtomicInt const& stop_flag, RecordStore* store, Sink const& sink, int batch_size = 256);
+
+    // must be set before the walk
+    void set_filter(PathFilter const& filter);
+    // pauses hold the walkers between directories
+    void set_control(ScanControl* control);
+    // out of core: files go to the runs and not to the store or the sink
+    void set_runs(SizeRuns* runs);
+    // blocks until the trees are walked or stop_flag is set. A root inside
+    // another root is walked once, as part of the outer one.
+    void walk(QStringList const& roots, int threads);
+
+    // a regular file or a directory, symlinks and the rest are skipped.
+    // name is relative to dir_fd, which may be AT_FDCWD
+    static bool stat_file(int dir_fd, char const* name, RecordStore::FileInfo& info, bool& directory);
+
+    qint64 entries() const;
+    qint64 directories() const;
+    // entries the filter left out, and the bytes of files it left out by size
+    qint64 pruned() const;
+    qint64 bytes_pruned() const;
+
+private:
+    friend class WalkThread;
+
+    struct PendingDir {
+        QByteArray path;
+        quint32 id;
+        // of the root, when the walk stays on one file system
+        quint64 device;
+    };
+
+    void work();
+    void scan_dir(PendingDir const& dir, QVector<quint32>& batch);
+    bool enter_dir(PendingDir const& dir, int fd, char const* name);
+    void add_files(quint32 dir, QVector<RecordStore::FileInfo>& files, QVector<quint32>& batch);
+
+    QAtomicInt const& stop_flag;
+    RecordStore* store;
+    Sink sink;
+    int batch_size;
+    PathFilter filter;
+    ScanControl* control;
+    SizeRuns* runs;
+
+    QMutex lock;
+    QWaitCondition has_work;
+    QVector<PendingDir> pending;
+    int busy;
+
+    QAtomicInteger<qint64> entry_count;
+    QAtomicInteger<qint64> dir_count;
+    QAtomicInteger<qint64> pruned_count;
+    QAtomicInteger<qint64> pruned_bytes;
+};
+
+#endif // DIRWALKER_H
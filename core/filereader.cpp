@@ -0,0 +1,475 @@
+#include "filereader.h"
+#include "scancontrol.h"
+
+#include <QtGlobal>
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace {
+
+// page aligned, so the kernel can copy whole pages
+char* alloc_buffer() {
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, 4096, FileReader::chunk) != 0) {
+        return nullptr;
+    }
+    return static_cast<char*>(buffer);
+}
+
+bool whole_file(QVector<ReadRange> const& ranges) {
+    return ranges.size() == 1 && ranges[0].offset == 0 && ranges[0].length < 0;
+}
+
+// large preads with the kernel reading ahead of a sequential scan
+class BufferedReader : public FileReader {
+public:
+    explicit BufferedReader(bool drop_cache) : FileReader(drop_cache), buffer(alloc_buffer()) {}
+
+    ~BufferedReader() override {
+        free(buffer);
+    }
+
+    bool read(QByteArray const& path, QVector<ReadRange> const& ranges, Digest* digest) override {
+        int fd = open_file(path);
+        if (fd < 0) { return false; }
+        posix_fadvise(fd, 0, 0, whole_file(ranges) ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+
+        bool ok = buffer != nullptr;
+        for (int i = 0; ok && i < ranges.size(); i++) {
+            ok = read_range(fd, ranges[i], digest);
+        }
+        close(fd);
+        return ok;
+    }
+
+private:
+    bool read_range(int fd, ReadRange const& range, Digest* digest) {
+        qint64 offset = range.offset;
+        qint64 left = range.length < 0 ? LLONG_MAX : range.length;
+        while (left > 0) {
+            if (!go_on()) { return false; }
+            ssize_t length = pread(fd, buffer, qMin<qint64>(left, chunk), offset);
+            if (length < 0 && errno == EINTR) { continue; }
+            if (length < 0) { return false; }
+            if (length == 0) { break; }
+            if (digest != nullptr) {
+                digest->add_data(buffer, length);
+            }
+            drop(fd, offset, length);
+            offset += length;
+            left -= length;
+        }
+        return true;
+    }
+
+    char* buffer;
+};
+
+// maps the file and hashes the pages in place, no copy at all.
+// A file truncated while it is mapped raises SIGBUS, so this is
+// meant for trees nobody writes to during the scan.
+class MappedReader : public FileReader {
+public:
+    explicit MappedReader(bool drop_cache) : FileReader(drop_cache) {}
+
+    bool read(QByteArray const& path, QVector<ReadRange> const& ranges, Digest* digest) override {
+        int fd = open_file(path);
+        if (fd < 0) { return false; }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+        }
+        qint64 size = st.st_size;
+        if (size == 0) {
+            close(fd);
+            return true;
+        }
+
+        void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        char const* data = static_cast<char const*>(map);
+        madvise(map, size, whole_file(ranges) ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+        for (auto const& range : ranges) {
+            qint64 end = range.length < 0 ? size : qMin(size, range.offset + range.length);
+            for (qint64 offset = range.offset; offset < end; offset += chunk) {
+                if (!go_on()) {
+                    munmap(map, size);
+                    close(fd);
+                    return false;
+                }
+                qint64 length = qMin<qint64>(chunk, end - offset);
+                if (digest != nullptr) {
+                    digest->add_data(data + offset, length);
+                } else {
+                    touch(data + offset, length);
+                }
+            }
+        }
+        munmap(map, size);
+        // mapped pages are only dropped once they are unmapped
+        drop(fd, 0, 0);
+        close(fd);
+        return true;
+    }
+
+private:
+    // faults the pages in when nothing reads them
+    static void touch(char const* data, qint64 length) {
+        volatile char sink = 0;
+        for (qint64 i = 0; i < length; i += 4096) {
+            sink = sink + data[i];
+        }
+    }
+};
+
+#ifdef HAVE_LIBURING
+
+// keeps depth chunks of a file in flight, they are hashed in file order
+// as they complete. Reads do not overlap across files, so only files of
+// several chunks gain and buffered reads stay the default; a range of one
+// chunk is read with a plain pread instead of a trip through the ring.
+class UringReader : public FileReader {
+public:
+    explicit UringReader(bool drop_cache) : FileReader(drop_cache), ready(false) {
+        ready = io_uring_queue_init(depth, &ring, 0) == 0;
+        for (auto& slot : slots) {
+            slot.buffer = alloc_buffer();
+            ready = ready && slot.buffer != nullptr;
+        }
+    }
+
+    ~UringReader() override {
+        if (ready) {
+            io_uring_queue_exit(&ring);
+        }
+        for (auto& slot : slots) {
+            free(slot.buffer);
+        }
+    }
+
+    bool ok() const {
+        return ready;
+    }
+
+    bool read(QByteArray const& path, QVector<ReadRange> const& ranges, Digest* digest) override {
+        if (!ready) { return false; } // the ring failed in an earlier read
+        int fd = open_file(path);
+        if (fd < 0) { return false; }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+        }
+        posix_fadvise(fd, 0, 0, whole_file(ranges) ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+
+        bool good = true;
+        for (int i = 0; good && i < ranges.size(); i++) {
+            auto const& range = ranges[i];
+            qint64 end = range.length < 0 ? st.st_size : qMin<qint64>(st.st_size, range.offset + range.length);
+            good = end - range.offset <= chunk ? read_small(fd, range.offset, end, digest)
+                                               : read_range(fd, range.offset, end, digest);
+        }
+        close(fd);
+        return good;
+    }
+
+private:
+    static const int depth = 8;
+
+    struct Slot {
+        char* buffer;
+        qint64 offset;
+        int length;
+        // bytes read before the last submission of the slot
+        int filled;
+        int result;
+        bool done;
+    };
+
+    bool read_small(int fd, qint64 offset, qint64 end, Digest* digest) {
+        if (!go_on()) { return false; }
+        char* buffer = slots[0].buffer;
+        int length = static_cast<int>(qMax<qint64>(0, end - offset));
+        int filled = 0;
+        while (filled < length) {
+            ssize_t result = pread(fd, buffer + filled, length - filled, offset + filled);
+            if (result < 0 && errno == EINTR) { continue; }
+            if (result < 0) { return false; }
+            if (result == 0) { break; }
+            filled += int(result);
+        }
+        if (digest != nullptr) {
+            digest->add_data(buffer, filled);
+        }
+        drop(fd, offset, filled);
+        return true;
+    }
+
+    bool read_range(int fd, qint64 next, qint64 end, Digest* digest) {
+        int head = 0;
+        int in_flight = 0;
+        bool good = true;
+        bool hashing = true;
+        while ((hashing && next < end) || in_flight > 0) {
+            while (hashing && in_flight < depth && next < end) {
+                auto& slot = slots[(head + in_flight) % depth];
+                slot.offset = next;
+                slot.length = static_cast<int>(qMin<qint64>(chunk, end - next));
+                slot.filled = 0;
+                queue(fd, slot);
+                next += slot.length;
+                in_flight++;
+            }
+            io_uring_submit(&ring);
+
+            // a short read before the end of the range is not the end of
+            // the file, the rest of the slot is read again
+            auto& slot = slots[head];
+            bool waited = wait(slot);
+            while (waited && hashing && slot.result > 0 && slot.filled + slot.result < slot.length) {
+                slot.filled += slot.result;
+                queue(fd, slot);
+                io_uring_submit(&ring);
+                waited = wait(slot);
+            }
+            if (!waited) {
+                cancel(head, in_flight);
+                return false;
+            }
+            head = (head + 1) % depth;
+            in_flight--;
+
+            // after an error, the end of the file or a stop the rest is only waited for
+            if (!hashing) { continue; }
+            if (slot.result < 0 || !go_on()) {
+                good = false;
+                hashing = false;
+                continue;
+            }
+            int length = slot.filled + slot.result;
+            if (digest != nullptr) {
+                digest->add_data(slot.buffer, length);
+            }
+            drop(fd, slot.offset, length);
+            hashing = length == slot.length;
+        }
+        return good;
+    }
+
+    void queue(int fd, Slot& slot) {
+        slot.done = false;
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_read(sqe, fd, slot.buffer + slot.filled, slot.length - slot.filled, slot.offset + slot.filled);
+        io_uring_sqe_set_data(sqe, &slot);
+    }
+
+    // completions of other slots are recorded on the way
+    bool wait(Slot& slot) {
+        while (!slot.done) {
+            io_uring_cqe* cqe;
+            int error = io_uring_wait_cqe(&ring, &cqe);
+            if (error == -EINTR) { continue; }
+            if (error < 0) { return false; }
+            auto done = static_cast<Slot*>(io_uring_cqe_get_data(cqe));
+            if (done != nullptr) { // cancel requests carry none
+                done->result = cqe->res;
+                done->done = true;
+            }
+            io_uring_cqe_seen(&ring, cqe);
+        }
+        return true;
+    }
+
+    // the kernel still writes to the buffers of reads in flight, so they
+    // are cancelled and waited for before the buffers are used again. If
+    // the ring cannot even do that, the buffers are given up with it.
+    void cancel(int head, int in_flight) {
+        for (int i = 0; i < in_flight; i++) {
+            auto& slot = slots[(head + i) % depth];
+            if (slot.done) { continue; }
+            io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_cancel(sqe, &slot, 0);
+            io_uring_sqe_set_data(sqe, nullptr);
+        }
+        io_uring_submit(&ring);
+        for (int i = 0; i < in_flight; i++) {
+            if (!wait(slots[(head + i) % depth])) {
+                io_uring_queue_exit(&ring);
+                ready = false;
+                for (auto& slot : slots) {
+                    slot.buffer = nullptr; // leaked, a late read may still land in them
+                }
+                return;
+            }
+        }
+    }
+
+    io_uring ring;
+    bool ready;
+    Slot slots[depth];
+};
+
+#endif
+
+}
+
+FileReader* FileReader::create(ReadStrategy strategy, bool drop_cache) {
+    switch (strategy) {
+    case ReadStrategy::Mapped:
+        return new MappedReader(drop_cache);
+#ifdef HAVE_LIBURING
+    case ReadStrategy::Uring: {
+        auto reader = new UringReader(drop_cache);
+        if (reader->ok()) {
+            return reader;
+        }
+        delete reader;
+        return new BufferedReader(drop_cache);
+    }
+#endif
+    default:
+        return new BufferedReader(drop_cache);
+    }
+}
+
+QString FileReader::name(ReadStrategy strategy) {
+    switch (strategy) {
+    case ReadStrategy::Mapped:
+        return "Memory mapped";
+    case ReadStrategy::Uring:
+        return "io_uring";
+    default:
+        return "Buffered";
+    }
+}
+
+QString FileReader::key(ReadStrategy strategy) {
+    switch (strategy) {
+    case ReadStrategy::Mapped:
+        return "mmap";
+    case ReadStrategy::Uring:
+        return "uring";
+    default:
+        return "buffered";
+    }
+}
+
+bool FileReader::parse(QString const& key, ReadStrategy& strategy) {
+    for (auto candidate : strategies()) {
+        if (FileReader::key(candidate).compare(key, Qt::CaseInsensitive) == 0) {
+            strategy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+QVector<ReadStrategy> FileReader::strategies() {
+    return {ReadStrategy::Buffered, ReadStrategy::Mapped, ReadStrategy::Uring};
+}
+
+bool FileReader::available(ReadStrategy strategy) {
+#ifdef HAVE_LIBURING
+    if (strategy == ReadStrategy::Uring) {
+        UringReader reader(false);
+        return reader.ok();
+    }
+    return true;
+#else
+    return strategy != ReadStrategy::Uring;
+#endif
+}
+
+QByteArray FileReader::shared_extents(QByteArray const& path, qint64 size) {
+    const int max_extents = 64;
+    const quint32 unusable = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_UNWRITTEN
+            | FIEMAP_EXTENT_NOT_ALIGNED | FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL;
+
+    int fd = open_file(path);
+    if (fd < 0) { return QByteArray(); }
+    QByteArray buffer(sizeof(fiemap) + max_extents * sizeof(fiemap_extent), 0);
+    auto map = reinterpret_cast<fiemap*>(buffer.data());
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = max_extents;
+    struct stat st;
+    bool mapped = fstat(fd, &st) == 0 && ioctl(fd, FS_IOC_FIEMAP, map) == 0;
+    close(fd);
+
+    int count = mapped ? map->fm_mapped_extents : 0;
+    if (count == 0 || !(map->fm_extents[count - 1].fe_flags & FIEMAP_EXTENT_LAST)) {
+        return QByteArray();
+    }
+    QByteArray result;
+    result.append(reinterpret_cast<char const*>(&st.st_dev), sizeof(st.st_dev));
+    result.append(reinterpret_cast<char const*>(&size), sizeof(size));
+    for (int i = 0; i < count; i++) {
+        auto const& extent = map->fm_extents[i];
+        if (!(extent.fe_flags & FIEMAP_EXTENT_SHARED) || (extent.fe_flags & unusable)) {
+            return QByteArray();
+        }
+        result.append(reinterpret_cast<char const*>(&extent.fe_logical), sizeof(extent.fe_logical));
+        result.append(reinterpret_cast<char const*>(&extent.fe_physical), sizeof(extent.fe_physical));
+        result.append(reinterpret_cast<char const*>(&extent.fe_length), sizeof(extent.fe_length));
+    }
+    return result;
+}
+
+qint64 FileReader::physical_offset(QByteArray const& path) {
+    int fd = open_file(path);
+    if (fd < 0) { return -1; }
+    QByteArray buffer(sizeof(fiemap) + sizeof(fiemap_extent), 0);
+    auto map = reinterpret_cast<fiemap*>(buffer.data());
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    bool mapped = ioctl(fd, FS_IOC_FIEMAP, map) == 0;
+    close(fd);
+
+    if (!mapped || map->fm_mapped_extents == 0 || (map->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN)) {
+        return -1;
+    }
+    return static_cast<qint64>(map->fm_extents[0].fe_physical);
+}
+
+// O_NOATIME spares an inode write per file, it is refused for files of other users
+int FileReader::open_file(QByteArray const& path) {
+    int fd = open(path.constData(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+        fd = open(path.constData(), O_RDONLY | O_CLOEXEC);
+    }
+    return fd;
+}
+
+void FileReader::set_control(ScanControl* control) {
+    this->control = control;
+}
+
+bool FileReader::go_on() const {
+    return control == nullptr || control->pass();
+}
+
+void FileReader::drop(int fd, qint64 offset, qint64 length) const {
+    if (drop_cache) {
+        posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
+    }
+}
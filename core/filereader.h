@@ -0,0 +1,66 @@
+#ifndef FILEREADER_H
+#define FILEREADER_H
+
+#include "digest.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class ScanControl;
+
+enum class ReadStrategy {
+    Buffered,
+    Mapped,
+    Uring
+};
+
+// part of a file, length -1 reads to the end
+struct ReadRange {
+    qint64 offset;
+    qint64 length;
+};
+
+// feeds file contents to a digest. Each hashing thread owns one reader,
+// readers keep their buffers between files.
+class FileReader {
+public:
+    static const int chunk = 1 << 20;
+
+    explicit FileReader(bool drop_cache) : drop_cache(drop_cache), control(nullptr) {}
+    virtual ~FileReader() {}
+
+    // a null digest only reads, false if the file could not be opened or
+    // read, or if the scan was stopped before the end
+    virtual bool read(QByteArray const& path, QVector<ReadRange> const& ranges, Digest* digest) = 0;
+    // checked between chunks, a pause holds the reader inside the file
+    void set_control(ScanControl* control);
+
+    // falls back to buffered reads when the strategy is not available
+    static FileReader* create(ReadStrategy strategy, bool drop_cache);
+    static QString name(ReadStrategy strategy);
+    // short name for command lines: buffered, mmap, uring
+    static QString key(ReadStrategy strategy);
+    static bool parse(QString const& key, ReadStrategy& strategy);
+    static QVector<ReadStrategy> strategies();
+    static bool available(ReadStrategy strategy);
+
+    // device, size and extent map of a file whose extents are all shared,
+    // equal maps mean equal contents. Empty when any extent is private or
+    // not a plain extent, or when the filesystem has no FIEMAP.
+    static QByteArray shared_extents(QByteArray const& path, qint64 size);
+    // where the first extent of the file starts on its device, -1 if unknown
+    static qint64 physical_offset(QByteArray const& path);
+
+protected:
+    static int open_file(QByteArray const& path);
+    // tells the kernel the pages behind the reader will not be needed again
+    void drop(int fd, qint64 offset, qint64 length) const;
+    // false once the scan is stopped, blocks while it is paused
+    bool go_on() const;
+
+    bool drop_cache;
+    ScanControl* control;
+};
+
+#endif // FILEREADER_H
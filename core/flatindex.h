@@ -0,0 +1,204 @@
+#ifndef FLATINDEX_H
+#define FLATINDEX_H
+
+#include "digest.h"
+
+#include <QVector>
+
+#include <cstring>
+
+// size and binary digest of a stage, digest is zero for the size stage
+struct DigestKey {
+    qint64 size;
+    char digest[Digest::width];
+
+    DigestKey() : size(0) {
+        memset(digest, 0, sizeof(digest));
+    }
+
+    DigestKey(qint64 size, char const* data) : size(size) {
+        memcpy(digest, data, sizeof(digest));
+    }
+
+    bool operator==(DigestKey const& other) const {
+        return size == other.size && memcmp(digest, other.digest, sizeof(digest)) == 0;
+    }
+};
+
+// identity of a file on disk, all hard links share it
+struct InodeKey {
+    quint64 device;
+    quint64 inode;
+
+    bool operator==(InodeKey const& other) const {
+        return device == other.device && inode == other.inode;
+    }
+};
+
+// fingerprint of a content defined chunk, the first half of its digest
+struct ChunkKey {
+    quint64 low;
+    quint64 high;
+
+    bool operator==(ChunkKey const& other) const {
+        return low == other.low && high == other.high;
+    }
+};
+
+inline quint64 index_hash(quint64 x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+inline quint64 index_hash(qint64 x) {
+    return index_hash(quint64(x));
+}
+
+// digests are already uniform, their first word only gets the size mixed in
+inline quint64 index_hash(DigestKey const& key) {
+    quint64 word;
+    memcpy(&word, key.digest, sizeof(word));
+    return index_hash(quint64(key.size) ^ word);
+}
+
+inline quint64 index_hash(InodeKey const& key) {
+    return index_hash(key.inode ^ index_hash(key.device));
+}
+
+inline quint64 index_hash(ChunkKey const& key) {
+    return key.low;
+}
+
+// open addressing table with linear probing. Slots are one flat array,
+// removal shifts the following entries back instead of leaving tombstones,
+// so lookups stay short however many keys come and go.
+template <typename Key, typename Value>
+class FlatIndex {
+public:
+    FlatIndex() : slots(), used(), count(0), mask(0) {}
+
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void clear() {
+        slots.clear();
+        used.clear();
+        count = 0;
+        mask = 0;
+    }
+
+    void reserve(int size) {
+        int capacity = 16;
+        while (capacity * 3 < size * 4) {
+            capacity *= 2;
+        }
+        if (capacity > slots.size()) {
+            rehash(capacity);
+        }
+    }
+
+    // nullptr if the key is absent, the pointer is valid until the next insert
+    Value* find(Key const& key) {
+        if (count == 0) { return nullptr; }
+        for (int i = index_hash(key) & mask; used[i]; i = (i + 1) & mask) {
+            if (slots[i].key == key) {
+                return &slots[i].value;
+            }
+        }
+        return nullptr;
+    }
+
+    Value const* find(Key const& key) const {
+        return const_cast<FlatIndex*>(this)->find(key);
+    }
+
+    Value value(Key const& key, Value const& fallback) const {
+        auto found = find(key);
+        return found == nullptr ? fallback : *found;
+    }
+
+    // returns false and leaves the value alone if the key is present
+    bool insert(Key const& key, Value const& value) {
+        if ((count + 1) * 4 > slots.size() * 3) {
+            rehash(slots.isEmpty() ? 16 : slots.size() * 2);
+        }
+        int i = index_hash(key) & mask;
+        for (; used[i]; i = (i + 1) & mask) {
+            if (slots[i].key == key) {
+                return false;
+            }
+        }
+        used[i] = true;
+        slots[i].key = key;
+        slots[i].value = value;
+        count++;
+        return true;
+    }
+
+    bool remove(Key const& key) {
+        if (count == 0) { return false; }
+        int i = index_hash(key) & mask;
+        for (; used[i]; i = (i + 1) & mask) {
+            if (slots[i].key == key) {
+                break;
+            }
+        }
+        if (!used[i]) { return false; }
+
+        // move back every entry whose probe sequence passes the hole
+        for (int j = (i + 1) & mask; used[j]; j = (j + 1) & mask) {
+            int home = index_hash(slots[j].key) & mask;
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        used[i] = false;
+        count--;
+        return true;
+    }
+
+    // in place, a removal may move a later entry into the slot looked at
+    template <typename Drop>
+    void remove_if(Drop const& drop) {
+        for (int i = 0; i < slots.size();) {
+            if (used[i] && drop(slots[i].key, slots[i].value)) {
+                Key key = slots[i].key;
+                remove(key);
+            } else {
+                i++;
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        Key key;
+        Value value;
+    };
+
+    void rehash(int capacity) {
+        QVector<Slot> old_slots(capacity);
+        QVector<bool> old_used(capacity, false);
+        old_slots.swap(slots);
+        old_used.swap(used);
+        mask = capacity - 1;
+        count = 0;
+        for (int i = 0; i < old_slots.size(); i++) {
+            if (old_used[i]) {
+                insert(old_slots[i].key, old_slots[i].value);
+            }
+        }
+    }
+
+    QVector<Slot> slots;
+    QVector<bool> used;
+    int count;
+    int mask;
+};
+
+#endif // FLATINDEX_H
@@ -0,0 +1,323 @@
+#include "hashcache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+
+CacheKey CacheKey::from_store(RecordStore const& store, quint32 file) {
+    CacheKey key;
+    key.device = store.device(file);
+    key.inode = store.inode(file);
+    key.size = store.size(file);
+    key.mtime = store.mtime(file);
+    key.ctime = store.ctime(file);
+    return key;
+}
+
+namespace {
+
+bool record_less(CacheRecord const& a, CacheRecord const& b) {
+    return a.device < b.device || (a.device == b.device && a.inode < b.inode);
+}
+
+bool matches(CacheRecord const& record, CacheKey const& key) {
+    return record.size == key.size && record.mtime == key.mtime && record.ctime == key.ctime;
+}
+
+}
+
+HashCache::HashCache() : digest(DigestType::Sha3_512), block_size(0), records(nullptr), count(0),
+    hit_count(0), saved(0) {}
+
+HashCache::~HashCache() {
+    close();
+}
+
+bool HashCache::open(QString const& path, DigestType digest, qint64 block_size) {
+    QMutexLocker locker(&lock);
+    close();
+    this->path = path;
+    this->digest = digest;
+    this->block_size = block_size;
+    hit_count = 0;
+    saved = 0;
+    if (!map_file()) {
+        return false;
+    }
+    replay_journal();
+    return true;
+}
+
+// a missing, foreign or outdated file is treated as an empty cache
+bool HashCache::map_file() {
+    records = nullptr;
+    count = 0;
+    seen.clear();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return true;
+    }
+    if (file.size() < qint64(sizeof(Header))) {
+        file.close();
+        return true;
+    }
+
+    uchar* data = file.map(0, file.size());
+    if (data == nullptr) {
+        file.close();
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != magic || header.version != version || header.digest != quint32(digest)
+            || header.block_size != block_size
+            || file.size() != qint64(sizeof(Header)) + header.count * qint64(sizeof(CacheRecord))) {
+        file.unmap(data);
+        file.close();
+        return true;
+    }
+
+    records = reinterpret_cast<CacheRecord const*>(data + sizeof(Header));
+    count = header.count;
+    seen.resize(static_cast<int>(count));
+    return true;
+}
+
+void HashCache::close() {
+    if (file.isOpen()) {
+        file.close(); // unmaps as well
+    }
+    records = nullptr;
+    count = 0;
+    fresh.clear();
+    unjournaled.clear();
+    seen.clear();
+}
+
+HashCache::Header HashCache::header() const {
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = magic;
+    header.version = version;
+    header.digest = quint32(digest);
+    header.block_size = block_size;
+    return header;
+}
+
+QString HashCache::journal_path() const {
+    return path + ".journal";
+}
+
+// records a stopped scan appended, a later one of a file wins. A record
+// cut short by a crash at the end is left out.
+void HashCache::replay_journal() {
+    if (path.isEmpty()) { return; }
+    QFile journal(journal_path());
+    if (!journal.open(QIODevice::ReadOnly)) { return; }
+    Header header;
+    Header expected = this->header();
+    if (journal.read(reinterpret_cast<char*>(&header), sizeof(header)) == qint64(sizeof(header))
+            && header.magic == expected.magic && header.version == expected.version
+            && header.digest == expected.digest && header.block_size == expected.block_size) {
+        CacheRecord record;
+        while (journal.read(reinterpret_cast<char*>(&record), sizeof(record)) == qint64(sizeof(record))) {
+            fresh.insert(qMakePair(record.device, record.inode), record);
+        }
+    }
+    journal.close();
+    if (fresh.empty()) { // foreign or empty
+        QFile::remove(journal_path());
+        return;
+    }
+    merge(false);
+}
+
+bool HashCache::is_open() const {
+    return !path.isEmpty();
+}
+
+CacheRecord const* HashCache::lookup(quint64 device, quint64 inode) const {
+    CacheRecord probe;
+    probe.device = device;
+    probe.inode = inode;
+    auto it = std::lower_bound(records, records + count, probe, record_less);
+    if (it == records + count || it->device != device || it->inode != inode) {
+        return nullptr;
+    }
+    return it;
+}
+
+bool HashCache::find(CacheKey const& key, Stage stage, QByteArray& result) {
+    quint32 flag = stage == Stage::Partial ? CacheRecord::HasPartial : CacheRecord::HasFull;
+    CacheRecord record;
+    {
+        QMutexLocker locker(&lock);
+        auto it = fresh.find(qMakePair(key.device, key.inode));
+        if (it != fresh.end()) {
+            record = it.value();
+        } else {
+            auto ptr = lookup(key.device, key.inode);
+            if (ptr == nullptr) { return false; }
+            seen.setBit(static_cast<int>(ptr - records));
+            record = *ptr;
+        }
+    }
+
+    if (!matches(record, key) || !(record.flags & flag)) {
+        return false;
+    }
+
+    result = QByteArray(stage == Stage::Partial ? record.partial : record.full, Digest::width);
+    hit_count.fetchAndAddRelaxed(1);
+    saved.fetchAndAddRelaxed(stage == Stage::Partial ? qMin(key.size, 2 * block_size) : key.size);
+    return true;
+}
+
+void HashCache::insert(CacheKey const& key, Stage stage, QByteArray const& result) {
+    QMutexLocker locker(&lock);
+    auto id = qMakePair(key.device, key.inode);
+    auto it = fresh.find(id);
+    if (it == fresh.end()) {
+        CacheRecord record;
+        auto ptr = lookup(key.device, key.inode);
+        if (ptr != nullptr && matches(*ptr, key)) {
+            record = *ptr;
+        } else {
+            memset(&record, 0, sizeof(record));
+            record.device = key.device;
+            record.inode = key.inode;
+        }
+        it = fresh.insert(id, record);
+    }
+
+    unjournaled.insert(id);
+    auto& record = it.value();
+    if (!matches(record, key)) {
+        record.flags = 0;
+    }
+    record.size = key.size;
+    record.mtime = key.mtime;
+    record.ctime = key.ctime;
+    if (stage == Stage::Partial) {
+        memcpy(record.partial, result.constData(), Digest::width);
+        record.flags |= CacheRecord::HasPartial;
+    } else {
+        memcpy(record.full, result.constData(), Digest::width);
+        record.flags |= CacheRecord::HasFull;
+    }
+}
+
+// merges the mapped table with the fresh records into a new sorted file.
+// Records keep their seen bit, a save in the middle of a scan does not
+// make a later compaction drop them.
+bool HashCache::save(bool compact) {
+    QMutexLocker locker(&lock);
+    if (path.isEmpty() || (fresh.empty() && !compact)) {
+        return true;
+    }
+    return merge(compact);
+}
+
+// the journal is kept until the merged file replaced the old one
+bool HashCache::merge(bool compact) {
+    QVector<CacheRecord> added;
+    added.reserve(fresh.size());
+    for (auto const& record : fresh) {
+        added.push_back(record);
+    }
+    std::sort(added.begin(), added.end(), record_less);
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    Header header = this->header();
+    out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+    QBitArray now_seen(static_cast<int>(count) + added.size());
+    qint64 written = 0;
+    int i = 0;
+    int j = 0;
+    while (i < count || j < added.size()) {
+        if (j < added.size() && (i == count || !record_less(records[i], added[j]))) {
+            if (i < count && !record_less(added[j], records[i])) {
+                i++; // superseded by the fresh record
+            }
+            out.write(reinterpret_cast<char const*>(&added[j]), sizeof(CacheRecord));
+            now_seen.setBit(static_cast<int>(written));
+            j++;
+        } else {
+            if (!compact || seen.testBit(i)) {
+                out.write(reinterpret_cast<char const*>(&records[i]), sizeof(CacheRecord));
+                now_seen.setBit(static_cast<int>(written), seen.testBit(i));
+            } else {
+                written--;
+            }
+            i++;
+        }
+        written++;
+    }
+
+    header.count = written;
+    out.seek(0);
+    out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    if (!out.commit()) {
+        return false;
+    }
+
+    QFile::remove(journal_path());
+    file.close();
+    fresh.clear();
+    unjournaled.clear();
+    if (!map_file()) {
+        return false;
+    }
+    now_seen.resize(static_cast<int>(count));
+    seen = now_seen;
+    return true;
+}
+
+// the fresh records stay in memory, only the journal on disk grows
+bool HashCache::checkpoint() {
+    QMutexLocker locker(&lock);
+    if (path.isEmpty() || unjournaled.empty()) {
+        return true;
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile journal(journal_path());
+    if (!journal.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return false;
+    }
+    if (journal.size() == 0) {
+        Header header = this->header();
+        journal.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    }
+    QByteArray added;
+    added.reserve(unjournaled.size() * int(sizeof(CacheRecord)));
+    for (auto const& id : unjournaled) {
+        added.append(reinterpret_cast<char const*>(&fresh[id]), sizeof(CacheRecord));
+    }
+    if (journal.write(added) != added.size() || !journal.flush()) {
+        return false;
+    }
+    unjournaled.clear();
+    return true;
+}
+
+int HashCache::hits() const {
+    return hit_count;
+}
+
+qint64 HashCache::bytes_saved() const {
+    return saved;
+}
@@ -0,0 +1,106 @@
+#ifndef HASHCACHE_H
+#define HASHCACHE_H
+
+#include "recordstore.h"
+#include "digest.h"
+
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+#include <QBitArray>
+#include <QSet>
+#include <QString>
+
+// identity of a file version, content is reread only when it changes
+struct CacheKey {
+    quint64 device;
+    quint64 inode;
+    qint64 size;
+    qint64 mtime;
+    qint64 ctime;
+
+    static CacheKey from_store(RecordStore const& store, quint32 file);
+};
+
+// one slot of the on-disk table, records are sorted by (device, inode)
+struct CacheRecord {
+    enum Flags : quint32 {
+        HasPartial = 1,
+        HasFull = 2
+    };
+
+    quint64 device;
+    quint64 inode;
+    qint64 size;
+    qint64 mtime;
+    qint64 ctime;
+    quint32 flags;
+    quint32 reserved;
+    char partial[Digest::width];
+    char full[Digest::width];
+};
+
+// persistent digests of previous scans. The file is memory mapped and
+// searched in place, new digests are kept aside until save() merges them
+// into a new file that atomically replaces the old one. Checkpoints only
+// append the digests found since the last one to a journal, which the
+// next save() or open() merges.
+class HashCache {
+public:
+    HashCache();
+    ~HashCache();
+
+    // empty path disables the cache
+    bool open(QString const& path, DigestType digest, qint64 block_size);
+    void close();
+    bool is_open() const;
+
+    bool find(CacheKey const& key, Stage stage, QByteArray& digest);
+    void insert(CacheKey const& key, Stage stage, QByteArray const& digest);
+
+    // compact drops records of files not seen since open()
+    bool save(bool compact);
+    // appends the records changed since the last checkpoint to the journal
+    bool checkpoint();
+
+    int hits() const;
+    qint64 bytes_saved() const;
+
+private:
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint32 digest;
+        quint32 reserved;
+        qint64 block_size;
+        qint64 count;
+    };
+
+    static const quint32 magic = 0x43484446; // "FDHC"
+    static const quint32 version = 1;
+
+    CacheRecord const* lookup(quint64 device, quint64 inode) const;
+    bool map_file();
+    Header header() const;
+    QString journal_path() const;
+    void replay_journal();
+    bool merge(bool compact);
+
+    QString path;
+    DigestType digest;
+    qint64 block_size;
+
+    QFile file;
+    CacheRecord const* records;
+    qint64 count;
+
+    QMutex lock;
+    QHash<QPair<quint64, quint64>, CacheRecord> fresh;
+    QSet<QPair<quint64, quint64>> unjournaled;
+    QBitArray seen;
+    QAtomicInt hit_count;
+    QAtomicInteger<qint64> saved;
+};
+
+#endif // HASHCACHE_H
@@ -0,0 +1,269 @@
+#include "hashpool.h"
+#include "scancontrol.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+HashThread::HashThread(HashPool* pool) : pool(pool),
+    digest(Digest::create(pool->options.digest)), digest_type(pool->options.digest),
+    reader(FileReader::create(pool->options.read_strategy, pool->options.drop_cache)),
+    read_strategy(pool->options.read_strategy), drop_cache(pool->options.drop_cache) {}
+
+HashThread::~HashThread() {
+    delete digest;
+    delete reader;
+}
+
+void HashThread::run() {
+    quint32 file;
+    quint64 device;
+    bool unplaced;
+    while (pool->scheduler.take(pool->quit_flag, file, device, unplaced)) {
+        if (unplaced && pool->stop_flag == 0) {
+            pool->scheduler.place(file, device, position(file));
+            continue;
+        }
+        if (!unplaced) {
+            hash_file(file);
+        }
+        pool->scheduler.done(device);
+    }
+}
+
+// where the data of a file of a rotational disk starts, those FIEMAP
+// cannot place go by inode, which most filesystems allocate close to the data
+qint64 HashThread::position(quint32 file) {
+    qint64 offset = FileReader::physical_offset(pool->store->native_path(file));
+    return offset < 0 ? qint64(pool->store->inode(file)) : offset;
+}
+
+void HashThread::hash_file(quint32 file) {
+    if (pool->stop_flag == 1) { return; }
+
+    if (digest_type != pool->options.digest) {
+        delete digest;
+        digest_type = pool->options.digest;
+        digest = Digest::create(digest_type);
+    }
+    if (read_strategy != pool->options.read_strategy || drop_cache != pool->options.drop_cache) {
+        delete reader;
+        read_strategy = pool->options.read_strategy;
+        drop_cache = pool->options.drop_cache;
+        reader = FileReader::create(read_strategy, drop_cache);
+    }
+    reader->set_control(pool->control);
+
+    // a file laid out on the extents of another one is not read at all
+    auto store = pool->store;
+    if (pool->options.shared_extents) {
+        auto extents = FileReader::shared_extents(store->native_path(file), store->size(file));
+        quint32 owner = pool->extent_owner(file, extents);
+        if (owner != file) {
+            store->set_shared(file, owner);
+            if (pool->stop_flag == 0) {
+                pool->ring->push(file, pool->stop_flag);
+            }
+            return;
+        }
+    }
+
+    // content is read only if the file changed since it was cached
+    Stage stage = store->stage(file);
+    CacheKey key = CacheKey::from_store(*store, file);
+    bool cacheable = pool->cache.is_open();
+    QByteArray result;
+    bool read = true;
+    if (!cacheable || !pool->cache.find(key, stage, result)) {
+        read = read_digest(file, stage, result);
+        if (read && cacheable) {
+            pool->cache.insert(key, stage, result);
+        }
+    }
+
+    // the digest of part of a file would match that of any other failed one
+    if (read) {
+        store->set_digest(file, result);
+    } else if (pool->control != nullptr && pool->control->stopped()) {
+        return; // cut short by a stop, not a failure
+    } else {
+        store->set_unreadable(file);
+    }
+    if (pool->stop_flag == 0) {
+        pool->ring->push(file, pool->stop_flag);
+    }
+}
+
+bool HashThread::read_digest(quint32 file, Stage stage, QByteArray& result) {
+    QVector<ReadRange> ranges = {{0, -1}};
+    if (stage == Stage::Partial) {
+        // first and last blocks
+        auto block = pool->options.block_size;
+        auto size = pool->store->size(file);
+        ranges = {{0, block}};
+        if (size > block) {
+            ranges.push_back({qMax(block, size - block), block});
+        }
+    }
+
+    digest->reset();
+    auto telemetry = pool->telemetry;
+    if (telemetry == nullptr || !telemetry->enabled()) {
+        bool read = reader->read(pool->store->native_path(file), ranges, digest);
+        result = digest->result();
+        return read;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    TimedDigest timed(digest);
+    bool read = reader->read(pool->store->native_path(file), ranges, &timed);
+    result = timed.result();
+    qint64 total = timer.nsecsElapsed();
+    telemetry->add_hashed(timed.bytes(), total - timed.nsecs(), timed.nsecs());
+    return read;
+}
+
+HashPool::HashPool(int threads, QObject *parent) : QObject(parent), options(), cache(), ring(nullptr), store(nullptr), telemetry(nullptr),
+    control(nullptr), workers(),
+    scheduler(), stop_flag(0), quit_flag(0), extents_lock(), extent_owners(), shared_owners() {
+    start_threads(threads);
+}
+
+HashPool::~HashPool() {
+    finish_threads();
+}
+
+void HashPool::set_threads(int threads) {
+    if (threads == workers.size()) { return; }
+    finish_threads();
+    start_threads(threads);
+}
+
+int HashPool::threads() const {
+    return workers.size();
+}
+
+// must be set before the first file is hashed
+void HashPool::set_store(RecordStore* store) {
+    this->store = store;
+}
+
+// must be set before the first file is hashed
+void HashPool::set_ring(ResultRing* ring) {
+    this->ring = ring;
+}
+
+// must be set before the first file is hashed
+void HashPool::set_telemetry(Telemetry* telemetry) {
+    this->telemetry = telemetry;
+}
+
+// must be set before the first file is hashed
+void HashPool::set_control(ScanControl* control) {
+    this->control = control;
+}
+
+int HashPool::queued() {
+    return scheduler.queued();
+}
+
+int HashPool::busy_threads() {
+    return scheduler.active();
+}
+
+// must not be called while files are being hashed
+void HashPool::set_options(ScanOptions const& options) {
+    this->options = options;
+    scheduler.set_limits(options.rotational_reads, options.solid_reads);
+}
+
+void HashPool::start_threads(int threads) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    quit_flag = 0;
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(new HashThread(this));
+    }
+    for (auto worker : workers) {
+        worker->start();
+    }
+}
+
+void HashPool::finish_threads() {
+    quit_flag = 1;
+    scheduler.wake_all();
+    for (auto worker : workers) {
+        worker->wait();
+    }
+    for (auto worker : workers) {
+        delete worker;
+    }
+    workers.clear();
+}
+
+// runs on the engine thread, the files of a rotational disk are placed
+// by the hash threads
+void HashPool::get_hash(quint32 file) {
+    if (stop_flag == 1) { return; } // sent before the engine saw the stop
+    scheduler.add(file, store->device(file));
+}
+
+// drops queued work, files in flight are dropped by their threads
+void HashPool::stop() {
+    stop_flag = 1;
+    scheduler.clear();
+}
+
+void HashPool::reset() {
+    stop_flag = 0;
+    QMutexLocker locker(&extents_lock);
+    extent_owners.clear();
+    shared_owners.clear();
+}
+
+// first file seen with this extent map, the file itself if it is the first
+quint32 HashPool::extent_owner(quint32 file, QByteArray const& extents) {
+    if (extents.isEmpty()) { return file; }
+    QMutexLocker locker(&extents_lock);
+    auto it = extent_owners.find(extents);
+    if (it == extent_owners.end()) {
+        extent_owners.insert(extents, file);
+        return file;
+    }
+    if (it.value() != file) { // a file hashed again is not sharing with itself
+        shared_owners.insert(it.value());
+    }
+    return it.value();
+}
+
+bool HashPool::owns_shared_extents(quint32 file) {
+    QMutexLocker locker(&extents_lock);
+    return shared_owners.contains(file);
+}
+
+void HashPool::wait_idle() {
+    while (scheduler.active() != 0) {
+        QThread::yieldCurrentThread();
+    }
+}
+
+void HashPool::open_cache() {
+    cache.open(options.cache_path, options.digest, options.block_size);
+}
+
+void HashPool::save_cache(bool compact) {
+    cache.save(compact);
+}
+
+void HashPool::checkpoint_cache() {
+    cache.checkpoint();
+}
+
+int HashPool::cache_hits() const {
+    return cache.hits();
+}
+
+qint64 HashPool::cache_bytes_saved() const {
+    return cache.bytes_saved();
+}
@@ -0,0 +1,103 @@
+#ifndef HASHPOOL_H
+#define HASHPOOL_H
+
+#include "scanoptions.h"
+#include "recordstore.h"
+#include "hashcache.h"
+#include "resultring.h"
+#include "filereader.h"
+#include "telemetry.h"
+#include "devicescheduler.h"
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+
+class HashPool;
+
+// hashing thread with its own hash state and reader
+class HashThread : public QThread {
+public:
+    explicit HashThread(HashPool* pool);
+    ~HashThread() override;
+
+protected:
+    void run() override;
+
+private:
+    void hash_file(quint32 file);
+    qint64 position(quint32 file);
+    bool read_digest(quint32 file, Stage stage, QByteArray& result);
+
+    HashPool* pool;
+    Digest* digest;
+    DigestType digest_type;
+    FileReader* reader;
+    ReadStrategy read_strategy;
+    bool drop_cache;
+};
+
+// spreads calc_hash requests over several threads, through a scheduler
+// that keeps each device at its own number of files read at once
+class HashPool : public QObject {
+    Q_OBJECT
+public:
+    explicit HashPool(int threads = QThread::idealThreadCount(), QObject *parent = nullptr);
+    ~HashPool() override;
+
+    void set_threads(int threads);
+    int threads() const;
+    void set_options(ScanOptions const& options);
+    void set_ring(ResultRing* ring);
+    void set_store(RecordStore* store);
+    void set_telemetry(Telemetry* telemetry);
+    void set_control(ScanControl* control);
+
+    // files waiting for a thread, and threads inside a file
+    int queued();
+    int busy_threads();
+
+    void stop();
+    void reset();
+    // waits until no thread is inside a file
+    void wait_idle();
+    // another file was found on the extents of this one, it stays their
+    // owner until reset()
+    bool owns_shared_extents(quint32 file);
+
+    void open_cache();
+    void save_cache(bool compact);
+    void checkpoint_cache();
+    int cache_hits() const;
+    qint64 cache_bytes_saved() const;
+
+public slots:
+    void get_hash(quint32 file);
+
+private:
+    friend class HashThread;
+
+    quint32 extent_owner(quint32 file, QByteArray const& extents);
+    void start_threads(int threads);
+    void finish_threads();
+
+    ScanOptions options;
+    HashCache cache;
+    ResultRing* ring;
+    RecordStore* store;
+    Telemetry* telemetry;
+    ScanControl* control;
+    QVector<HashThread*> workers;
+    DeviceScheduler scheduler;
+    QAtomicInt stop_flag;
+    QAtomicInt quit_flag;
+
+    QMutex extents_lock;
+    QHash<QByteArray, quint32> extent_owners;
+    QSet<quint32> shared_owners;
+};
+
+#endif // HASHPOOL_H
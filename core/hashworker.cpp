@@ -0,0 +1,231 @@
+#include "hashworker.h"
+
+#include "bytecomparer.h"
+#include "chunkindex.h"
+#include "digest.h"
+#include "dirwalker.h"
+#include "filereader.h"
+#include "reclaimer.h"
+#include "resultring.h"
+#include "sizeruns.h"
+#include "telemetry.h"
+
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QThread>
+
+HashWorker::HashWorker(QObject *parent) : QObject(parent), stop_flag(0), running(0), options(), ring(nullptr), store(nullptr), comparer(nullptr),
+    telemetry(nullptr), reclaimer(nullptr), chunks(nullptr), control(nullptr), runs(nullptr) {}
+
+HashWorker::~HashWorker() {}
+
+void HashWorker::process(QStringList const& roots) {
+    if (stop_flag != 0) { // a new scan was started before this one ran
+        running.deref();
+        return;
+    }
+    bool spill = options.memory_budget > 0;
+    if (spill && !runs->open(options.spill_path, options.memory_budget)) {
+        running.deref();
+        emit scan_failed(runs->error());
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    DirWalker walker(stop_flag, store, [this](QVector<quint32>& files) {
+        telemetry->add_walked(files.size());
+        ring->push(files, stop_flag);
+    });
+    walker.set_filter(PathFilter(options.filter));
+    walker.set_control(control);
+    walker.set_runs(spill ? runs : nullptr);
+    walker.walk(roots, options.walk_threads);
+    if (stop_flag != 0) {
+        running.deref();
+        return;
+    }
+
+    emit walk_finished(walker.entries(), walker.pruned(), walker.bytes_pruned(), timer.elapsed());
+    bool fed = !spill || feed_batches();
+    running.deref();
+    if (fed) {
+        emit end_scan();
+    }
+}
+
+// out of core: whole sizes from the merge of the runs, one batch at a
+// time, the next once the engine has grouped this one and dropped its files
+bool HashWorker::feed_batches() {
+    if (!runs->finish()) {
+        emit scan_failed(runs->error());
+        return false;
+    }
+    QVector<SpilledFile> batch;
+    QVector<RecordStore::FileInfo> infos;
+    QVector<quint32> ids;
+    while (stop_flag == 0 && runs->next_batch(batch)) {
+        ids.clear();
+        for (int i = 0; i < batch.size();) { // the store takes one directory at a time
+            quint32 dir = batch[i].dir;
+            infos.clear();
+            for (; i < batch.size() && batch[i].dir == dir; i++) {
+                infos.push_back(batch[i].info);
+            }
+            store->add_files(dir, infos, ids);
+        }
+        telemetry->add_walked(ids.size());
+        if (!ring->push(ids, stop_flag)) {
+            return false;
+        }
+        emit end_batch();
+        if (!runs->wait_batch(stop_flag)) {
+            return false;
+        }
+    }
+    if (!runs->error().isEmpty()) {
+        emit scan_failed(runs->error());
+        return false;
+    }
+    return stop_flag == 0;
+}
+
+// size buckets the engine collected during the walk
+void HashWorker::compare_buckets(int threads) {
+    comparer->run(stop_flag, threads);
+    running.deref();
+}
+
+// tasks the engine queued, a stop leaves the rest undone
+void HashWorker::reclaim() {
+    reclaimer->run(stop_flag, [this](int done, int total, qint64 bytes) {
+        emit reclaim_progress(done, total, bytes);
+    });
+    running.deref();
+    emit reclaim_finished();
+}
+
+// files the engine picked, a stop leaves the report partial
+void HashWorker::analyze_chunks() {
+    chunks->run(stop_flag, [this](int done, int total, qint64 bytes) {
+        emit chunk_progress(done, total, bytes);
+    });
+    running.deref();
+    emit chunks_finished();
+}
+
+// reads the same files with every read strategy, then hashes them with
+// every backend through the selected strategy. A first pass only warms
+// the page cache, unless pages are dropped behind the reader.
+void HashWorker::compare_digests(QString const& directory) {
+    QVector<QByteArray> names;
+    qint64 bytes = 0;
+    QDirIterator it(directory, QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        names.push_back(QFile::encodeName(it.next()));
+        bytes += it.fileInfo().size();
+    }
+
+    struct Pass {
+        QString name;
+        ReadStrategy strategy;
+        Digest* digest;
+    };
+    QVector<Pass> passes = {{QString(), ReadStrategy::Buffered, nullptr}};
+    for (auto strategy : FileReader::strategies()) {
+        if (FileReader::available(strategy)) {
+            passes.push_back({"read, " + FileReader::name(strategy), strategy, nullptr});
+        }
+    }
+    for (auto type : Digest::types()) {
+        passes.push_back({Digest::name(type), options.read_strategy, Digest::create(type)});
+    }
+
+    QString report;
+    QVector<ReadRange> const whole = {{0, -1}};
+    for (int i = 0; i < passes.size() && stop_flag == 0; i++) {
+        auto const& pass = passes[i];
+        FileReader* reader = FileReader::create(pass.strategy, options.drop_cache);
+        QElapsedTimer timer;
+        timer.start();
+        for (auto const& name : names) {
+            if (pass.digest != nullptr) {
+                pass.digest->reset();
+            }
+            reader->read(name, whole, pass.digest);
+            if (pass.digest != nullptr) {
+                pass.digest->result();
+            }
+        }
+        double seconds = qMax<qint64>(timer.elapsed(), 1) / 1000.0;
+        delete reader;
+        if (i > 0) {
+            report += pass.name + ": " + QString::number(bytes / seconds / (1 << 20), 'f', 1) + " MB/s\n";
+        }
+    }
+    for (auto const& pass : passes) {
+        delete pass.digest;
+    }
+
+    running.deref();
+    emit digests_compared(report);
+}
+
+void HashWorker::stop() {
+    stop_flag = 1;
+}
+
+void HashWorker::claim() {
+    running.ref();
+}
+
+void HashWorker::restart() {
+    stop_flag = 0;
+    claim();
+}
+
+void HashWorker::wait_idle() {
+    while (running.loadAcquire() != 0) {
+        QThread::yieldCurrentThread();
+    }
+}
+
+// must be set before the first walk
+void HashWorker::set_ring(ResultRing* ring) {
+    this->ring = ring;
+}
+
+// must be set before the first walk
+void HashWorker::set_store(RecordStore* store) {
+    this->store = store;
+}
+
+// must be set before the first scan in byte comparison mode
+void HashWorker::set_comparer(ByteComparer* comparer) {
+    this->comparer = comparer;
+}
+
+void HashWorker::set_telemetry(Telemetry* telemetry) {
+    this->telemetry = telemetry;
+}
+
+void HashWorker::set_reclaimer(Reclaimer* reclaimer) {
+    this->reclaimer = reclaimer;
+}
+
+void HashWorker::set_chunk_index(ChunkIndex* chunks) {
+    this->chunks = chunks;
+}
+
+void HashWorker::set_control(ScanControl* control) {
+    this->control = control;
+}
+
+void HashWorker::set_runs(SizeRuns* runs) {
+    this->runs = runs;
+}
+
+// must not be called while a tree is walked
+void HashWorker::set_options(ScanOptions const& options) {
+    this->options = options;
+}
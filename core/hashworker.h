@@ -0,0 +1,79 @@
+#ifndef HASHWORKER_H
+#define HASHWORKER_H
+
+#include "scanoptions.h"
+
+#include <QObject>
+#include <QVector>
+#include <QStringList>
+
+class ResultRing;
+class RecordStore;
+class ByteComparer;
+class Telemetry;
+class Reclaimer;
+class ChunkIndex;
+class ScanControl;
+class SizeRuns;
+
+class HashWorker : public QObject {
+    Q_OBJECT
+public:
+    explicit HashWorker(QObject *parent = nullptr);
+    ~HashWorker();
+
+    void stop();
+    // called by the engine before it queues a slot, the worker is busy from
+    // there until the slot returns. restart() also clears an earlier stop,
+    // a stop after it makes the slot return at once.
+    void claim();
+    void restart();
+    // blocks until the slots claimed have returned
+    void wait_idle();
+    void set_options(ScanOptions const& options);
+    void set_ring(ResultRing* ring);
+    void set_store(RecordStore* store);
+    void set_comparer(ByteComparer* comparer);
+    void set_telemetry(Telemetry* telemetry);
+    void set_reclaimer(Reclaimer* reclaimer);
+    void set_chunk_index(ChunkIndex* chunks);
+    void set_control(ScanControl* control);
+    void set_runs(SizeRuns* runs);
+
+public slots:
+    void process(QStringList const& roots);
+    void compare_digests(QString const& directory);
+    void compare_buckets(int threads);
+    void reclaim();
+    void analyze_chunks();
+
+signals:
+    void end_scan();
+    // out of core: the files of a batch were pushed, the next one waits
+    // for SizeRuns::batch_done()
+    void end_batch();
+    void scan_failed(QString const& error);
+    void walk_finished(qint64 entries, qint64 pruned, qint64 bytes_pruned, qint64 msecs);
+    void digests_compared(QString const& report);
+    void reclaim_progress(int done, int total, qint64 bytes);
+    void reclaim_finished();
+    void chunk_progress(int done, int total, qint64 bytes);
+    void chunks_finished();
+
+private:
+    QAtomicInt stop_flag;
+    QAtomicInt running;
+    ScanOptions options;
+    ResultRing* ring;
+    RecordStore* store;
+    ByteComparer* comparer;
+    Telemetry* telemetry;
+    Reclaimer* reclaimer;
+    ChunkIndex* chunks;
+    ScanControl* control;
+    SizeRuns* runs;
+
+    bool feed_batches();
+};
+
+#endif // HASHWORKER_H
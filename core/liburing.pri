@@ -0,0 +1,7 @@
+# io_uring read strategy, built in when liburing is installed
+
+packagesExist(liburing) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += liburing
+    DEFINES += HAVE_LIBURING
+}
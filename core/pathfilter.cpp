@@ -0,0 +1,88 @@
+#include "pathfilter.h"
+
+#include "recordstore.h"
+
+#include <QFile>
+
+#include <fnmatch.h>
+#include <cstring>
+
+PathFilter::PathFilter() : min_size(0), max_size(0), same_device(false) {}
+
+PathFilter::PathFilter(ScanFilter const& filter) :
+    min_size(filter.min_size), max_size(filter.max_size), same_device(filter.one_file_system)
+{
+    for (auto const& pattern : filter.exclude) {
+        QByteArray native = QFile::encodeName(pattern);
+        while (native.size() > 1 && native.endsWith('/')) {
+            native.chop(1);
+        }
+        if (native.contains('/')) {
+            path_excludes.push_back(native);
+        } else if (!native.isEmpty()) {
+            name_excludes.push_back(native);
+        }
+    }
+    for (auto const& pattern : filter.include) {
+        includes.push_back(QFile::encodeName(pattern));
+    }
+    for (auto const& extension : filter.extensions) {
+        QByteArray native = QFile::encodeName(extension).toLower();
+        while (native.startsWith('.')) {
+            native.remove(0, 1);
+        }
+        if (!native.isEmpty()) {
+            extensions.push_back(native);
+        }
+    }
+}
+
+bool PathFilter::excluded(QByteArray const& parent, char const* name) const {
+    for (auto const& pattern : name_excludes) {
+        if (fnmatch(pattern.constData(), name, 0) == 0) {
+            return true;
+        }
+    }
+    if (path_excludes.empty()) { return false; }
+    QByteArray path = RecordStore::join_path(parent, name);
+    for (auto const& pattern : path_excludes) {
+        if (fnmatch(pattern.constData(), path.constData(), 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PathFilter::skip_dir(QByteArray const& parent, char const* name) const {
+    return excluded(parent, name);
+}
+
+bool PathFilter::skip_file(QByteArray const& parent, char const* name) const {
+    if (excluded(parent, name)) { return true; }
+
+    if (!includes.empty()) {
+        bool found = false;
+        for (auto const& pattern : includes) {
+            if (fnmatch(pattern.constData(), name, 0) == 0) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) { return true; }
+    }
+    if (!extensions.empty()) {
+        char const* dot = strrchr(name, '.');
+        if (dot == nullptr) { return true; }
+        QByteArray extension = QByteArray(dot + 1).toLower();
+        return !extensions.contains(extension);
+    }
+    return false;
+}
+
+bool PathFilter::skip_size(qint64 size) const {
+    return size < min_size || (max_size > 0 && size > max_size);
+}
+
+bool PathFilter::one_file_system() const {
+    return same_device;
+}
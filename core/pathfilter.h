@@ -0,0 +1,35 @@
+#ifndef PATHFILTER_H
+#define PATHFILTER_H
+
+#include "scanoptions.h"
+
+#include <QByteArray>
+#include <QVector>
+
+// ScanFilter in the form the walk threads check it: native strings matched
+// with fnmatch against the names readdir returns, so excluded entries are
+// never stat'ed and excluded directories never opened. Read only once made.
+class PathFilter {
+public:
+    PathFilter();
+    explicit PathFilter(ScanFilter const& filter);
+
+    // parent is the path of the directory holding name
+    bool skip_dir(QByteArray const& parent, char const* name) const;
+    bool skip_file(QByteArray const& parent, char const* name) const;
+    bool skip_size(qint64 size) const;
+    bool one_file_system() const;
+
+private:
+    bool excluded(QByteArray const& parent, char const* name) const;
+
+    QVector<QByteArray> name_excludes;
+    QVector<QByteArray> path_excludes;
+    QVector<QByteArray> includes;
+    QVector<QByteArray> extensions;
+    qint64 min_size;
+    qint64 max_size;
+    bool same_device;
+};
+
+#endif // PATHFILTER_H
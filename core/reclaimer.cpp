@@ -0,0 +1,263 @@
+#include "reclaimer.h"
+
+#include "digest.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// progress goes out at most this often, the kernel dedupes at most
+// this much per call on common filesystems
+const int progress_interval = 100;
+const qint64 dedupe_chunk = 16 * 1024 * 1024;
+
+}
+
+Reclaimer::Reclaimer() : store(nullptr), reclaim_action(ReclaimAction::Delete), dry(false), verify(true),
+    lock(), tasks(), outcomes(), done(0), failed(0), bytes(0) {}
+
+void Reclaimer::set_store(RecordStore const* store) {
+    this->store = store;
+}
+
+void Reclaimer::set_action(ReclaimAction action, bool dry_run, bool verify) {
+    reclaim_action = action;
+    dry = dry_run;
+    this->verify = verify;
+}
+
+ReclaimAction Reclaimer::action() const {
+    return reclaim_action;
+}
+
+bool Reclaimer::dry_run() const {
+    return dry;
+}
+
+void Reclaimer::add(ReclaimTask const& task) {
+    QMutexLocker locker(&lock);
+    tasks.push_back(task);
+}
+
+void Reclaimer::clear() {
+    QMutexLocker locker(&lock);
+    tasks.clear();
+    outcomes.clear();
+    done = 0;
+    failed = 0;
+    bytes = 0;
+}
+
+bool Reclaimer::empty() {
+    QMutexLocker locker(&lock);
+    return tasks.empty();
+}
+
+void Reclaimer::run(QAtomicInt const& stop_flag, Progress const& progress) {
+    int total = 0;
+    {
+        QMutexLocker locker(&lock);
+        for (auto const& task : tasks) {
+            total += task.files.size();
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    while (stop_flag == 0) {
+        ReclaimTask task;
+        {
+            QMutexLocker locker(&lock);
+            if (tasks.empty()) { break; }
+            task = tasks.takeFirst();
+        }
+
+        QByteArray keep = task.keep == RecordStore::none ? QByteArray() : store->native_path(task.keep);
+        for (auto file : task.files) {
+            if (stop_flag != 0) { break; }
+            qint64 freed = 0;
+            bool ok = reclaim(keep, task.reference, store->native_path(file), store->size(file), freed);
+
+            QMutexLocker locker(&lock);
+            outcomes.push_back({task.group, file, ok});
+            if (ok) {
+                done++;
+            } else {
+                failed++;
+            }
+            bytes += freed;
+        }
+
+        if (timer.elapsed() >= progress_interval) {
+            progress(done + failed, total, bytes);
+            timer.restart();
+        }
+    }
+    progress(done + failed, total, bytes);
+}
+
+QVector<ReclaimOutcome> Reclaimer::take_outcomes() {
+    QMutexLocker locker(&lock);
+    QVector<ReclaimOutcome> result;
+    result.swap(outcomes);
+    return result;
+}
+
+int Reclaimer::files_done() const {
+    return done;
+}
+
+int Reclaimer::files_failed() const {
+    return failed;
+}
+
+qint64 Reclaimer::bytes_reclaimed() const {
+    return bytes;
+}
+
+bool Reclaimer::reclaim(QByteArray const& keep, QByteArray const& reference, QByteArray const& path, qint64 size,
+                        qint64& freed) {
+    bool deduping = reclaim_action == ReclaimAction::Dedupe;
+    if (keep.isEmpty() && reclaim_action != ReclaimAction::Delete) { return false; }
+    // the index only matched digests, the copy it names is compared
+    if (!reference.isEmpty() && (dry || verify)
+            && !same_content(QFile::decodeName(reference), QFile::decodeName(path))) {
+        return false;
+    }
+    if (!keep.isEmpty() && (dry || (verify && !deduping))
+            && !same_content(QFile::decodeName(keep), QFile::decodeName(path))) {
+        return false;
+    }
+
+    if (dry) {
+        freed = deduping ? size : freed_by_unlink(path);
+        return true;
+    }
+    switch (reclaim_action) {
+    case ReclaimAction::Dedupe:
+        return dedupe(keep, path, size, freed);
+    case ReclaimAction::Hardlink:
+        freed = freed_by_unlink(path);
+        if (!replace_with_link(keep, path)) {
+            freed = 0;
+            return false;
+        }
+        return true;
+    default:
+        freed = freed_by_unlink(path);
+        if (unlink(path.constData()) != 0) {
+            freed = 0;
+            return false;
+        }
+        return true;
+    }
+}
+
+// the link is made next to the copy and renamed over it, so the path
+// never goes missing. Fails across filesystems.
+bool Reclaimer::replace_with_link(QByteArray const& keep, QByteArray const& path) {
+    struct stat kept;
+    struct stat copy;
+    if (stat(keep.constData(), &kept) != 0 || lstat(path.constData(), &copy) != 0) {
+        return false;
+    }
+    if (kept.st_dev == copy.st_dev && kept.st_ino == copy.st_ino) {
+        return true; // rename would leave the temporary name behind
+    }
+
+    QByteArray temporary = path + ".fd-link";
+    if (link(keep.constData(), temporary.constData()) != 0) {
+        return false;
+    }
+    if (rename(temporary.constData(), path.constData()) != 0) {
+        unlink(temporary.constData());
+        return false;
+    }
+    return true;
+}
+
+// the kernel compares each range and only shares it if the bytes are equal
+bool Reclaimer::dedupe(QByteArray const& keep, QByteArray const& path, qint64 size, qint64& shared) {
+    int source = open(keep.constData(), O_RDONLY | O_CLOEXEC);
+    if (source < 0) { return false; }
+    int target = open(path.constData(), O_RDWR | O_CLOEXEC);
+    if (target < 0 && (errno == EACCES || errno == EPERM)) {
+        target = open(path.constData(), O_RDONLY | O_CLOEXEC);
+    }
+    if (target < 0) {
+        close(source);
+        return false;
+    }
+
+    QByteArray buffer(sizeof(file_dedupe_range) + sizeof(file_dedupe_range_info), 0);
+    auto range = reinterpret_cast<file_dedupe_range*>(buffer.data());
+    auto& info = range->info[0];
+    bool ok = true;
+    for (qint64 offset = 0; ok && offset < size;) {
+        range->src_offset = offset;
+        range->src_length = qMin(dedupe_chunk, size - offset);
+        range->dest_count = 1;
+        info.dest_fd = target;
+        info.dest_offset = offset;
+        info.bytes_deduped = 0;
+        info.status = 0;
+        ok = ioctl(source, FIDEDUPERANGE, range) == 0 && info.status == FILE_DEDUPE_RANGE_SAME
+                && info.bytes_deduped > 0;
+        offset += info.bytes_deduped;
+        shared += info.bytes_deduped;
+    }
+    close(target);
+    close(source);
+    return ok;
+}
+
+// the data only goes away with its last name
+qint64 Reclaimer::freed_by_unlink(QByteArray const& path) {
+    struct stat st;
+    if (lstat(path.constData(), &st) != 0 || st.st_nlink > 1) {
+        return 0;
+    }
+    return st.st_size;
+}
+
+QString Reclaimer::name(ReclaimAction action) {
+    switch (action) {
+    case ReclaimAction::Hardlink:
+        return "Replace with hard links";
+    case ReclaimAction::Dedupe:
+        return "Share extents";
+    default:
+        return "Delete";
+    }
+}
+
+QString Reclaimer::key(ReclaimAction action) {
+    switch (action) {
+    case ReclaimAction::Hardlink:
+        return "hardlink";
+    case ReclaimAction::Dedupe:
+        return "dedupe";
+    default:
+        return "delete";
+    }
+}
+
+bool Reclaimer::parse(QString const& key, ReclaimAction& action) {
+    for (auto candidate : {ReclaimAction::Delete, ReclaimAction::Hardlink, ReclaimAction::Dedupe}) {
+        if (Reclaimer::key(candidate).compare(key, Qt::CaseInsensitive) == 0) {
+            action = candidate;
+            return true;
+        }
+    }
+    return false;
+}
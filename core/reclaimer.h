@@ -0,0 +1,90 @@
+#ifndef RECLAIMER_H
+#define RECLAIMER_H
+
+#include "recordstore.h"
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+// what becomes of the copies of a kept file. Hard links and deduplicated
+// extents keep every path, only the space of the copies is freed.
+enum class ReclaimAction {
+    Delete,
+    Hardlink,
+    Dedupe
+};
+
+// copies of keep within one group, keep is none to delete without a copy.
+// reference is a copy outside the scan the files are compared with
+// before they are deleted, a task fails if it cannot be read.
+struct ReclaimTask {
+    int group;
+    quint32 keep;
+    QVector<quint32> files;
+    QByteArray reference;
+};
+
+struct ReclaimOutcome {
+    int group;
+    quint32 file;
+    bool done;
+};
+
+// applies an action to queued tasks off the GUI thread. Content is
+// compared with the kept file before a copy is deleted or replaced,
+// deduplication is compared by the kernel itself. A dry run compares
+// and counts but changes nothing.
+class Reclaimer {
+public:
+    typedef std::function<void(int done, int total, qint64 bytes)> Progress;
+
+    Reclaimer();
+
+    void set_store(RecordStore const* store);
+    // must not be called while tasks run
+    void set_action(ReclaimAction action, bool dry_run, bool verify);
+    ReclaimAction action() const;
+    bool dry_run() const;
+
+    void add(ReclaimTask const& task);
+    void clear();
+    bool empty();
+
+    // works through the queued tasks, progress is reported every batch
+    void run(QAtomicInt const& stop_flag, Progress const& progress);
+    // outcomes since the last call
+    QVector<ReclaimOutcome> take_outcomes();
+
+    int files_done() const;
+    int files_failed() const;
+    qint64 bytes_reclaimed() const;
+
+    static QString name(ReclaimAction action);
+    // short name for command lines: delete, hardlink, dedupe
+    static QString key(ReclaimAction action);
+    static bool parse(QString const& key, ReclaimAction& action);
+
+private:
+    bool reclaim(QByteArray const& keep, QByteArray const& reference, QByteArray const& path, qint64 size, qint64& freed);
+    static bool replace_with_link(QByteArray const& keep, QByteArray const& path);
+    static bool dedupe(QByteArray const& keep, QByteArray const& path, qint64 size, qint64& shared);
+    static qint64 freed_by_unlink(QByteArray const& path);
+
+    RecordStore const* store;
+    ReclaimAction reclaim_action;
+    bool dry;
+    bool verify;
+
+    QMutex lock;
+    QVector<ReclaimTask> tasks;
+    QVector<ReclaimOutcome> outcomes;
+
+    int done;
+    int failed;
+    qint64 bytes;
+};
+
+#endif // RECLAIMER_H
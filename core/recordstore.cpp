@@ -0,0 +1,287 @@
+#include "recordstore.h"
+
+#include <QFile>
+#include <QMutexLocker>
+
+#include <cstring>
+
+RecordStore::RecordStore() : chunks(new Chunk*[max_chunks]()), blocks(new char*[max_blocks]()),
+    used_blocks(0), block_used(block_size), dir_blocks(0), dir_block_used(block_size), files(0) {}
+
+RecordStore::~RecordStore() {
+    clear();
+    delete[] chunks;
+    delete[] blocks;
+}
+
+void RecordStore::clear() {
+    for (quint32 i = 0; i < (files + chunk_size - 1) >> chunk_bits; i++) {
+        delete chunks[i];
+        chunks[i] = nullptr;
+    }
+    for (int i = 0; i < used_blocks; i++) {
+        delete[] blocks[i];
+        blocks[i] = nullptr;
+    }
+    used_blocks = 0;
+    block_used = block_size;
+    dir_blocks = 0;
+    dir_block_used = block_size;
+    files = 0;
+    dir_parent.clear();
+    dir_name.clear();
+    dir_left_out.clear();
+    devices.clear();
+    device_ids.clear();
+    shared_owner.clear();
+}
+
+void RecordStore::drop_files() {
+    for (quint32 i = 0; i < (files + chunk_size - 1) >> chunk_bits; i++) {
+        delete chunks[i];
+        chunks[i] = nullptr;
+    }
+    for (int i = dir_blocks; i < used_blocks; i++) {
+        delete[] blocks[i];
+        blocks[i] = nullptr;
+    }
+    used_blocks = dir_blocks;
+    block_used = dir_block_used;
+    files = 0;
+    shared_owner.clear();
+}
+
+// names are never split between blocks, ref is block << block_bits | offset
+quint32 RecordStore::add_name(char const* name, int length) {
+    if (block_used + length + 1 > block_size) {
+        Q_ASSERT(used_blocks < max_blocks);
+        blocks[used_blocks++] = new char[block_size];
+        block_used = 0;
+    }
+    quint32 ref = quint32(used_blocks - 1) << block_bits | quint32(block_used);
+    memcpy(blocks[used_blocks - 1] + block_used, name, length);
+    blocks[used_blocks - 1][block_used + length] = 0;
+    block_used += length + 1;
+    return ref;
+}
+
+char const* RecordStore::name(quint32 ref) const {
+    return blocks[ref >> block_bits] + (ref & (block_size - 1));
+}
+
+quint32 RecordStore::add_dir(quint32 parent, QByteArray const& name) {
+    QMutexLocker locker(&lock);
+    dir_parent.push_back(parent);
+    dir_name.push_back(add_name(name.constData(), name.size()));
+    dir_left_out.push_back(0);
+    dir_blocks = used_blocks;
+    dir_block_used = block_used;
+    return dir_parent.size() - 1;
+}
+
+void RecordStore::add_files(quint32 dir, QVector<FileInfo> const& infos, QVector<quint32>& ids) {
+    QMutexLocker locker(&lock);
+    for (auto const& info : infos) {
+        quint32 file = files;
+        if ((file & (chunk_size - 1)) == 0) {
+            Q_ASSERT((file >> chunk_bits) < quint32(max_chunks));
+            chunks[file >> chunk_bits] = new Chunk;
+        }
+        chunk(file).name[slot(file)] = add_name(info.name.constData(), info.name.size());
+        set_file(file, dir, info);
+
+        ids.push_back(file);
+        files.storeRelease(file + 1);
+    }
+}
+
+void RecordStore::reuse_file(quint32 file, quint32 dir, FileInfo const& info) {
+    QMutexLocker locker(&lock);
+    auto& ref = chunk(file).name[slot(file)];
+    if (chunk(file).dir[slot(file)] != dir || info.name != name(ref)) {
+        ref = add_name(info.name.constData(), info.name.size());
+    }
+    set_file(file, dir, info);
+    shared_owner.remove(file);
+}
+
+// the lock is held
+void RecordStore::set_file(quint32 file, quint32 dir, FileInfo const& info) {
+    auto& c = chunk(file);
+    int i = slot(file);
+
+    auto device = device_ids.find(info.device);
+    if (device == device_ids.end()) {
+        device = device_ids.insert(info.device, devices.size());
+        devices.push_back(info.device);
+    }
+
+    c.dir[i] = dir;
+    c.device[i] = device.value();
+    c.size[i] = info.size;
+    c.inode[i] = info.inode;
+    c.mtime[i] = info.mtime;
+    c.ctime[i] = info.ctime;
+    c.state[i] = quint8(Stage::Size) | (info.unreadable ? Unreadable : 0) | (info.linked ? Linked : 0);
+}
+
+quint32 RecordStore::count() const {
+    return files.loadAcquire();
+}
+
+quint32 RecordStore::dir_count() const {
+    QMutexLocker locker(&lock);
+    return dir_parent.size();
+}
+
+QByteArray RecordStore::dir_path(quint32 dir) const {
+    QByteArray result;
+    QMutexLocker locker(&lock);
+    for (; dir != none; dir = dir_parent[dir]) {
+        QByteArray parent = name(dir_name[dir]);
+        if (!result.isEmpty() && !parent.endsWith('/')) {
+            result.prepend('/');
+        }
+        result.prepend(parent);
+    }
+    return result;
+}
+
+quint32 RecordStore::parent_dir(quint32 dir) const {
+    QMutexLocker locker(&lock);
+    return dir_parent[dir];
+}
+
+QByteArray RecordStore::leaf_name(quint32 dir) const {
+    QMutexLocker locker(&lock);
+    return name(dir_name[dir]);
+}
+
+void RecordStore::set_left_out(quint32 dir, quint64 names) {
+    QMutexLocker locker(&lock);
+    dir_left_out[dir] = names;
+}
+
+quint64 RecordStore::left_out(quint32 dir) const {
+    QMutexLocker locker(&lock);
+    return dir_left_out[dir];
+}
+
+qint64 RecordStore::bytes_used() const {
+    QMutexLocker locker(&lock);
+    qint64 chunk_count = (files.load() + chunk_size - 1) >> chunk_bits;
+    return chunk_count * qint64(sizeof(Chunk)) + qint64(used_blocks) * block_size
+            + dir_parent.capacity() * qint64(2 * sizeof(quint32));
+}
+
+RecordStore::Chunk& RecordStore::chunk(quint32 file) const {
+    return *chunks[file >> chunk_bits];
+}
+
+int RecordStore::slot(quint32 file) const {
+    return file & (chunk_size - 1);
+}
+
+QByteArray RecordStore::native_path(quint32 file) const {
+    QByteArray result = name(chunk(file).name[slot(file)]);
+    QMutexLocker locker(&lock);
+    for (quint32 dir = chunk(file).dir[slot(file)]; dir != none; dir = dir_parent[dir]) {
+        QByteArray parent = name(dir_name[dir]);
+        if (!parent.endsWith('/')) { // only the root "/" does
+            result.prepend('/');
+        }
+        result.prepend(parent);
+    }
+    return result;
+}
+
+QByteArray RecordStore::join_path(QByteArray const& dir, QByteArray const& name) {
+    return dir.endsWith('/') ? dir + name : dir + '/' + name;
+}
+
+quint32 RecordStore::dir_of(quint32 file) const {
+    return chunk(file).dir[slot(file)];
+}
+
+QByteArray RecordStore::file_name(quint32 file) const {
+    return name(chunk(file).name[slot(file)]);
+}
+
+QString RecordStore::path(quint32 file) const {
+    return QFile::decodeName(native_path(file));
+}
+
+qint64 RecordStore::size(quint32 file) const {
+    return chunk(file).size[slot(file)];
+}
+
+quint64 RecordStore::device(quint32 file) const {
+    QMutexLocker locker(&lock);
+    return devices[chunk(file).device[slot(file)]];
+}
+
+quint64 RecordStore::inode(quint32 file) const {
+    return chunk(file).inode[slot(file)];
+}
+
+qint64 RecordStore::mtime(quint32 file) const {
+    return chunk(file).mtime[slot(file)];
+}
+
+qint64 RecordStore::ctime(quint32 file) const {
+    return chunk(file).ctime[slot(file)];
+}
+
+Stage RecordStore::stage(quint32 file) const {
+    return Stage(chunk(file).state[slot(file)] & StageMask);
+}
+
+void RecordStore::set_stage(quint32 file, Stage stage) {
+    auto& state = chunk(file).state[slot(file)];
+    state = (state & ~StageMask) | quint8(stage);
+}
+
+bool RecordStore::hashed(quint32 file) const {
+    return chunk(file).state[slot(file)] & Hashed;
+}
+
+bool RecordStore::unreadable(quint32 file) const {
+    return chunk(file).state[slot(file)] & Unreadable;
+}
+
+void RecordStore::set_unreadable(quint32 file) {
+    auto& state = chunk(file).state[slot(file)];
+    state = (state & ~Hashed) | Unreadable;
+}
+
+bool RecordStore::linked(quint32 file) const {
+    return chunk(file).state[slot(file)] & Linked;
+}
+
+void RecordStore::set_shared(quint32 file, quint32 owner) {
+    QMutexLocker locker(&lock);
+    shared_owner.insert(file, owner);
+    chunk(file).state[slot(file)] |= Shared;
+}
+
+bool RecordStore::shared(quint32 file) const {
+    return chunk(file).state[slot(file)] & Shared;
+}
+
+quint32 RecordStore::shared_with(quint32 file) const {
+    QMutexLocker locker(&lock);
+    return shared_owner.value(file, none);
+}
+
+QByteArray RecordStore::digest(quint32 file) const {
+    return QByteArray(chunk(file).digest[slot(file)], Digest::width);
+}
+
+void RecordStore::set_digest(quint32 file, QByteArray const& digest) {
+    auto& c = chunk(file);
+    int i = slot(file);
+    memcpy(c.digest[i], digest.constData(), qMin(digest.size(), Digest::width));
+    if ((c.state[i] & StageMask) == quint8(Stage::Full)) {
+        c.state[i] |= Hashed;
+    }
+}
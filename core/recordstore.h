@@ -0,0 +1,151 @@
+#ifndef RECORDSTORE_H
+#define RECORDSTORE_H
+
+#include "digest.h"
+
+#include <QByteArray>
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+// which stage of candidate elimination the digest of a file belongs to
+enum class Stage {
+    Size,
+    Partial,
+    Full
+};
+
+// every walked file as a 32-bit id into arrays of fields. Records live in
+// fixed chunks and names in fixed blocks, so published records never move
+// and can be read without locking while walk threads append new ones.
+// Paths are kept as the parent directory id plus the leaf name.
+class RecordStore {
+public:
+    static const quint32 none = 0xffffffff;
+
+    struct FileInfo {
+        QByteArray name;
+        qint64 size;
+        quint64 device;
+        quint64 inode;
+        qint64 mtime;
+        qint64 ctime;
+        bool unreadable;
+        // the inode has more than one name
+        bool linked;
+    };
+
+    RecordStore();
+    ~RecordStore();
+
+    // must not be called while other threads use the store
+    void clear();
+    // drops every file and the names added after the last directory, ids
+    // start over. Out of core scans add files only once every directory
+    // is in; the same rule as clear() applies.
+    void drop_files();
+
+    quint32 add_dir(quint32 parent, QByteArray const& name);
+    void add_files(quint32 dir, QVector<FileInfo> const& files, QVector<quint32>& ids);
+    // puts another file in the record of one nobody uses any more, as if
+    // it was just added. The name is kept if it did not change.
+    void reuse_file(quint32 file, quint32 dir, FileInfo const& info);
+
+    quint32 count() const;
+    quint32 dir_count() const;
+    QByteArray dir_path(quint32 dir) const;
+    // none for a root, whose name is its whole path
+    quint32 parent_dir(quint32 dir) const;
+    QByteArray leaf_name(quint32 dir) const;
+    // names the walk left out of a directory, hidden, filtered or not
+    // regular entries, as a sum of their hashes; 0 if it left out none
+    void set_left_out(quint32 dir, quint64 names);
+    quint64 left_out(quint32 dir) const;
+    qint64 bytes_used() const;
+
+    QString path(quint32 file) const;
+    QByteArray native_path(quint32 file) const;
+    // name under dir, a root of "/" takes no second slash; an empty name
+    // gives the prefix of every path under dir
+    static QByteArray join_path(QByteArray const& dir, QByteArray const& name);
+    quint32 dir_of(quint32 file) const;
+    QByteArray file_name(quint32 file) const;
+    qint64 size(quint32 file) const;
+    quint64 device(quint32 file) const;
+    quint64 inode(quint32 file) const;
+    qint64 mtime(quint32 file) const;
+    qint64 ctime(quint32 file) const;
+
+    Stage stage(quint32 file) const;
+    void set_stage(quint32 file, Stage stage);
+    bool hashed(quint32 file) const;
+    bool unreadable(quint32 file) const;
+    // the file could not be read to the end, it keeps no digest
+    void set_unreadable(quint32 file);
+    bool linked(quint32 file) const;
+
+    // all extents of the file are those of owner, so is the content
+    void set_shared(quint32 file, quint32 owner);
+    bool shared(quint32 file) const;
+    quint32 shared_with(quint32 file) const;
+
+    QByteArray digest(quint32 file) const;
+    // stores the digest of the current stage, a full one marks the file hashed
+    void set_digest(quint32 file, QByteArray const& digest);
+
+private:
+    static const int chunk_bits = 16;
+    static const int chunk_size = 1 << chunk_bits;
+    static const int max_chunks = 1 << 16;
+    static const int block_bits = 20;
+    static const int block_size = 1 << block_bits;
+    static const int max_blocks = 1 << (32 - block_bits);
+
+    enum State : quint8 {
+        StageMask = 3,
+        Hashed = 4,
+        Unreadable = 8,
+        Linked = 16,
+        Shared = 32
+    };
+
+    struct Chunk {
+        quint32 dir[chunk_size];
+        quint32 name[chunk_size];
+        quint32 device[chunk_size];
+        qint64 size[chunk_size];
+        quint64 inode[chunk_size];
+        qint64 mtime[chunk_size];
+        qint64 ctime[chunk_size];
+        char digest[chunk_size][Digest::width];
+        quint8 state[chunk_size];
+    };
+
+    Chunk& chunk(quint32 file) const;
+    int slot(quint32 file) const;
+    quint32 add_name(char const* name, int length);
+    void set_file(quint32 file, quint32 dir, FileInfo const& info);
+    char const* name(quint32 ref) const;
+
+    Chunk** chunks;
+    char** blocks;
+    int used_blocks;
+    int block_used;
+    // name blocks in use after the last directory
+    int dir_blocks;
+    int dir_block_used;
+    QAtomicInteger<quint32> files;
+
+    // directories and devices are few, they are guarded by the lock
+    mutable QMutex lock;
+    QVector<quint32> dir_parent;
+    QVector<quint32> dir_name;
+    QVector<quint64> dir_left_out;
+    QVector<quint64> devices;
+    QHash<quint64, quint32> device_ids;
+    QHash<quint32, quint32> shared_owner;
+};
+
+#endif // RECORDSTORE_H
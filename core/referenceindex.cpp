@@ -0,0 +1,300 @@
+#include "referenceindex.h"
+#include "snapshot.h"
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QScopedPointer>
+#include <QTemporaryFile>
+#include <QVector>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// ten bits and seven probes per key, about one false positive in a hundred
+const int bits_per_key = 10;
+const int probes = 7;
+
+quint64 mix(quint64 x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// digests are uniform already, two words of one make the probe sequence
+void probe_hashes(qint64 size, char const* digest, quint64 tag, quint64& h1, quint64& h2) {
+    quint64 a;
+    quint64 b;
+    memcpy(&a, digest, sizeof(a));
+    memcpy(&b, digest + sizeof(a), sizeof(b));
+    h1 = mix(a ^ quint64(size) ^ tag);
+    h2 = mix(b + tag) | 1;
+}
+
+template <typename Entry>
+bool entry_less(Entry const& entry, qint64 size, char const* digest) {
+    return entry.size < size || (entry.size == size && memcmp(entry.digest, digest, Digest::width) < 0);
+}
+
+bool copy_into(QIODevice& out, QTemporaryFile& part) {
+    part.seek(0);
+    QByteArray block;
+    while (!(block = part.read(FileReader::chunk)).isEmpty()) {
+        if (out.write(block) != block.size()) { return false; }
+    }
+    return true;
+}
+
+}
+
+ReferenceIndex::ReferenceIndex() : file(), header(), sizes(nullptr), partials(nullptr), fulls(nullptr), bloom(nullptr),
+    names(nullptr) {}
+
+ReferenceIndex::~ReferenceIndex() {
+    close();
+}
+
+bool ReferenceIndex::open(QString const& path) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(Header))) {
+        file.close();
+        return false;
+    }
+    uchar* data = file.map(0, file.size());
+    if (data == nullptr) {
+        file.close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    qint64 expected = qint64(sizeof(Header)) + header.sizes * qint64(sizeof(qint64))
+            + header.partials * qint64(sizeof(PartialEntry)) + header.fulls * qint64(sizeof(FullEntry))
+            + header.bloom_words * qint64(sizeof(quint64)) + header.names_size;
+    bool power_of_two = header.bloom_words > 0 && (header.bloom_words & (header.bloom_words - 1)) == 0;
+    if (header.magic != magic || header.version != version || !power_of_two || file.size() != expected) {
+        close();
+        return false;
+    }
+    sizes = reinterpret_cast<qint64 const*>(data + sizeof(Header));
+    partials = reinterpret_cast<PartialEntry const*>(sizes + header.sizes);
+    fulls = reinterpret_cast<FullEntry const*>(partials + header.partials);
+    bloom = reinterpret_cast<quint64 const*>(fulls + header.fulls);
+    names = reinterpret_cast<char const*>(bloom + header.bloom_words);
+    return true;
+}
+
+void ReferenceIndex::close() {
+    if (file.isOpen()) {
+        file.close(); // unmaps as well
+    }
+    memset(&header, 0, sizeof(header));
+    sizes = nullptr;
+    partials = nullptr;
+    fulls = nullptr;
+    bloom = nullptr;
+    names = nullptr;
+}
+
+bool ReferenceIndex::is_open() const {
+    return sizes != nullptr;
+}
+
+DigestType ReferenceIndex::digest() const {
+    return DigestType(header.digest);
+}
+
+qint64 ReferenceIndex::block_size() const {
+    return header.block_size;
+}
+
+qint64 ReferenceIndex::partial_min_size() const {
+    return header.partial_min_size;
+}
+
+qint64 ReferenceIndex::files() const {
+    return header.files;
+}
+
+bool ReferenceIndex::has_size(qint64 size) const {
+    return std::binary_search(sizes, sizes + header.sizes, size);
+}
+
+bool ReferenceIndex::has_partial(qint64 size, QByteArray const& digest) const {
+    if (!bloom_test(size, digest.constData(), partial_tag)) { return false; }
+    auto end = partials + header.partials;
+    auto it = std::lower_bound(partials, end, size, [&](PartialEntry const& entry, qint64) {
+        return entry_less(entry, size, digest.constData());
+    });
+    return it != end && it->size == size && memcmp(it->digest, digest.constData(), Digest::width) == 0;
+}
+
+QByteArray ReferenceIndex::find(qint64 size, QByteArray const& digest) const {
+    if (!bloom_test(size, digest.constData(), full_tag)) { return QByteArray(); }
+    auto end = fulls + header.fulls;
+    auto it = std::lower_bound(fulls, end, size, [&](FullEntry const& entry, qint64) {
+        return entry_less(entry, size, digest.constData());
+    });
+    if (it == end || it->size != size || memcmp(it->digest, digest.constData(), Digest::width) != 0) {
+        return QByteArray();
+    }
+    return QByteArray(names + it->path);
+}
+
+void ReferenceIndex::bloom_add(quint64* words, qint64 count, int probes, qint64 size, char const* digest, quint64 tag) {
+    quint64 h1;
+    quint64 h2;
+    probe_hashes(size, digest, tag, h1, h2);
+    quint64 mask = quint64(count) * 64 - 1;
+    for (int i = 0; i < probes; i++) {
+        quint64 bit = (h1 + i * h2) & mask;
+        words[bit >> 6] |= quint64(1) << (bit & 63);
+    }
+}
+
+bool ReferenceIndex::bloom_test(qint64 size, char const* digest, quint64 tag) const {
+    quint64 h1;
+    quint64 h2;
+    probe_hashes(size, digest, tag, h1, h2);
+    quint64 mask = quint64(header.bloom_words) * 64 - 1;
+    for (quint32 i = 0; i < header.bloom_probes; i++) {
+        quint64 bit = (h1 + i * h2) & mask;
+        if (!(bloom[bit >> 6] & (quint64(1) << (bit & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the snapshot is read one size at a time, tables go to temporary files
+// next to the index and only the filter is held whole
+bool ReferenceIndex::build(QString const& snapshot_path, QString const& path, ReadStrategy strategy, QString& error) {
+    Snapshot snapshot;
+    if (!snapshot.open(snapshot_path)) {
+        error = "cannot read snapshot " + snapshot_path;
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = magic;
+    header.version = version;
+    header.digest = quint32(snapshot.digest());
+    header.bloom_probes = probes;
+    header.block_size = snapshot.block_size();
+    header.partial_min_size = snapshot.partial_min_size();
+    header.files = snapshot.count();
+    header.bloom_words = 1;
+    while (header.bloom_words * 64 < 2 * qMax<qint64>(snapshot.count(), 1) * bits_per_key) {
+        header.bloom_words *= 2;
+    }
+    std::vector<quint64> words(size_t(header.bloom_words), 0);
+
+    QString pattern = QFileInfo(path).absolutePath() + "/.reference-XXXXXX";
+    QTemporaryFile size_part(pattern);
+    QTemporaryFile partial_part(pattern);
+    QTemporaryFile full_part(pattern);
+    QTemporaryFile name_part(pattern);
+    if (!size_part.open() || !partial_part.open() || !full_part.open() || !name_part.open()) {
+        error = "cannot write temporary files next to " + path;
+        return false;
+    }
+
+    QScopedPointer<FileReader> reader(FileReader::create(strategy, false));
+    QScopedPointer<Digest> digest(Digest::create(snapshot.digest()));
+    QVector<PartialEntry> bucket_partials;
+    QVector<FullEntry> bucket_fulls;
+    QVector<QByteArray> bucket_paths;
+    for (qint64 first = 0; first < snapshot.count();) {
+        qint64 size = snapshot.record(first).size;
+        qint64 last = first;
+        while (last < snapshot.count() && snapshot.record(last).size == size) {
+            last++;
+        }
+        size_part.write(reinterpret_cast<char const*>(&size), sizeof(size));
+        header.sizes++;
+
+        bool partial_stage = Snapshot::next_stage(size, header.block_size, header.partial_min_size) == Stage::Partial;
+        bucket_partials.clear();
+        bucket_fulls.clear();
+        bucket_paths.clear();
+        for (qint64 i = first; i < last; i++) {
+            auto const& record = snapshot.record(i);
+            if (record.flags & SnapshotRecord::Unreadable) { continue; }
+            QByteArray file = snapshot.path(i);
+            QByteArray result;
+
+            FullEntry full;
+            full.size = size;
+            if (record.flags & SnapshotRecord::HasFull) {
+                memcpy(full.digest, record.full, Digest::width);
+            } else if (Snapshot::hash_file(reader.data(), digest.data(), file, size, Stage::Full, header.block_size, result)) {
+                memcpy(full.digest, result.constData(), Digest::width);
+            } else {
+                continue;
+            }
+            full.path = quint64(bucket_paths.size()); // the name offset once it is kept
+            bucket_paths.push_back(file);
+            bucket_fulls.push_back(full);
+
+            if (!partial_stage) { continue; }
+            PartialEntry partial;
+            partial.size = size;
+            if (record.flags & SnapshotRecord::HasPartial) {
+                memcpy(partial.digest, record.partial, Digest::width);
+            } else if (Snapshot::hash_file(reader.data(), digest.data(), file, size, Stage::Partial, header.block_size, result)) {
+                memcpy(partial.digest, result.constData(), Digest::width);
+            } else {
+                continue;
+            }
+            bucket_partials.push_back(partial);
+        }
+
+        // one entry per content is enough to answer a lookup
+        std::sort(bucket_partials.begin(), bucket_partials.end(), [](PartialEntry const& a, PartialEntry const& b) {
+            return memcmp(a.digest, b.digest, Digest::width) < 0;
+        });
+        for (int i = 0; i < bucket_partials.size(); i++) {
+            auto const& entry = bucket_partials[i];
+            if (i > 0 && memcmp(entry.digest, bucket_partials[i - 1].digest, Digest::width) == 0) { continue; }
+            partial_part.write(reinterpret_cast<char const*>(&entry), sizeof(entry));
+            bloom_add(words.data(), header.bloom_words, probes, size, entry.digest, partial_tag);
+            header.partials++;
+        }
+        std::sort(bucket_fulls.begin(), bucket_fulls.end(), [](FullEntry const& a, FullEntry const& b) {
+            return memcmp(a.digest, b.digest, Digest::width) < 0;
+        });
+        for (int i = 0; i < bucket_fulls.size(); i++) {
+            auto entry = bucket_fulls[i];
+            if (i > 0 && memcmp(entry.digest, bucket_fulls[i - 1].digest, Digest::width) == 0) { continue; }
+            QByteArray const& name = bucket_paths[int(entry.path)];
+            entry.path = quint64(header.names_size);
+            name_part.write(name.constData(), name.size() + 1);
+            header.names_size += name.size() + 1;
+            full_part.write(reinterpret_cast<char const*>(&entry), sizeof(entry));
+            bloom_add(words.data(), header.bloom_words, probes, size, entry.digest, full_tag);
+            header.fulls++;
+        }
+        first = last;
+    }
+
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        error = "cannot write " + path;
+        return false;
+    }
+    out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    bool written = copy_into(out, size_part) && copy_into(out, partial_part) && copy_into(out, full_part);
+    qint64 bloom_bytes = qint64(words.size() * sizeof(quint64));
+    written = written && out.write(reinterpret_cast<char const*>(words.data()), bloom_bytes) == bloom_bytes;
+    written = written && copy_into(out, name_part);
+    if (!written || !out.commit()) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef REFERENCEINDEX_H
+#define REFERENCEINDEX_H
+
+#include "digest.h"
+#include "filereader.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// a prebuilt index of a reference tree, such as an archive, that scans are
+// checked against without walking it. The file holds the sorted table of
+// sizes, a table of head/tail digests and one of full digests with the
+// path of a file for each, and a Bloom filter over both digest tables.
+// It is memory mapped read only: a lookup is a binary search of the size
+// table, or a Bloom probe that only touches the digest tables when it
+// passes, so resident memory stays with the pages lookups hit.
+class ReferenceIndex {
+public:
+    ReferenceIndex();
+    ~ReferenceIndex();
+
+    bool open(QString const& path);
+    void close();
+    bool is_open() const;
+
+    // scans checked against the index must hash the way it was built
+    DigestType digest() const;
+    qint64 block_size() const;
+    qint64 partial_min_size() const;
+    qint64 files() const;
+
+    bool has_size(qint64 size) const;
+    bool has_partial(qint64 size, QByteArray const& digest) const;
+    // a path in the reference with this content, null if there is none
+    QByteArray find(qint64 size, QByteArray const& digest) const;
+
+    // from a snapshot of the reference tree. The digests the snapshot
+    // lacks are computed here, each reference file is read at most once.
+    static bool build(QString const& snapshot, QString const& path, ReadStrategy strategy, QString& error);
+
+private:
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint32 digest;
+        quint32 bloom_probes;
+        qint64 block_size;
+        qint64 partial_min_size;
+        qint64 files;
+        qint64 sizes;
+        qint64 partials;
+        qint64 fulls;
+        qint64 bloom_words;
+        qint64 names_size;
+    };
+
+    struct PartialEntry {
+        qint64 size;
+        char digest[Digest::width];
+    };
+
+    struct FullEntry {
+        qint64 size;
+        quint64 path;
+        char digest[Digest::width];
+    };
+
+    static const quint32 magic = 0x49524446; // "FDRI"
+    static const quint32 version = 1;
+    // tags keep the keys of the two tables apart in the one filter
+    static const quint64 partial_tag = 0x7061727469616cULL;
+    static const quint64 full_tag = 0x66756c6cULL;
+
+    static void bloom_add(quint64* words, qint64 count, int probes, qint64 size, char const* digest, quint64 tag);
+    bool bloom_test(qint64 size, char const* digest, quint64 tag) const;
+
+    QFile file;
+    Header header;
+    qint64 const* sizes;
+    PartialEntry const* partials;
+    FullEntry const* fulls;
+    quint64 const* bloom;
+    char const* names;
+};
+
+#endif // REFERENCEINDEX_H
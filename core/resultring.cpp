@@ -0,0 +1,104 @@
+#include "resultring.h"
+
+#include <QThread>
+
+ResultRing::ResultRing(int capacity) : cells(new Cell[capacity]), mask(capacity - 1),
+    enqueue_pos(0), dequeue_pos(0), scheduled(0), notify() {
+    Q_ASSERT((capacity & (capacity - 1)) == 0);
+    for (int i = 0; i < capacity; i++) {
+        cells[i].sequence.storeRelease(i);
+        cells[i].data = 0;
+    }
+}
+
+ResultRing::~ResultRing() {
+    delete[] cells;
+}
+
+void ResultRing::set_notify(std::function<void()> const& notify) {
+    this->notify = notify;
+}
+
+// a cell is free for position pos when its sequence equals pos,
+// and holds data for the consumer when it equals pos + 1
+bool ResultRing::try_push(quint32 file) {
+    quint64 pos = enqueue_pos.load();
+    while (true) {
+        Cell& cell = cells[pos & mask];
+        qint64 diff = qint64(cell.sequence.loadAcquire()) - qint64(pos);
+        if (diff == 0) {
+            if (enqueue_pos.testAndSetRelaxed(pos, pos + 1, pos)) {
+                cell.data = file;
+                cell.sequence.storeRelease(pos + 1);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueue_pos.load();
+        }
+    }
+}
+
+// the consumer may be waiting for the producer to stop, so a stop ends
+// the wait for a free cell
+bool ResultRing::wait_push(quint32 file, QAtomicInt const& stop_flag) {
+    while (!try_push(file)) {
+        if (stop_flag != 0) { return false; }
+        wake();
+        QThread::yieldCurrentThread();
+    }
+    return true;
+}
+
+bool ResultRing::push(quint32 file, QAtomicInt const& stop_flag) {
+    bool pushed = wait_push(file, stop_flag);
+    wake();
+    return pushed;
+}
+
+bool ResultRing::push(QVector<quint32> const& files, QAtomicInt const& stop_flag) {
+    bool pushed = true;
+    for (int i = 0; pushed && i < files.size(); i++) {
+        pushed = wait_push(files[i], stop_flag);
+    }
+    wake();
+    return pushed;
+}
+
+int ResultRing::pop(QVector<quint32>& out, int max) {
+    int taken = 0;
+    quint64 pos = dequeue_pos.load();
+    while (taken < max) {
+        Cell& cell = cells[pos & mask];
+        if (cell.sequence.loadAcquire() != pos + 1) {
+            break;
+        }
+        out.push_back(cell.data);
+        cell.sequence.storeRelease(pos + mask + 1);
+        pos++;
+        taken++;
+    }
+    dequeue_pos.store(pos);
+    return taken;
+}
+
+bool ResultRing::empty() const {
+    quint64 pos = dequeue_pos.load();
+    return cells[pos & mask].sequence.loadAcquire() != pos + 1;
+}
+
+int ResultRing::size() const {
+    qint64 size = qint64(enqueue_pos.load()) - qint64(dequeue_pos.load());
+    return static_cast<int>(qMax<qint64>(size, 0));
+}
+
+void ResultRing::begin_drain() {
+    scheduled.storeRelease(0);
+}
+
+void ResultRing::wake() {
+    if (notify && scheduled.testAndSetOrdered(0, 1)) {
+        notify();
+    }
+}
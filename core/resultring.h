@@ -0,0 +1,49 @@
+#ifndef RESULTRING_H
+#define RESULTRING_H
+
+#include <QAtomicInteger>
+#include <QVector>
+
+#include <functional>
+
+// bounded lock-free queue carrying file ids from the walk and hash threads
+// to the engine. Producers wait while it is full, until their stop flag is
+// set, the single consumer is woken through notify once per drain.
+class ResultRing {
+public:
+    explicit ResultRing(int capacity = 1 << 16);
+    ~ResultRing();
+
+    void set_notify(std::function<void()> const& notify);
+
+    // false if stop_flag was set while the ring was full, the rest is dropped
+    bool push(quint32 file, QAtomicInt const& stop_flag);
+    bool push(QVector<quint32> const& files, QAtomicInt const& stop_flag);
+
+    // consumer side: takes up to max files, returns how many were taken
+    int pop(QVector<quint32>& out, int max);
+    bool empty() const;
+    // files pushed and not yet popped, approximate while producers run
+    int size() const;
+    // called by the consumer before it drains, so that new pushes wake it again
+    void begin_drain();
+    void wake();
+
+private:
+    struct Cell {
+        QAtomicInteger<quint64> sequence;
+        quint32 data;
+    };
+
+    bool try_push(quint32 file);
+    bool wait_push(quint32 file, QAtomicInt const& stop_flag);
+
+    Cell* cells;
+    quint64 mask;
+    QAtomicInteger<quint64> enqueue_pos;
+    QAtomicInteger<quint64> dequeue_pos;
+    QAtomicInt scheduled;
+    std::function<void()> notify;
+};
+
+#endif // RESULTRING_H
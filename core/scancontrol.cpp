@@ -0,0 +1,47 @@
+#include "scancontrol.h"
+
+#include <QMutexLocker>
+
+ScanControl::ScanControl() : lock(), resumed(), pause_flag(0), stop_flag(0) {}
+
+void ScanControl::pause() {
+    pause_flag = 1;
+}
+
+void ScanControl::resume() {
+    QMutexLocker locker(&lock);
+    pause_flag = 0;
+    resumed.wakeAll();
+}
+
+void ScanControl::stop() {
+    QMutexLocker locker(&lock);
+    stop_flag = 1;
+    resumed.wakeAll();
+}
+
+void ScanControl::reset() {
+    QMutexLocker locker(&lock);
+    stop_flag = 0;
+    pause_flag = 0;
+    resumed.wakeAll();
+}
+
+bool ScanControl::paused() const {
+    return pause_flag.load() != 0;
+}
+
+bool ScanControl::stopped() const {
+    return stop_flag.load() != 0;
+}
+
+// one atomic load while the scan runs
+bool ScanControl::pass() {
+    if (pause_flag.load() != 0) {
+        QMutexLocker locker(&lock);
+        while (pause_flag.load() != 0 && stop_flag.load() == 0) {
+            resumed.wait(&lock);
+        }
+    }
+    return stop_flag.load() == 0;
+}
@@ -0,0 +1,35 @@
+#ifndef SCANCONTROL_H
+#define SCANCONTROL_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+
+// pause and stop of a running scan, shared by the walk and hash threads.
+// Readers pass it between chunks of a file and walkers between
+// directories, so a stop takes effect within one chunk and a pause holds
+// every thread where it is, with all its state kept.
+class ScanControl {
+public:
+    ScanControl();
+
+    void pause();
+    void resume();
+    // wakes paused threads, pass() fails until reset()
+    void stop();
+    void reset();
+
+    bool paused() const;
+    bool stopped() const;
+
+    // blocks while paused, false once stopped
+    bool pass();
+
+private:
+    QMutex lock;
+    QWaitCondition resumed;
+    QAtomicInt pause_flag;
+    QAtomicInt stop_flag;
+};
+
+#endif // SCANCONTROL_H
@@ -0,0 +1,1627 @@
+#include "scanengine.h"
+#include "dirwalker.h"
+#include "scanprofile.h"
+
+#include <QFile>
+#include <QMetaObject>
+#include <QScopedPointer>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+
+namespace {
+
+// results applied per batch, and the shortest time between progress updates
+const int batch_limit = 4096;
+const int progress_interval = 1000 / 30;
+
+}
+
+ScanEngine::ScanEngine() :
+    QObject(nullptr),
+    store(),
+    group_slots(),
+    groups(),
+    reclaiming(false),
+    analyzing(false),
+    runs(),
+    batch_pending(false),
+    thread(),
+    ring(),
+    listener(&no_listener),
+    no_listener(),
+    telemetry(),
+    telemetry_timer(),
+    control(),
+    checkpoint_timer(),
+    watcher(),
+    watch_changed(false),
+    total_files(0),
+    rehashing_files(0),
+    end_flag(false),
+    scan_finished(false),
+    options(),
+    scan_stats(),
+    timer(),
+    progress_timer(),
+    group_nsecs(0)
+{
+    group_slots.push_back(new Group{QVector<quint32>(), -1, QByteArray(), 0, GroupKind::Copies});
+
+    worker = new HashWorker();
+    worker->moveToThread(&thread);
+    worker->set_ring(&ring);
+    worker->set_store(&store);
+    worker->set_comparer(&comparer);
+    worker->set_telemetry(&telemetry);
+    comparer.set_store(&store);
+    comparer.set_ring(&ring);
+    reclaimer.set_store(&store);
+    worker->set_reclaimer(&reclaimer);
+    chunk_index.set_store(&store);
+    worker->set_chunk_index(&chunk_index);
+    pool = new HashPool();
+    pool->set_ring(&ring);
+    pool->set_store(&store);
+    pool->set_telemetry(&telemetry);
+    pool->set_control(&control);
+    worker->set_control(&control);
+    worker->set_runs(&runs);
+    connect(&telemetry_timer, &QTimer::timeout, this, &ScanEngine::report_telemetry);
+    connect(&checkpoint_timer, &QTimer::timeout, this, &ScanEngine::save_checkpoint);
+    connect(&watcher, &TreeWatcher::changed, this, &ScanEngine::apply_changes);
+    // the walk starts after the notifier that told of the overflow returns
+    connect(&watcher, &TreeWatcher::overflowed, this, &ScanEngine::rescan, Qt::QueuedConnection);
+    ring.set_notify([this]() {
+        QMetaObject::invokeMethod(this, "drain", Qt::QueuedConnection);
+    });
+    connect(this, &ScanEngine::scan_roots, worker, &HashWorker::process);
+    connect(this, &ScanEngine::calc_hash, pool, &HashPool::get_hash);
+    connect(this, &ScanEngine::compare_buckets, worker, &HashWorker::compare_buckets);
+    connect(this, &ScanEngine::run_reclaim, worker, &HashWorker::reclaim);
+    connect(worker, &HashWorker::reclaim_progress, this, &ScanEngine::reclaim_progress);
+    connect(worker, &HashWorker::reclaim_finished, this, &ScanEngine::reclaim_finished);
+    connect(this, &ScanEngine::run_chunks, worker, &HashWorker::analyze_chunks);
+    connect(worker, &HashWorker::chunk_progress, this, &ScanEngine::chunk_progress);
+    connect(worker, &HashWorker::chunks_finished, this, &ScanEngine::chunks_finished);
+    connect(worker, &HashWorker::walk_finished, this, &ScanEngine::walk_finished);
+    connect(worker, &HashWorker::end_scan, this, &ScanEngine::no_more_files);
+    connect(worker, &HashWorker::end_batch, this, &ScanEngine::end_batch);
+    connect(worker, &HashWorker::scan_failed, this, &ScanEngine::fail_scan);
+    connect(this, &ScanEngine::run_digest_comparison, worker, &HashWorker::compare_digests);
+    connect(worker, &HashWorker::digests_compared, this, &ScanEngine::digests_compared);
+    thread.start();
+}
+
+ScanEngine::~ScanEngine() {
+    control.stop(); // paused threads would never return
+    worker->stop();
+    pool->stop(); // neither would threads waiting for room in the ring
+    thread.quit();
+    thread.wait();
+    delete worker;
+    delete pool;
+    qDeleteAll(group_slots);
+}
+
+void ScanEngine::set_listener(EngineListener* listener) {
+    this->listener = listener == nullptr ? &no_listener : listener;
+}
+
+int ScanEngine::group_count() const {
+    return groups.size() + 1;
+}
+
+int ScanEngine::group_at(int row) const {
+    return row < groups.size() ? groups[row] : unique_group;
+}
+
+int ScanEngine::group_row(int group) const {
+    if (group == unique_group) {
+        return groups.size();
+    }
+    return group_slots[group]->row;
+}
+
+Group const& ScanEngine::group(int group) const {
+    return *group_slots[group];
+}
+
+RecordStore const& ScanEngine::records() const {
+    return store;
+}
+
+QString ScanEngine::file_path(quint32 file) const {
+    return store.path(file);
+}
+
+QString ScanEngine::member_path(int group, quint32 member) const {
+    if (group != unique_group && group_slots[group]->kind == GroupKind::Directories) {
+        return QFile::decodeName(store.dir_path(member));
+    }
+    return store.path(member);
+}
+
+int ScanEngine::directory_files(int group) const {
+    return dir_group_files.value(group, 0);
+}
+
+bool ScanEngine::approximate(int group) const {
+    return approximate_groups.contains(group);
+}
+
+bool ScanEngine::published(int group) const {
+    return group == unique_group || group_slots[group]->row < groups.size();
+}
+
+// size and digest of the stage the file is at
+DigestKey ScanEngine::key(quint32 file) const {
+    return DigestKey(store.size(file), store.digest(file).constData());
+}
+
+// slots of removed groups are reused
+int ScanEngine::new_group(qint64 size, QByteArray const& hash, GroupKind kind) {
+    int id = add_slot(new Group{QVector<quint32>(), size, hash, groups.size() + new_groups.size(), kind});
+    new_groups.push_back(id);
+    return id;
+}
+
+int ScanEngine::add_slot(Group* group) {
+    if (free_slots.empty()) {
+        group_slots.push_back(group);
+        return group_slots.size() - 1;
+    }
+    int id = free_slots.back();
+    free_slots.pop_back();
+    group_slots[id] = group;
+    return id;
+}
+
+// directory groups hide most of the file groups, so none is shown before
+// they are known
+bool ScanEngine::holding() const {
+    return options.group_dirs && !scan_finished;
+}
+
+// takes file out of the unique bucket, rows of this batch are dropped
+// at once, published rows are removed by flush()
+void ScanEngine::leave_unique(quint32 file) {
+    int row = unique_row[file];
+    int published_rows = group_slots[unique_group]->files.size();
+    if (row >= published_rows) {
+        appended[unique_group][row - published_rows] = RecordStore::none;
+    } else {
+        removed_unique.push_back(row);
+    }
+}
+
+void ScanEngine::renumber_unique(int first) {
+    auto const& lists = group_slots[unique_group]->files;
+    unique_row.resize(qMax<int>(unique_row.size(), store.count()));
+    for (int row = first; row < lists.size(); row++) {
+        unique_row[lists[row]] = row;
+    }
+}
+
+// groups created in this batch are filled directly, they are not shown yet
+void ScanEngine::add_to_group(quint32 file, int group) {
+    if (published(group)) {
+        auto& batch = appended[group];
+        if (group == unique_group) {
+            if (file >= quint32(unique_row.size())) {
+                unique_row.resize(qMax<int>(store.count(), file + 1));
+            }
+            unique_row[file] = group_slots[unique_group]->files.size() + batch.size();
+        }
+        batch.push_back(file);
+    } else {
+        group_slots[group]->files.push_back(file);
+    }
+}
+
+// another name of data that is already known, it is never hashed
+void ScanEngine::add_link(quint32 owner, quint32 file, GroupKind kind) {
+    qint64 size = store.size(file);
+    int group = link_groups.value(owner, -1);
+    if (group < 0) {
+        group = new_group(size, QByteArray(), kind);
+        link_groups.insert(owner, group);
+        unconfirmed.insert(size, group);
+        add_to_group(owner, group);
+    }
+    add_to_group(file, group);
+    link_of.insert(file, group);
+
+    total_files++;
+    if (kind == GroupKind::Hardlinks) {
+        scan_stats.hardlinks++;
+    } else {
+        scan_stats.shared_extents++;
+    }
+    scan_stats.bytes_linked += size;
+}
+
+void ScanEngine::add_file(quint32 file) {
+    if (!dropped_files.empty() && dropped_files.remove(file)) { // changed while it was hashed
+        hash_done(file);
+        recycle(file);
+        return;
+    }
+    qint64 size = store.size(file);
+    if (store.stage(file) == Stage::Size && store.linked(file)) { // hard links are known from the walk
+        InodeKey inode{store.device(file), store.inode(file)};
+        auto owner = inode_to_file.find(inode);
+        if (owner != nullptr) {
+            add_link(*owner, file, GroupKind::Hardlinks);
+            return;
+        }
+        inode_to_file.insert(inode, file);
+    }
+
+    if (store.shared(file)) { // the hash thread found its extents and did not read it
+        hash_done(file);
+        scan_stats.bytes_read -= stage_bytes(size, store.stage(file));
+        add_link(store.shared_with(file), file, GroupKind::SharedExtents);
+        confirm_size(size);
+    } else if (store.unreadable(file)) { // never matches, from the walker or a failed read
+        add_unique(file);
+        if (store.stage(file) != Stage::Size) {
+            hash_done(file);
+            confirm_size(size);
+        }
+    } else if (reference.is_open()) {
+        query_file(file);
+    } else if (store.hashed(file)) {
+        hash_done(file);
+        DigestKey hash = key(file);
+        int group = hash_to_group.value(hash, -1);
+
+        if (group < 0) { // unique
+            quint32 first = unique_by_hash.value(hash, RecordStore::none);
+            if (first == RecordStore::none) {
+                group = unique_group;
+                unique_by_hash.insert(hash, file);
+            } else { // make new group
+                unique_by_hash.remove(hash);
+                group = new_group(size, store.digest(file), GroupKind::Copies);
+                hash_to_group.insert(hash, group);
+                unconfirmed.insert(size, group);
+
+                leave_unique(first);
+                add_to_group(first, group);
+            }
+        }
+
+        add_to_group(file, group);
+
+        total_files++;
+        scan_stats.full_hashed++;
+
+        confirm_size(size);
+    } else if (store.stage(file) == Stage::Size) {
+        scan_stats.bytes_total += size;
+        auto first = size_to_file.find(size);
+        if (first == nullptr) {
+            size_to_file.insert(size, file);
+            scan_stats.size_unique++;
+            add_unique(file);
+        } else {
+            quint32 previous = *first;
+            *first = RecordStore::none;
+            promote(file, previous, next_stage(file));
+        }
+    } else { // head and tail blocks hashed
+        hash_done(file);
+        DigestKey hash = key(file);
+        auto first = partial_to_file.find(hash);
+        if (first == nullptr) {
+            partial_to_file.insert(hash, file);
+            scan_stats.partial_unique++;
+            add_unique(file);
+            confirm_size(size);
+        } else {
+            quint32 previous = *first;
+            *first = RecordStore::none;
+            promote(file, previous, Stage::Full);
+        }
+    }
+
+}
+
+// reference mode: a file is read only as far as something in the
+// reference can still match it. Files of the scanned roots are not
+// compared with each other.
+void ScanEngine::query_file(quint32 file) {
+    qint64 size = store.size(file);
+    if (store.stage(file) == Stage::Size) { // from the walker
+        scan_stats.bytes_total += size;
+        if (reference.has_size(size)) {
+            send_to_hash(file, next_stage(file));
+        } else {
+            scan_stats.size_unique++;
+            add_unique(file);
+        }
+        return;
+    }
+
+    hash_done(file);
+    if (!store.hashed(file)) { // head and tail
+        if (reference.has_partial(size, store.digest(file))) {
+            send_to_hash(file, Stage::Full);
+        } else {
+            scan_stats.partial_unique++;
+            add_unique(file);
+            confirm_size(size);
+        }
+        return;
+    }
+
+    scan_stats.full_hashed++;
+    DigestKey hash = key(file);
+    int group = hash_to_group.value(hash, -1);
+    if (group < 0 && !reference.find(size, store.digest(file)).isNull()) {
+        group = new_group(size, store.digest(file), GroupKind::Referenced);
+        hash_to_group.insert(hash, group);
+        unconfirmed.insert(size, group);
+    }
+    if (group < 0) {
+        add_unique(file);
+    } else {
+        add_to_group(file, group);
+        total_files++;
+        scan_stats.referenced++;
+        scan_stats.bytes_referenced += size;
+    }
+    confirm_size(size);
+}
+
+// applies a batch of results from the walk and hash threads
+void ScanEngine::drain() {
+    QElapsedTimer grouping;
+    grouping.start();
+    ring.begin_drain();
+    QVector<quint32> batch;
+    batch.reserve(batch_limit);
+    ring.pop(batch, batch_limit);
+    for (auto file : batch) {
+        add_file(file);
+    }
+    flush();
+    qint64 nsecs = grouping.nsecsElapsed();
+    group_nsecs += nsecs;
+    telemetry.add_drain(batch.size(), nsecs);
+
+    if (!ring.empty()) {
+        ring.wake();
+    }
+}
+
+// publishes the changes of a batch: removals from the unique bucket,
+// new groups, then one insert per group that got files. While holding
+// they are only applied.
+void ScanEngine::flush() {
+    EngineListener* out = holding() ? &no_listener : listener;
+    if (!removed_unique.empty()) {
+        std::sort(removed_unique.begin(), removed_unique.end());
+        auto& lists = group_slots[unique_group]->files;
+        int i = removed_unique.size() - 1;
+        while (i >= 0) {
+            int last = removed_unique[i];
+            int first = last;
+            while (i > 0 && removed_unique[i - 1] == first - 1) {
+                first--;
+                i--;
+            }
+            i--;
+            out->begin_remove(unique_group, first, last);
+            lists.erase(lists.begin() + first, lists.begin() + last + 1);
+            out->end_remove();
+        }
+        renumber_unique(removed_unique.front());
+        removed_unique.clear();
+    }
+
+    if (!new_groups.empty()) {
+        out->begin_insert(-1, groups.size(), groups.size() + new_groups.size() - 1);
+        groups += new_groups;
+        out->end_insert();
+        new_groups.clear();
+    }
+
+    for (auto it = appended.begin(); it != appended.end(); ++it) {
+        auto group = it.key();
+        auto& lists = group_slots[group]->files;
+        auto& files = it.value();
+        if (group == unique_group) { // drop files that left in this batch
+            files.erase(std::remove(files.begin(), files.end(), RecordStore::none), files.end());
+            for (int i = 0; i < files.size(); i++) {
+                unique_row[files[i]] = lists.size() + i;
+            }
+        }
+        if (files.empty()) { continue; }
+
+        out->begin_insert(group, lists.size(), lists.size() + files.size() - 1);
+        lists += files;
+        out->end_insert();
+        out->group_changed(group); // update group title
+    }
+    appended.clear();
+
+    for (auto group : confirmed) {
+        out->group_confirmed(group);
+    }
+    confirmed.clear();
+
+    if (progress_timer.elapsed() >= progress_interval) {
+        emit progress_update(total_files);
+        progress_timer.restart();
+    }
+    check_end();
+}
+
+void ScanEngine::walk_finished(qint64 entries, qint64 pruned, qint64 bytes_pruned, qint64 msecs) {
+    scan_stats.entries_walked = entries;
+    scan_stats.entries_pruned = pruned;
+    scan_stats.bytes_pruned = bytes_pruned;
+    scan_stats.walk_msecs = msecs;
+}
+
+void ScanEngine::add_unique(quint32 file) {
+    add_to_group(file, unique_group);
+
+    total_files++;
+}
+
+// file collides with others at its stage -- send it further,
+// together with the first file of the bucket if it is still unique
+void ScanEngine::promote(quint32 file, quint32 first, Stage stage) {
+    send_to_hash(file, stage);
+    if (first == RecordStore::none) { return; }
+
+    leave_unique(first);
+    total_files--;
+    if (store.stage(first) == Stage::Size) {
+        scan_stats.size_unique--;
+    } else {
+        scan_stats.partial_unique--;
+    }
+
+    send_to_hash(first, store.stage(first) == Stage::Size ? next_stage(first) : Stage::Full);
+}
+
+void ScanEngine::send_to_hash(quint32 file, Stage stage) {
+    qint64 size = store.size(file);
+    rehashing_files++;
+    pending_sizes[size]++;
+    if (options.compare_bytes) { // compared with the rest of its size after the walk
+        store.set_stage(file, Stage::Full);
+        size_buckets[size].push_back(file);
+        return;
+    }
+
+    store.set_stage(file, stage);
+    scan_stats.bytes_read += stage_bytes(size, stage);
+    emit calc_hash(file);
+}
+
+void ScanEngine::hash_done(quint32 file) {
+    rehashing_files--;
+    auto it = pending_sizes.find(store.size(file));
+    if (--it.value() == 0) {
+        pending_sizes.erase(it);
+    }
+}
+
+// once the walk is over and nothing of this size is hashed,
+// groups of the size are final
+void ScanEngine::confirm_size(qint64 size) {
+    if (!end_flag || pending_sizes.contains(size)) { return; }
+
+    auto it = unconfirmed.find(size);
+    while (it != unconfirmed.end() && it.key() == size) {
+        confirmed.push_back(it.value());
+        it = unconfirmed.erase(it);
+    }
+}
+
+qint64 ScanEngine::stage_bytes(qint64 size, Stage stage) const {
+    return stage == Stage::Partial ? qMin(size, 2 * options.block_size) : size;
+}
+
+// partial stage is not worth it when head and tail cover most of the file
+Stage ScanEngine::next_stage(quint32 file) const {
+    qint64 size = store.size(file);
+    if (size < options.partial_min_size || size <= 2 * options.block_size) {
+        return Stage::Full;
+    }
+    return Stage::Partial;
+}
+
+void ScanEngine::check_end() {
+    if (!end_flag || rehashing_files != 0) { return; }
+    if (batch_pending) {
+        next_batch();
+    } else if (!scan_finished) {
+        finish_scan();
+    } else if (watch_changed) {
+        watch_changed = false;
+        emit index_updated(total_files);
+    }
+}
+
+void ScanEngine::finish_scan() {
+    scan_finished = true;
+    if (options.group_dirs) { // the whole result at once
+        flush();
+        group_directories();
+        listener->begin_reset();
+        listener->end_reset();
+        for (auto group : groups) {
+            listener->group_confirmed(group);
+        }
+    }
+    checkpoint_timer.stop();
+    pool->save_cache(options.compact_cache);
+    if (!options.checkpoint_path.isEmpty()) {
+        write_checkpoint();
+    }
+    scan_stats.cache_hits = pool->cache_hits();
+    scan_stats.bytes_read -= pool->cache_bytes_saved();
+    if (options.compare_bytes) {
+        scan_stats.bytes_read += comparer.bytes_read();
+        scan_stats.bytes_hash_path = comparer.bytes_hash_path();
+    }
+    if (options.memory_budget > 0) { // one batch was in the store at a time
+        total_files += runs.singles();
+        scan_stats.size_unique += runs.singles();
+        scan_stats.bytes_total += runs.single_bytes();
+        scan_stats.spill_runs = runs.runs();
+        scan_stats.bytes_spilled = runs.bytes_spilled();
+        scan_stats.spill_batches = runs.batches();
+        scan_stats.records += store.count();
+        scan_stats.record_bytes = qMax(scan_stats.record_bytes, store.bytes_used());
+        runs.clear();
+    } else {
+        scan_stats.records = store.count();
+        scan_stats.record_bytes = store.bytes_used();
+    }
+    scan_stats.scan_msecs = timer.elapsed();
+    scan_stats.group_msecs = group_nsecs / 1000000;
+    if (telemetry.enabled()) {
+        telemetry_timer.stop();
+        report_telemetry();
+    }
+    if (options.watch && !options.group_dirs) { // directory groups are not kept current
+        start_watch();
+    }
+
+    emit end_scan(total_files);
+}
+
+// out of core: every file of the batch was pushed, the sizes in it are
+// complete
+void ScanEngine::end_batch() {
+    batch_pending = true;
+    no_more_files();
+}
+
+// the groups of the batch are out, they go with its files before the
+// worker pushes the next batch
+void ScanEngine::next_batch() {
+    batch_pending = false;
+    if (control.stopped()) { return; }
+    pool->wait_idle();
+    scan_stats.records += store.count();
+    scan_stats.record_bytes = qMax(scan_stats.record_bytes, store.bytes_used());
+    clear_groups();
+    store.drop_files();
+    pool->reset(); // extent owners of the batch
+    end_flag = false;
+    runs.batch_done();
+}
+
+// the walker has pushed all its files before telling this
+void ScanEngine::no_more_files() {
+    // sizes are complete only once the ring holds no walked file
+    do {
+        drain();
+    } while (!ring.empty());
+    end_flag = true;
+    if (!size_buckets.empty()) {
+        for (auto const& bucket : size_buckets) {
+            comparer.add_bucket(bucket);
+        }
+        size_buckets.clear();
+        worker->claim();
+        emit compare_buckets(pool->threads());
+    }
+    for (auto size : unconfirmed.uniqueKeys()) {
+        confirm_size(size);
+    }
+    flush();
+}
+
+void ScanEngine::report_telemetry() {
+    StageDepths depths;
+    depths.result_ring = ring.size();
+    depths.hash_queue = pool->queued();
+    depths.hash_busy = pool->busy_threads();
+    depths.compare_buckets = comparer.pending_buckets();
+    emit telemetry_update(telemetry.report(depths));
+}
+
+void ScanEngine::start_scan(QStringList const& roots) {
+    // records of the last scan go away, nobody may be using them
+    control.stop();
+    worker->stop();
+    pool->stop();
+    worker->wait_idle();
+    pool->wait_idle();
+    control.reset();
+    checkpoint_timer.stop();
+    stop_watch();
+    watch_roots = roots;
+    QVector<quint32> stale;
+    ring.pop(stale, INT_MAX);
+
+    clear_groups();
+    comparer.clear();
+    reclaimer.clear();
+    reclaiming = false;
+    chunk_index.clear();
+    analyzing = false;
+    store.clear();
+    runs.clear();
+    scan_stats = ScanStats();
+
+    total_files = 0;
+    rehashing_files = 0;
+    group_nsecs = 0;
+    end_flag = false;
+    batch_pending = false;
+    scan_finished = false;
+
+    pool->reset();
+    pool->open_cache();
+    telemetry.clear();
+    if (telemetry.enabled()) {
+        telemetry_timer.start(options.telemetry_msecs);
+    }
+    if (!options.checkpoint_path.isEmpty()) {
+        write_checkpoint();
+        checkpoint_timer.start(qMax(1, options.checkpoint_secs) * 1000);
+    }
+    timer.restart();
+    progress_timer.restart();
+    worker->restart(); // busy before the slot runs, a second start waits for it
+    emit scan_roots(roots);
+}
+
+// groups and the indexes behind them, the records stay
+void ScanEngine::clear_groups() {
+    listener->begin_reset();
+    for (int id = 1; id < group_slots.size(); id++) {
+        delete group_slots[id];
+    }
+    group_slots.resize(1);
+    group_slots[unique_group]->files.clear();
+    free_slots.clear();
+    unique_by_hash.clear();
+    unique_row.clear();
+
+    groups.clear();
+    hash_to_group.clear();
+    size_to_file.clear();
+    partial_to_file.clear();
+    inode_to_file.clear();
+    link_groups.clear();
+    link_of.clear();
+    size_buckets.clear();
+    linked_files.clear();
+    dir_group_files.clear();
+    approximate_groups.clear();
+    pending_sizes.clear();
+    unconfirmed.clear();
+    new_groups.clear();
+    appended.clear();
+    removed_unique.clear();
+    confirmed.clear();
+    listener->end_reset();
+}
+
+void ScanEngine::compare_digests(QString const& directory) {
+    worker->restart();
+    emit run_digest_comparison(directory);
+}
+
+// reads in flight end within a chunk, the scan resumes from its checkpoint
+void ScanEngine::stop_scan() {
+    control.stop();
+    telemetry_timer.stop();
+    checkpoint_timer.stop();
+    stop_watch();
+    worker->stop();
+    pool->stop();
+    pool->save_cache(false); // keep digests computed so far
+    if (!options.checkpoint_path.isEmpty() && !scan_finished) {
+        write_checkpoint();
+    }
+}
+
+void ScanEngine::fail_scan(QString const& error) {
+    stop_scan();
+    emit scan_failed(error);
+}
+
+void ScanEngine::pause_scan() {
+    control.pause();
+}
+
+void ScanEngine::resume_scan() {
+    control.resume();
+}
+
+bool ScanEngine::paused() const {
+    return control.paused();
+}
+
+// the digests go to the cache first, the checkpoint points to it
+// the sorted cache is rewritten once, at the end of the scan or when the
+// next one opens it
+void ScanEngine::save_checkpoint() {
+    pool->checkpoint_cache();
+    write_checkpoint();
+}
+
+void ScanEngine::write_checkpoint() {
+    ScanCheckpoint checkpoint;
+    checkpoint.profile.roots = watch_roots;
+    checkpoint.profile.filter = options.filter;
+    checkpoint.cache_path = options.cache_path;
+    checkpoint.digest = options.digest;
+    checkpoint.block_size = options.block_size;
+    checkpoint.partial_min_size = options.partial_min_size;
+    checkpoint.files_done = total_files;
+    checkpoint.bytes_read = scan_stats.bytes_read;
+    checkpoint.finished = scan_finished;
+    checkpoint.save(options.checkpoint_path);
+}
+
+void ScanEngine::set_hash_threads(int threads) {
+    pool->set_threads(threads);
+}
+
+// a reference decides how files are hashed, byte comparison has no digests
+void ScanEngine::set_options(ScanOptions const& options) {
+    this->options = options;
+    if (!options.checkpoint_path.isEmpty() && options.cache_path.isEmpty()) {
+        this->options.cache_path = options.checkpoint_path + ".cache";
+    }
+    reference.close();
+    if (!options.reference_path.isEmpty() && reference.open(options.reference_path)) {
+        this->options.digest = reference.digest();
+        this->options.block_size = reference.block_size();
+        this->options.partial_min_size = reference.partial_min_size();
+        this->options.compare_bytes = false;
+    }
+    if (options.memory_budget > 0) { // groups of earlier batches are gone
+        this->options.compare_bytes = false;
+        this->options.watch = false;
+        this->options.group_dirs = false;
+    }
+    worker->set_options(this->options);
+    pool->set_options(this->options);
+    comparer.set_options(this->options);
+    telemetry.set_enabled(options.telemetry_msecs > 0);
+}
+
+ScanStats const& ScanEngine::stats() const {
+    return scan_stats;
+}
+
+void ScanEngine::remove_group(int group) {
+    auto ptr = group_slots[group];
+    int row = group_row(group);
+    listener->begin_remove(-1, row, row);
+    groups.erase(groups.begin() + row);
+    listener->end_remove();
+
+    // ids stay, only the rows below move up
+    for (int i = row; i < groups.size(); i++) {
+        group_slots[groups[i]]->row = i;
+    }
+    if (ptr->kind == GroupKind::Copies || ptr->kind == GroupKind::Referenced) {
+        hash_to_group.remove(DigestKey(ptr->size, ptr->hash.constData()));
+    } else {
+        quint32 owner = link_groups.key(group, RecordStore::none);
+        if (owner != RecordStore::none) {
+            link_groups.remove(owner);
+        }
+    }
+    unconfirmed.remove(ptr->size, group);
+    delete ptr;
+    group_slots[group] = nullptr;
+    free_slots.push_back(group);
+}
+
+// a copy left alone is found again by the digest when a new copy appears
+void ScanEngine::move_to_unique(QVector<quint32> const& files) {
+    for (auto file : files) {
+        if (store.hashed(file)) {
+            unique_by_hash.insert(key(file), file);
+        }
+    }
+    auto& lists = group_slots[unique_group]->files;
+    listener->begin_insert(unique_group, lists.size(), lists.size() + files.size() - 1);
+    lists += files;
+    listener->end_insert();
+    renumber_unique(lists.size() - files.size());
+}
+
+// a deleted file leaves the group of its other names too
+void ScanEngine::drop_link(quint32 file) {
+    int group = link_groups.value(file, -1);
+    if (group >= 0) {
+        leave_link_group(group, file);
+    }
+}
+
+// the next name stands for the data once the owner is gone, a name left
+// alone goes to the unique bucket unless it is listed there already
+void ScanEngine::leave_link_group(int group, quint32 file) {
+    auto ptr = group_slots[group];
+    int row = ptr->files.indexOf(file);
+    if (row < 0) { return; }
+    listener->begin_remove(group, row, row);
+    ptr->files.remove(row);
+    listener->end_remove();
+    link_of.remove(file);
+    bool owner = link_groups.value(file, -1) == group;
+    if (owner) {
+        link_groups.remove(file);
+    }
+
+    if (ptr->files.size() > 1) {
+        if (owner) {
+            quint32 next = ptr->files.front();
+            link_groups.insert(next, group);
+            if (ptr->kind == GroupKind::Hardlinks) { // later names of the inode join here
+                inode_to_file.insert(InodeKey{store.device(next), store.inode(next)}, next);
+            }
+        }
+        listener->group_changed(group);
+        return;
+    }
+    QVector<quint32> rest;
+    for (auto name : ptr->files) {
+        if (link_of.remove(name) > 0) {
+            rest.push_back(name);
+        }
+        if (link_groups.value(name, -1) == group) {
+            link_groups.remove(name);
+        }
+    }
+    if (!ptr->files.empty()) {
+        listener->begin_remove(group, 0, ptr->files.size() - 1);
+        ptr->files.clear();
+        listener->end_remove();
+    }
+    remove_group(group);
+    if (!rest.empty()) {
+        move_to_unique(rest);
+    }
+}
+
+// other names of the same data free nothing, they are not deleted.
+// The file is compared with another one of its group before it goes.
+// Every call ends in reclaimed(), even when nothing was to be done.
+void ScanEngine::delete_file(int group, int row) {
+    if (reclaiming || analyzing) { return; }
+    flush();
+    auto ptr = group_slots[group];
+    QVector<ReclaimTask> tasks;
+    if (ptr->kind == GroupKind::Referenced) { // the copy to keep is in the reference
+        tasks.push_back({group, RecordStore::none, {ptr->files[row]}, reference.find(ptr->size, ptr->hash)});
+    } else if (ptr->kind == GroupKind::Copies) {
+        quint32 keep = RecordStore::none;
+        if (group != unique_group) {
+            keep = ptr->files[row == 0 ? 1 : 0];
+        }
+        tasks.push_back({group, keep, {ptr->files[row]}});
+    }
+    start_reclaim(tasks, ReclaimAction::Delete);
+}
+
+void ScanEngine::delete_same(int group, int row) {
+    if (reclaiming || analyzing) { return; }
+    flush();
+    auto ptr = group_slots[group];
+    QVector<ReclaimTask> tasks;
+    if (group != unique_group && ptr->kind == GroupKind::Copies) {
+        ReclaimTask task{group, ptr->files[row], ptr->files};
+        task.files.remove(row);
+        tasks.push_back(task);
+    }
+    start_reclaim(tasks, ReclaimAction::Delete);
+}
+
+// the first file of each group of copies stays, the others go. Files in
+// the reference can only be deleted.
+void ScanEngine::reclaim(QVector<int> const& groups, ReclaimAction action) {
+    if (reclaiming || analyzing) { return; }
+    flush();
+    QVector<ReclaimTask> tasks;
+    for (auto group : groups) {
+        auto ptr = group == unique_group ? nullptr : group_slots.value(group, nullptr);
+        if (ptr != nullptr && ptr->kind == GroupKind::Referenced && action == ReclaimAction::Delete) {
+            // nothing to link to here
+            tasks.push_back({group, RecordStore::none, ptr->files, reference.find(ptr->size, ptr->hash)});
+            continue;
+        }
+        if (ptr == nullptr || ptr->kind != GroupKind::Copies) { continue; }
+        tasks.push_back({group, ptr->files.front(), ptr->files.mid(1)});
+    }
+    start_reclaim(tasks, action);
+}
+
+bool ScanEngine::busy_reclaiming() const {
+    return reclaiming;
+}
+
+void ScanEngine::start_reclaim(QVector<ReclaimTask> const& tasks, ReclaimAction action) {
+    reclaimer.clear();
+    linked_files.clear();
+    reclaimer.set_action(action, options.dry_run, options.verify_delete);
+    for (auto const& task : tasks) {
+        reclaimer.add(task);
+    }
+    reclaiming = true;
+    worker->restart();
+    emit run_reclaim();
+}
+
+void ScanEngine::reclaim_progress(int done, int total, qint64 bytes) {
+    if (!reclaiming) { return; }
+    apply_reclaim();
+    emit reclaim_update(done, total, bytes);
+}
+
+void ScanEngine::reclaim_finished() {
+    if (!reclaiming) { return; }
+    apply_reclaim();
+    reclaiming = false;
+    emit reclaimed(reclaimer.files_done(), reclaimer.files_failed(), reclaimer.bytes_reclaimed(),
+                   reclaimer.dry_run());
+    if (!deferred_changes.empty()) {
+        QVector<TreeChange> changes;
+        changes.swap(deferred_changes);
+        apply_changes(changes);
+    }
+}
+
+// outcomes of a batch, group by group. A dry run leaves the tree alone.
+void ScanEngine::apply_reclaim() {
+    auto outcomes = reclaimer.take_outcomes();
+    if (reclaimer.dry_run()) { return; }
+
+    QHash<int, QVector<quint32>> done;
+    QVector<int> order;
+    for (auto const& outcome : outcomes) {
+        if (!outcome.done) { continue; }
+        if (!done.contains(outcome.group)) {
+            order.push_back(outcome.group);
+        }
+        done[outcome.group].push_back(outcome.file);
+        if (reclaimer.action() == ReclaimAction::Delete) {
+            unlist(outcome.file);
+        }
+    }
+    for (auto group : order) {
+        if (group_slots[group] == nullptr) { continue; }
+        if (reclaimer.action() == ReclaimAction::Delete) {
+            remove_files(group, done[group]);
+        } else {
+            link_files(group, done[group]);
+        }
+    }
+}
+
+// one removal per run of adjacent rows, a copy left alone becomes unique
+void ScanEngine::remove_files(int group, QVector<quint32> const& files) {
+    auto ptr = group_slots[group];
+    if (ptr->kind == GroupKind::Hardlinks || ptr->kind == GroupKind::SharedExtents) {
+        for (int i = 0; i < files.size() && group_slots[group] == ptr; i++) {
+            leave_link_group(group, files[i]);
+        }
+        return;
+    }
+    QVector<int> rows;
+    for (auto file : files) {
+        int row = ptr->files.indexOf(file);
+        if (row >= 0) {
+            rows.push_back(row);
+        }
+    }
+    if (rows.empty()) { return; }
+    std::sort(rows.begin(), rows.end());
+
+    for (int i = rows.size() - 1; i >= 0;) {
+        int last = rows[i];
+        int first = last;
+        while (i > 0 && rows[i - 1] == first - 1) {
+            first--;
+            i--;
+        }
+        i--;
+        listener->begin_remove(group, first, last);
+        ptr->files.erase(ptr->files.begin() + first, ptr->files.begin() + last + 1);
+        listener->end_remove();
+    }
+    for (auto file : files) {
+        drop_link(file);
+    }
+
+    if (group == unique_group) {
+        renumber_unique(rows.front());
+        return;
+    }
+    if (ptr->files.size() > 1 || (ptr->kind == GroupKind::Referenced && !ptr->files.empty())) {
+        listener->group_changed(group);
+        return;
+    }
+
+    QVector<quint32> rest = ptr->files;
+    if (!rest.empty()) {
+        listener->begin_remove(group, 0, rest.size() - 1);
+        ptr->files.clear();
+        listener->end_remove();
+    }
+    remove_group(group);
+    if (!rest.empty()) {
+        move_to_unique(rest);
+    }
+}
+
+// once every copy is a name or a clone of the first file, the group holds
+// links like the ones found by the scan
+void ScanEngine::link_files(int group, QVector<quint32> const& files) {
+    auto ptr = group_slots[group];
+    linked_files[group] += files.size();
+    if (linked_files[group] < ptr->files.size() - 1) { return; }
+
+    hash_to_group.remove(DigestKey(ptr->size, ptr->hash.constData()));
+    ptr->kind = reclaimer.action() == ReclaimAction::Hardlink ? GroupKind::Hardlinks : GroupKind::SharedExtents;
+    link_groups.insert(ptr->files.front(), group);
+    for (auto file : ptr->files) { // no other group lists them
+        link_of.insert(file, group);
+    }
+    linked_files.remove(group);
+    listener->group_changed(group);
+}
+
+bool ScanEngine::watching() const {
+    return watcher.active();
+}
+
+QString ScanEngine::watch_error() const {
+    return watcher.error();
+}
+
+// every directory of the scan is watched. Changes made between the walk
+// of a directory and its watch are not seen until the next scan.
+void ScanEngine::start_watch() {
+    if (options.compare_bytes) { return; }
+    quint32 dirs = store.dir_count();
+    if (!watcher.start()) {
+        scan_stats.dirs_unwatched = int(dirs);
+        return;
+    }
+    watch_filter = PathFilter(options.filter);
+    dir_ids.reserve(dirs);
+    for (quint32 dir = 0; dir < dirs; dir++) {
+        QByteArray path = store.dir_path(dir);
+        dir_ids.insert(path, dir);
+        quint32 parent = store.parent_dir(dir);
+        if (parent != RecordStore::none) {
+            dir_children[parent].push_back(dir);
+        }
+        if (!watcher.watch(path)) {
+            scan_stats.dirs_unwatched++;
+        }
+    }
+    for (quint32 file = 0; file < store.count(); file++) {
+        dir_files[store.dir_of(file)].insert(qHash(store.file_name(file)), file);
+    }
+}
+
+void ScanEngine::stop_watch() {
+    watcher.stop();
+    dir_ids.clear();
+    dir_children.clear();
+    dir_files.clear();
+    deferred_changes.clear();
+    dropped_files.clear();
+    free_files.clear();
+    watch_changed = false;
+}
+
+// the kernel lost events, nothing but a new walk can tell what changed
+void ScanEngine::rescan() {
+    start_scan(watch_roots);
+}
+
+// a batch of changes, applied while no reclaim holds group ids.
+// New and rewritten files start at the size stage like walked ones.
+void ScanEngine::apply_changes(QVector<TreeChange> const& changes) {
+    if (reclaiming || analyzing) {
+        deferred_changes += changes;
+        return;
+    }
+    flush(); // groups are searched in their published rows
+    for (auto const& change : changes) {
+        quint32 dir = dir_ids.value(change.dir, RecordStore::none);
+        if (dir == RecordStore::none) { continue; }
+        QByteArray path = RecordStore::join_path(change.dir, change.name);
+        switch (change.kind) {
+        case TreeChange::FileWritten:
+            change_file(dir, change.dir, change.name);
+            break;
+        case TreeChange::FileRemoved: {
+            quint32 file = find_file(dir, change.name);
+            if (file != RecordStore::none) {
+                forget_file(file);
+                scan_stats.files_removed++;
+            }
+            break;
+        }
+        case TreeChange::DirAdded:
+            remove_dir(path);
+            if (!watch_filter.skip_dir(change.dir, change.name.constData())) {
+                add_watched_dir(dir, path, change.name);
+            }
+            break;
+        case TreeChange::DirRemoved:
+            remove_dir(path);
+            break;
+        }
+    }
+    watch_changed = true;
+    flush();
+}
+
+// watched before it is listed, so no file created meanwhile is lost
+void ScanEngine::add_watched_dir(quint32 parent, QByteArray const& path, QByteArray const& name) {
+    quint32 dir = store.add_dir(parent, name);
+    dir_ids.insert(path, dir);
+    dir_children[parent].push_back(dir);
+    if (!watcher.watch(path)) {
+        scan_stats.dirs_unwatched++;
+    }
+
+    DIR* handle = opendir(path.constData());
+    if (handle == nullptr) { return; }
+    QVector<QByteArray> subdirs;
+    dirent* entry;
+    while ((entry = readdir(handle)) != nullptr) {
+        if (entry->d_name[0] == '.') { continue; }
+        RecordStore::FileInfo info;
+        bool directory;
+        if (!DirWalker::stat_file(dirfd(handle), entry->d_name, info, directory)) { continue; }
+        if (directory) {
+            if (!watch_filter.skip_dir(path, entry->d_name)) {
+                subdirs.push_back(entry->d_name);
+            }
+        } else if (!watch_filter.skip_file(path, entry->d_name) && !watch_filter.skip_size(info.size)) {
+            add_watched_file(dir, info);
+        }
+    }
+    closedir(handle);
+    for (auto const& subdir : subdirs) {
+        add_watched_dir(dir, RecordStore::join_path(path, subdir), subdir);
+    }
+}
+
+void ScanEngine::add_watched_file(quint32 dir, RecordStore::FileInfo const& info) {
+    quint32 file;
+    if (!free_files.empty()) { // a file rewritten over and over keeps one record
+        file = free_files.takeLast();
+        store.reuse_file(file, dir, info);
+    } else {
+        QVector<quint32> ids;
+        store.add_files(dir, {info}, ids);
+        file = ids.front();
+    }
+    dir_files[dir].insert(qHash(store.file_name(file)), file);
+    scan_stats.files_changed++;
+    add_file(file);
+}
+
+quint32 ScanEngine::find_file(quint32 dir, QByteArray const& name) const {
+    auto files = dir_files.constFind(dir);
+    if (files == dir_files.cend()) { return RecordStore::none; }
+    uint hash = qHash(name);
+    for (auto it = files->constFind(hash); it != files->cend() && it.key() == hash; ++it) {
+        if (store.file_name(it.value()) == name) {
+            return it.value();
+        }
+    }
+    return RecordStore::none;
+}
+
+// a file closed after writing keeps its place if size and time did not move
+void ScanEngine::change_file(quint32 dir, QByteArray const& parent, QByteArray const& name) {
+    QByteArray path = RecordStore::join_path(parent, name);
+    RecordStore::FileInfo info;
+    bool directory = false;
+    bool exists = DirWalker::stat_file(AT_FDCWD, path.constData(), info, directory) && !directory
+            && !watch_filter.skip_file(parent, name.constData()) && !watch_filter.skip_size(info.size);
+    quint32 file = find_file(dir, name);
+    if (file != RecordStore::none) {
+        if (exists && info.size == store.size(file) && info.mtime == store.mtime(file)
+                && info.inode == store.inode(file)) {
+            return;
+        }
+        forget_file(file);
+    }
+    if (exists) {
+        info.name = name;
+        add_watched_file(dir, info);
+    }
+}
+
+// the directory and everything under it, through the child lists
+void ScanEngine::remove_dir(QByteArray const& path) {
+    auto found = dir_ids.find(path);
+    if (found == dir_ids.end()) { return; }
+    quint32 top = found.value();
+    dir_ids.erase(found);
+    auto siblings = dir_children.find(store.parent_dir(top));
+    if (siblings != dir_children.end()) {
+        siblings->removeOne(top);
+    }
+    QVector<quint32> dirs{top};
+    for (int i = 0; i < dirs.size(); i++) {
+        quint32 dir = dirs[i];
+        dirs += dir_children.take(dir);
+        if (i > 0) {
+            dir_ids.remove(store.dir_path(dir));
+        }
+        for (auto file : dir_files.take(dir)) {
+            forget_file(file);
+            scan_stats.files_removed++;
+        }
+    }
+    watcher.unwatch(path);
+}
+
+// takes a file out of its group and of every index that points to it.
+// Its record is reused once no hash thread holds it.
+void ScanEngine::forget_file(quint32 file) {
+    unlist(file);
+    qint64 size = store.size(file);
+    if (size_to_file.value(size, RecordStore::none) == file) {
+        size_to_file.remove(size);
+    }
+    DigestKey hash = key(file);
+    if (store.stage(file) == Stage::Partial && partial_to_file.value(hash, RecordStore::none) == file) {
+        partial_to_file.remove(hash);
+    }
+    if (store.hashed(file) && unique_by_hash.value(hash, RecordStore::none) == file) {
+        unique_by_hash.remove(hash);
+    }
+    if (store.linked(file)) {
+        InodeKey inode{store.device(file), store.inode(file)};
+        if (inode_to_file.value(inode, RecordStore::none) == file) {
+            inode_to_file.remove(inode);
+        }
+    }
+
+    int group = group_containing(file);
+    if (group < 0) { // being hashed
+        dropped_files.insert(file);
+        drop_link(file);
+        return;
+    }
+    total_files--;
+    remove_files(group, {file});
+    recycle(file);
+}
+
+// owners of shared extents stand for the content of the files on them
+void ScanEngine::recycle(quint32 file) {
+    if (!pool->owns_shared_extents(file)) {
+        free_files.push_back(file);
+    }
+}
+
+void ScanEngine::unlist(quint32 file) {
+    auto files = dir_files.find(store.dir_of(file));
+    if (files != dir_files.end()) {
+        files->remove(qHash(store.file_name(file)), file);
+    }
+}
+
+// names listed in a link group only are found by their group, most other
+// files by the unique row or the digest
+int ScanEngine::group_containing(quint32 file) const {
+    int linked = link_of.value(file, -1);
+    if (linked >= 0) {
+        return linked;
+    }
+    auto const& unique = group_slots[unique_group]->files;
+    int row = file < quint32(unique_row.size()) ? unique_row[file] : -1;
+    if (row >= 0 && row < unique.size() && unique[row] == file) {
+        return unique_group;
+    }
+    if (store.hashed(file)) {
+        int group = hash_to_group.value(key(file), -1);
+        if (group >= 0 && group_slots[group]->files.contains(file)) {
+            return group;
+        }
+    }
+    return -1;
+}
+
+// hard links and files on shared extents carry the digests of the file
+// that was read for them
+bool ScanEngine::export_snapshot(QString const& path, QString const& shard) const {
+    if (!scan_finished || options.memory_budget > 0) { return false; } // out of core, the records are gone
+    if (options.compare_bytes) { return false; } // groups have ids, not digests another shard could match
+
+    QVector<quint32> files;
+    if (watching()) { // rewritten files left records behind
+        for (auto const& listed : dir_files) {
+            for (auto file : listed) {
+                files.push_back(file);
+            }
+        }
+    } else {
+        files.reserve(store.count());
+        for (quint32 file = 0; file < store.count(); file++) {
+            files.push_back(file);
+        }
+    }
+
+    QVector<SnapshotRecord> records;
+    records.reserve(files.size());
+    QByteArray names;
+    for (auto file : files) {
+        quint32 source = file;
+        if (store.shared(file)) {
+            source = store.shared_with(file);
+        } else if (store.linked(file)) {
+            source = inode_to_file.value(InodeKey{store.device(file), store.inode(file)}, file);
+        }
+
+        SnapshotRecord record;
+        memset(&record, 0, sizeof(record));
+        record.size = store.size(file);
+        record.path = names.size();
+        names += store.native_path(file);
+        names += '\0';
+        QByteArray digest = store.digest(source);
+        if (source != file) {
+            record.flags = store.shared(file) ? SnapshotRecord::Shared : SnapshotRecord::Linked;
+        }
+        if (store.unreadable(source)) {
+            record.flags |= SnapshotRecord::Unreadable;
+        } else if (store.hashed(source)) {
+            record.flags |= SnapshotRecord::HasFull;
+            memcpy(record.full, digest.constData(), Digest::width);
+        } else if (store.stage(source) == Stage::Partial) {
+            record.flags |= SnapshotRecord::HasPartial;
+            memcpy(record.partial, digest.constData(), Digest::width);
+        }
+        records.push_back(record);
+    }
+    return Snapshot::write(path, shard, options.digest, options.block_size, options.partial_min_size, records, names);
+}
+
+QString ScanEngine::reference_path(int group) const {
+    auto ptr = group_slots.value(group, nullptr);
+    if (ptr == nullptr || ptr->kind != GroupKind::Referenced) { return QString(); }
+    return QFile::decodeName(reference.find(ptr->size, ptr->hash));
+}
+
+bool ScanEngine::has_reference() const {
+    return reference.is_open();
+}
+
+// a file of each content is enough, copies would only count as savable
+// what the groups already show
+void ScanEngine::analyze_chunks() {
+    if (!scan_finished || reclaiming || analyzing) { return; }
+    flush();
+    QVector<quint32> files;
+    for (auto group : groups) {
+        auto const& files_of = group_slots[group]->files;
+        if (!files_of.empty() && store.size(files_of.front()) >= options.chunk_min_file) {
+            files.push_back(files_of.front());
+        }
+    }
+    for (auto file : group_slots[unique_group]->files) {
+        if (!store.unreadable(file) && store.size(file) >= options.chunk_min_file) {
+            files.push_back(file);
+        }
+    }
+    chunk_index.set_options(options);
+    chunk_index.set_files(files);
+    analyzing = true;
+    worker->restart();
+    emit run_chunks();
+}
+
+bool ScanEngine::busy_analyzing() const {
+    return analyzing;
+}
+
+ChunkReport ScanEngine::chunk_report(int pairs) const {
+    return chunk_index.report(pairs);
+}
+
+void ScanEngine::chunk_progress(int done, int total, qint64 bytes) {
+    if (!analyzing) { return; }
+    emit chunks_update(done, total, bytes);
+}
+
+void ScanEngine::chunks_finished() {
+    if (!analyzing) { return; }
+    analyzing = false;
+    emit chunks_analyzed();
+    if (!deferred_changes.empty()) {
+        QVector<TreeChange> changes;
+        changes.swap(deferred_changes);
+        apply_changes(changes);
+    }
+}
+
+// a directory is a copy of another when the names, sizes and contents
+// below it are the same. Digests go bottom-up, children have higher ids
+// than their parent. A directory's digest is the sum of the digests of
+// its entries, so the order they were walked in does not matter. A file
+// in no group of copies makes its directory and those above it distinct.
+// Names the walk left out count too, but their content was never read,
+// so groups with any of them below are only approximate.
+// Groups of directories below a copied directory are left out, and so are
+// groups of files that are all below one.
+void ScanEngine::group_directories() {
+    struct DirSum {
+        quint64 lanes[4];
+        qint64 bytes;
+        int files;
+        bool distinct;
+        bool approximate;
+    };
+    int dirs = int(store.dir_count());
+    QVector<DirSum> sums(dirs, DirSum{{0, 0, 0, 0}, 0, 0, false, false});
+    QScopedPointer<Digest> digest(Digest::create(DigestType::XxHash64x4));
+    auto add_entry = [&digest](DirSum& sum, char kind, QByteArray const& name, char const* content, int length) {
+        digest->reset();
+        digest->add_data(&kind, 1);
+        digest->add_data(name.constData(), name.size() + 1); // with its terminator
+        digest->add_data(content, length);
+        QByteArray result = digest->result();
+        quint64 words[4];
+        memcpy(words, result.constData(), sizeof(words));
+        for (int i = 0; i < 4; i++) {
+            sum.lanes[i] += words[i];
+        }
+    };
+
+    // the group stands for the content, it is the same for equal files
+    for (auto group : groups) {
+        auto ptr = group_slots[group];
+        for (auto file : ptr->files) {
+            auto& sum = sums[int(store.dir_of(file))];
+            if (ptr->kind != GroupKind::Copies) {
+                sum.distinct = true;
+                continue;
+            }
+            char content[sizeof(qint64) + sizeof(int)];
+            memcpy(content, &ptr->size, sizeof(qint64));
+            memcpy(content + sizeof(qint64), &group, sizeof(int));
+            add_entry(sum, 'f', store.file_name(file), content, sizeof(content));
+            sum.bytes += ptr->size;
+            sum.files++;
+        }
+    }
+    for (auto file : group_slots[unique_group]->files) {
+        sums[int(store.dir_of(file))].distinct = true;
+    }
+    for (int dir = 0; dir < dirs; dir++) {
+        quint64 left_out = store.left_out(quint32(dir));
+        if (left_out != 0) {
+            add_entry(sums[dir], 'x', QByteArray(), reinterpret_cast<char const*>(&left_out), sizeof(left_out));
+            sums[dir].approximate = true;
+        }
+    }
+
+    QVector<QByteArray> digests(dirs);
+    for (int dir = dirs - 1; dir >= 0; dir--) {
+        auto const& sum = sums[dir];
+        digest->reset();
+        digest->add_data(reinterpret_cast<char const*>(sum.lanes), sizeof(sum.lanes));
+        digest->add_data(reinterpret_cast<char const*>(&sum.bytes), sizeof(sum.bytes));
+        digest->add_data(reinterpret_cast<char const*>(&sum.files), sizeof(sum.files));
+        digests[dir] = digest->result();
+
+        quint32 parent = store.parent_dir(quint32(dir));
+        if (parent == RecordStore::none) { continue; }
+        auto& up = sums[int(parent)];
+        up.bytes += sum.bytes;
+        up.files += sum.files;
+        up.distinct = up.distinct || sum.distinct;
+        up.approximate = up.approximate || sum.approximate;
+        add_entry(up, 'd', store.leaf_name(quint32(dir)), digests[dir].constData(), digests[dir].size());
+    }
+
+    QHash<QByteArray, QVector<quint32>> copies;
+    for (int dir = 0; dir < dirs; dir++) {
+        if (!sums[dir].distinct && sums[dir].files > 0) {
+            copies[digests[dir]].push_back(quint32(dir));
+        }
+    }
+    QVector<bool> copied(dirs, false);
+    for (auto const& members : copies) {
+        if (members.size() < 2) { continue; }
+        for (auto dir : members) {
+            copied[int(dir)] = true;
+        }
+    }
+    // in or below a copied directory
+    QVector<bool> covered(dirs, false);
+    for (int dir = 0; dir < dirs; dir++) {
+        quint32 parent = store.parent_dir(quint32(dir));
+        covered[dir] = copied[dir] || (parent != RecordStore::none && covered[int(parent)]);
+    }
+
+    QVector<int> kept;
+    for (auto it = copies.begin(); it != copies.end(); ++it) {
+        auto const& members = it.value();
+        if (members.size() < 2) { continue; }
+        bool outermost = false;
+        for (auto dir : members) {
+            quint32 parent = store.parent_dir(dir);
+            outermost = outermost || parent == RecordStore::none || !covered[int(parent)];
+        }
+        if (!outermost) { continue; }
+        auto const& sum = sums[int(members.front())];
+        int id = add_slot(new Group{members, sum.bytes, it.key(), 0, GroupKind::Directories});
+        dir_group_files.insert(id, sum.files);
+        for (auto dir : members) {
+            if (sums[int(dir)].approximate) {
+                approximate_groups.insert(id);
+            }
+        }
+        kept.push_back(id);
+        scan_stats.dir_groups++;
+        scan_stats.dirs_duplicated += members.size();
+    }
+    for (auto group : groups) {
+        auto ptr = group_slots[group];
+        bool hidden = ptr->kind == GroupKind::Copies;
+        for (int i = 0; hidden && i < ptr->files.size(); i++) {
+            hidden = covered[int(store.dir_of(ptr->files[i]))];
+        }
+        if (!hidden) {
+            kept.push_back(group);
+            continue;
+        }
+        if (ptr->hash.size() == Digest::width) {
+            hash_to_group.remove(DigestKey(ptr->size, ptr->hash.constData()));
+        }
+        unconfirmed.remove(ptr->size, group);
+        delete ptr;
+        group_slots[group] = nullptr;
+        free_slots.push_back(group);
+        scan_stats.groups_collapsed++;
+    }
+    groups.swap(kept);
+    for (int row = 0; row < groups.size(); row++) {
+        group_slots[groups[row]]->row = row;
+    }
+}
@@ -0,0 +1,309 @@
+#ifndef SCANENGINE_H
+#define SCANENGINE_H
+
+#include "hashworker.h"
+#include "hashpool.h"
+#include "scanoptions.h"
+#include "recordstore.h"
+#include "resultring.h"
+#include "flatindex.h"
+#include "bytecomparer.h"
+#include "telemetry.h"
+#include "reclaimer.h"
+#include "treewatcher.h"
+#include "pathfilter.h"
+#include "snapshot.h"
+#include "referenceindex.h"
+#include "chunkindex.h"
+#include "scancontrol.h"
+#include "sizeruns.h"
+
+#include <QObject>
+#include <QByteArray>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMultiHash>
+#include <QSet>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QTimer>
+
+// copies take space of their own, hard links and files on shared extents
+// are names of the same data and free nothing when deleted
+enum class GroupKind {
+    Copies,
+    Hardlinks,
+    SharedExtents,
+    // directories with the same names, sizes and contents below them,
+    // the group holds directory ids
+    Directories,
+    // files whose content is in the reference index, all of them can go
+    Referenced
+};
+
+// files with the same content, or the unique files bucket
+struct Group {
+    QVector<quint32> files;
+    qint64 size;
+    QByteArray hash;
+    int row;
+    GroupKind kind;
+};
+
+// gets told about every change of the result tree. The top level holds
+// the groups followed by the unique files bucket, parent is -1 for it.
+// Changes arrive once per batch of results, one insert per affected group.
+class EngineListener {
+public:
+    virtual ~EngineListener() {}
+
+    virtual void begin_insert(int parent, int first, int last) {}
+    virtual void end_insert() {}
+    virtual void begin_remove(int parent, int first, int last) {}
+    virtual void end_remove() {}
+    virtual void begin_reset() {}
+    virtual void end_reset() {}
+    virtual void group_changed(int group) {}
+    // no more files can join the group during this scan
+    virtual void group_confirmed(int group) {}
+};
+
+// size, partial and full hash stages of a scan, grouping of the results
+// and deletion of duplicates. Groups are known by ids that do not change
+// when other groups come and go, files by their RecordStore ids.
+class ScanEngine : public QObject {
+    Q_OBJECT
+public:
+    static const int unique_group = 0;
+
+    ScanEngine();
+    ~ScanEngine() override;
+
+    void set_listener(EngineListener* listener);
+    void set_options(ScanOptions const& options);
+    void set_hash_threads(int threads);
+
+    // rows of the top level, the last one is the unique files bucket
+    int group_count() const;
+    int group_at(int row) const;
+    int group_row(int group) const;
+    Group const& group(int group) const;
+
+    RecordStore const& records() const;
+    QString file_path(quint32 file) const;
+    // a file, or a directory in a Directories group
+    QString member_path(int group, quint32 member) const;
+    // files below each directory of a Directories group
+    int directory_files(int group) const;
+    // a Directories group with entries below it the walk left out, hidden,
+    // filtered or not regular; their names match, their content may not
+    bool approximate(int group) const;
+    ScanStats const& stats() const;
+
+    // deletion and the other reclaim actions run on the worker thread,
+    // the tree changes as batches of files are done. One at a time.
+    // file -- if only one file remains in its group, it becomes unique
+    void delete_file(int group, int row);
+    // deletes files of the group except this one and makes it unique
+    void delete_same(int group, int row);
+    // keeps the first file of each group of copies, the rest get the action
+    void reclaim(QVector<int> const& groups, ReclaimAction action);
+    bool busy_reclaiming() const;
+    bool paused() const;
+    // with options.watch the tree is followed once the scan is over
+    bool watching() const;
+    // why directories are not watched, empty if all are
+    QString watch_error() const;
+    // the digests each file got, for merging with snapshots of other shards.
+    // Only once the scan is over.
+    bool export_snapshot(QString const& path, QString const& shard) const;
+    // a path in the reference with the content of a Referenced group
+    QString reference_path(int group) const;
+    bool has_reference() const;
+    // chunks the files of the finished scan, one file of each group of
+    // copies and every unique one, to find near duplicates
+    void analyze_chunks();
+    bool busy_analyzing() const;
+    ChunkReport chunk_report(int pairs) const;
+
+public slots:
+    // roots inside other roots are walked once
+    void start_scan(QStringList const& roots);
+    void stop_scan();
+    // threads hold where they are, inside a file too, until resumed
+    void pause_scan();
+    void resume_scan();
+    void compare_digests(QString const& directory);
+
+    void drain();
+    void walk_finished(qint64 entries, qint64 pruned, qint64 bytes_pruned, qint64 msecs);
+    void no_more_files();
+    void end_batch();
+    void fail_scan(QString const& error);
+    void report_telemetry();
+    void reclaim_progress(int done, int total, qint64 bytes);
+    void reclaim_finished();
+    void chunk_progress(int done, int total, qint64 bytes);
+    void chunks_finished();
+    void apply_changes(QVector<TreeChange> const& changes);
+    void rescan();
+    void save_checkpoint();
+
+signals:
+    void scan_roots(QStringList const& roots);
+    void end_scan(int files_scanned);
+    void progress_update(int files_scanned);
+    void calc_hash(quint32 file);
+    void compare_buckets(int threads);
+    void run_digest_comparison(QString const& directory);
+    void digests_compared(QString const& report);
+    // stage counters, every options.telemetry_msecs and once at the end
+    void telemetry_update(QJsonObject const& report);
+    void run_reclaim();
+    void reclaim_update(int done, int total, qint64 bytes);
+    // files done and failed, and the bytes freed, or that would be in a dry run
+    void reclaimed(int files, int failed, qint64 bytes, bool dry_run);
+    void run_chunks();
+    void chunks_update(int done, int total, qint64 bytes);
+    void chunks_analyzed();
+    // watch mode applied a batch of changes and hashed what they needed
+    void index_updated(int files);
+    // the scan could not go on, it is stopped
+    void scan_failed(QString const& error);
+
+private:
+    RecordStore store;
+    QVector<Group*> group_slots;
+    QVector<int> free_slots;
+    QVector<int> groups;
+    // full digest to group, and first file of every size and head/tail
+    // digest, none once the bucket got a second file
+    FlatIndex<DigestKey, int> hash_to_group;
+    FlatIndex<qint64, quint32> size_to_file;
+    FlatIndex<DigestKey, quint32> partial_to_file;
+    // first path of every inode with several names, and the link group
+    // of each first path
+    FlatIndex<InodeKey, quint32> inode_to_file;
+    QHash<quint32, int> link_groups;
+    // link group of every name listed there only, the name a link group
+    // was made for is also in the unique bucket or a group of copies
+    QHash<quint32, int> link_of;
+    // colliding sizes wait here for the byte comparison
+    QHash<qint64, QVector<quint32>> size_buckets;
+    ByteComparer comparer;
+    ReferenceIndex reference;
+    Reclaimer reclaimer;
+    // copies linked so far in each group of the running reclaim
+    QHash<int, int> linked_files;
+    bool reclaiming;
+    ChunkIndex chunk_index;
+    bool analyzing;
+    // out of core: the walked files on disk, and whether the worker waits
+    // for the groups of its batch
+    SizeRuns runs;
+    bool batch_pending;
+    QThread thread;
+    HashWorker* worker;
+    HashPool* pool;
+    ResultRing ring;
+    EngineListener* listener;
+    EngineListener no_listener;
+    Telemetry telemetry;
+    QTimer telemetry_timer;
+    ScanControl control;
+    QTimer checkpoint_timer;
+
+    // watch mode: the scanned roots, directories by path, the watched
+    // directories under each one and the files of each directory by the
+    // hash of their name, changes that wait for a reclaim to end.
+    // New entries pass the filter of the scan.
+    TreeWatcher watcher;
+    QStringList watch_roots;
+    PathFilter watch_filter;
+    QHash<QByteArray, quint32> dir_ids;
+    QHash<quint32, QVector<quint32>> dir_children;
+    QHash<quint32, QMultiHash<uint, quint32>> dir_files;
+    QHash<int, int> dir_group_files;
+    QSet<int> approximate_groups;
+    QVector<TreeChange> deferred_changes;
+    // files that changed while they were hashed, their results are dropped,
+    // and records of forgotten files the next new files take
+    QSet<quint32> dropped_files;
+    QVector<quint32> free_files;
+    bool watch_changed;
+
+    // fully hashed unique files, and the row of every file in the unique bucket
+    FlatIndex<DigestKey, quint32> unique_by_hash;
+    QVector<int> unique_row;
+
+    // files of each size still being hashed, groups that may still grow
+    QHash<qint64, int> pending_sizes;
+    QMultiHash<qint64, int> unconfirmed;
+
+    // changes of the current batch, published to the listener by flush()
+    QVector<int> new_groups;
+    QHash<int, QVector<quint32>> appended;
+    QVector<int> removed_unique;
+    QVector<int> confirmed;
+
+    int total_files;
+    int rehashing_files;
+    bool end_flag;
+    bool scan_finished;
+
+    ScanOptions options;
+    ScanStats scan_stats;
+
+    DigestKey key(quint32 file) const;
+    void add_file(quint32 file);
+    void query_file(quint32 file);
+    void flush();
+    bool published(int group) const;
+    int new_group(qint64 size, QByteArray const& hash, GroupKind kind);
+    int add_slot(Group* group);
+    bool holding() const;
+    void write_checkpoint();
+    void group_directories();
+    void add_link(quint32 owner, quint32 file, GroupKind kind);
+    void drop_link(quint32 file);
+    void leave_link_group(int group, quint32 file);
+    qint64 stage_bytes(qint64 size, Stage stage) const;
+    void leave_unique(quint32 file);
+    void renumber_unique(int first);
+    void add_to_group(quint32 file, int group);
+    void add_unique(quint32 file);
+    void promote(quint32 file, quint32 first, Stage stage);
+    void send_to_hash(quint32 file, Stage stage);
+    void hash_done(quint32 file);
+    void confirm_size(qint64 size);
+    Stage next_stage(quint32 file) const;
+    void check_end();
+    void next_batch();
+    void clear_groups();
+    void finish_scan();
+    void remove_group(int group);
+    void move_to_unique(QVector<quint32> const& files);
+    void start_reclaim(QVector<ReclaimTask> const& tasks, ReclaimAction action);
+    void apply_reclaim();
+    void remove_files(int group, QVector<quint32> const& files);
+    void link_files(int group, QVector<quint32> const& files);
+    void start_watch();
+    void stop_watch();
+    void add_watched_dir(quint32 parent, QByteArray const& path, QByteArray const& name);
+    void add_watched_file(quint32 dir, RecordStore::FileInfo const& info);
+    quint32 find_file(quint32 dir, QByteArray const& name) const;
+    void change_file(quint32 dir, QByteArray const& parent, QByteArray const& name);
+    void remove_dir(QByteArray const& path);
+    void forget_file(quint32 file);
+    void recycle(quint32 file);
+    void unlist(quint32 file);
+    int group_containing(quint32 file) const;
+
+    QElapsedTimer timer;
+    QElapsedTimer progress_timer;
+    qint64 group_nsecs;
+};
+
+#endif // SCANENGINE_H
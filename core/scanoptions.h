@@ -0,0 +1,132 @@
+#ifndef SCANOPTIONS_H
+#define SCANOPTIONS_H
+
+#include "digest.h"
+#include "filereader.h"
+
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QtGlobal>
+
+// what the walker leaves out, checked before a file is stat'ed where it can.
+// Globs without a slash match names, the others whole paths.
+struct ScanFilter {
+    QStringList exclude;
+    // file name globs and extensions without the dot, empty takes all
+    QStringList include;
+    QStringList extensions;
+    // empty files free nothing, 0 for max_size is no limit
+    qint64 min_size = 1;
+    qint64 max_size = 0;
+    // directories on other file systems than their root are not entered
+    bool one_file_system = false;
+};
+
+struct ScanOptions {
+    // threads walking the tree, each takes one directory at a time
+    int walk_threads = QThread::idealThreadCount();
+    // size of the head and tail blocks hashed by the partial stage
+    qint64 block_size = 4096;
+    // smaller files skip the partial stage and are hashed fully at once
+    qint64 partial_min_size = 64 * 1024;
+    DigestType digest = DigestType::Sha3_512;
+    // io_uring keeps one file in flight per thread, it gains on large files only
+    ReadStrategy read_strategy = ReadStrategy::Buffered;
+    // files read at once from one rotational disk and from one other
+    // device, 0 lets every hashing thread read from it
+    int rotational_reads = 1;
+    int solid_reads = 0;
+    // evict pages behind the reader, so a scan leaves the page cache to others
+    bool drop_cache = false;
+    // files whose extents are all shared with an earlier file are not read
+    bool shared_extents = true;
+    // size buckets are compared byte by byte after the walk instead of hashed
+    bool compare_bytes = false;
+    // compare contents byte by byte before a copy is deleted or replaced
+    bool verify_delete = true;
+    // reclaim actions only count what they would free
+    bool dry_run = false;
+    // digests of previous scans, empty path disables the cache
+    QString cache_path;
+    // drop cached files that were not seen by the scan
+    bool compact_cache = false;
+    // interval of stage telemetry reports, 0 turns telemetry off
+    int telemetry_msecs = 0;
+    ScanFilter filter;
+    // index of a reference tree: only files that may exist in it are read,
+    // the groups are the ones found there. Digest and blocks come from it.
+    QString reference_path;
+    // after the scan, follow changes of the tree and keep the groups current
+    bool watch = false;
+    // where the scan keeps a checkpoint to resume from, written every
+    // checkpoint_secs and when it is stopped. Digests go to cache_path, or
+    // next to the checkpoint without one.
+    QString checkpoint_path;
+    int checkpoint_secs = 60;
+    // out of core: walked files are spilled to runs sorted by size under
+    // spill_path, the temp directory when empty, and grouped one batch of
+    // sizes at a time within about this many bytes. Only directories stay
+    // in memory for the whole scan. 0 keeps every file in memory.
+    qint64 memory_budget = 0;
+    QString spill_path;
+    // identical directories become one group and the groups of files below
+    // them are dropped. Nothing is shown before the scan is over.
+    bool group_dirs = false;
+    // chunk analysis: average chunk size, smallest file chunked and the
+    // memory the chunk index may take before it samples fewer chunks
+    qint64 chunk_size = 64 * 1024;
+    qint64 chunk_min_file = 1024 * 1024;
+    qint64 chunk_memory = 256 * 1024 * 1024;
+};
+
+// how many files each stage removed from the candidates
+struct ScanStats {
+    int size_unique = 0;
+    int partial_unique = 0;
+    int full_hashed = 0;
+    int cache_hits = 0;
+    qint64 entries_walked = 0;
+    // entries the filter left out, a directory counts once for its subtree,
+    // and the bytes of files left out by their size
+    qint64 entries_pruned = 0;
+    qint64 bytes_pruned = 0;
+    qint64 walk_msecs = 0;
+    qint64 bytes_total = 0;
+    qint64 bytes_read = 0;
+    // walked files and the memory their records take
+    qint64 records = 0;
+    qint64 record_bytes = 0;
+    // paths of inodes seen before, files on the extents of another file,
+    // and the bytes they hold that deleting would not free
+    int hardlinks = 0;
+    int shared_extents = 0;
+    qint64 bytes_linked = 0;
+    // in byte comparison mode, the least hashing would have read instead
+    qint64 bytes_hash_path = 0;
+    // whole scan, and the part of it the engine spent grouping results
+    qint64 scan_msecs = 0;
+    qint64 group_msecs = 0;
+    // files found in the reference index and the bytes they hold
+    int referenced = 0;
+    qint64 bytes_referenced = 0;
+    // directory groups, the directories in them and the groups of files
+    // they made redundant
+    int dir_groups = 0;
+    int dirs_duplicated = 0;
+    int groups_collapsed = 0;
+    // out of core: runs written during the walk, bytes written to runs in
+    // all, and the batches grouped
+    int spill_runs = 0;
+    qint64 bytes_spilled = 0;
+    int spill_batches = 0;
+    // changes of the tree applied in watch mode, and directories whose
+    // changes are not seen, ScanEngine::watch_error() says why
+    int files_changed = 0;
+    int files_removed = 0;
+    int dirs_unwatched = 0;
+
+    qint64 bytes_skipped() const { return bytes_total - bytes_read; }
+};
+
+#endif // SCANOPTIONS_H
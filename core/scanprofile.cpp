@@ -0,0 +1,103 @@
+#include "scanprofile.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+namespace {
+
+QJsonArray to_array(QStringList const& list) {
+    return QJsonArray::fromStringList(list);
+}
+
+QStringList to_list(QJsonValue const& value) {
+    QStringList list;
+    for (auto const& item : value.toArray()) {
+        list.push_back(item.toString());
+    }
+    return list;
+}
+
+}
+
+QJsonObject ScanProfile::to_json() const {
+    QJsonObject json;
+    json["roots"] = to_array(roots);
+    json["exclude"] = to_array(filter.exclude);
+    json["include"] = to_array(filter.include);
+    json["extensions"] = to_array(filter.extensions);
+    json["min_size"] = double(filter.min_size);
+    json["max_size"] = double(filter.max_size);
+    json["one_file_system"] = filter.one_file_system;
+    return json;
+}
+
+ScanProfile ScanProfile::from_json(QJsonObject const& json) {
+    ScanProfile profile;
+    profile.roots = to_list(json["roots"]);
+    profile.filter.exclude = to_list(json["exclude"]);
+    profile.filter.include = to_list(json["include"]);
+    profile.filter.extensions = to_list(json["extensions"]);
+    profile.filter.min_size = qint64(json["min_size"].toDouble(profile.filter.min_size));
+    profile.filter.max_size = qint64(json["max_size"].toDouble(profile.filter.max_size));
+    profile.filter.one_file_system = json["one_file_system"].toBool(profile.filter.one_file_system);
+    return profile;
+}
+
+bool ScanProfile::load(QString const& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) { return false; }
+    auto document = QJsonDocument::fromJson(file.readAll());
+    if (!document.isObject()) { return false; }
+    *this = from_json(document.object());
+    return true;
+}
+
+bool ScanProfile::save(QString const& path) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) { return false; }
+    return file.write(QJsonDocument(to_json()).toJson()) >= 0;
+}
+
+QJsonObject ScanCheckpoint::to_json() const {
+    QJsonObject json;
+    json["profile"] = profile.to_json();
+    json["cache"] = cache_path;
+    json["digest"] = Digest::key(digest);
+    json["block_size"] = double(block_size);
+    json["partial_min_size"] = double(partial_min_size);
+    json["files_done"] = files_done;
+    json["bytes_read"] = double(bytes_read);
+    json["finished"] = finished;
+    return json;
+}
+
+ScanCheckpoint ScanCheckpoint::from_json(QJsonObject const& json) {
+    ScanCheckpoint checkpoint;
+    checkpoint.profile = ScanProfile::from_json(json["profile"].toObject());
+    checkpoint.cache_path = json["cache"].toString();
+    Digest::parse(json["digest"].toString(), checkpoint.digest);
+    checkpoint.block_size = qint64(json["block_size"].toDouble());
+    checkpoint.partial_min_size = qint64(json["partial_min_size"].toDouble());
+    checkpoint.files_done = json["files_done"].toInt();
+    checkpoint.bytes_read = qint64(json["bytes_read"].toDouble());
+    checkpoint.finished = json["finished"].toBool();
+    return checkpoint;
+}
+
+bool ScanCheckpoint::load(QString const& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) { return false; }
+    auto document = QJsonDocument::fromJson(file.readAll());
+    if (!document.isObject()) { return false; }
+    *this = from_json(document.object());
+    return !cache_path.isEmpty() && block_size > 0;
+}
+
+bool ScanCheckpoint::save(QString const& path) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) { return false; }
+    file.write(QJsonDocument(to_json()).toJson());
+    return file.commit();
+}
@@ -0,0 +1,48 @@
+#ifndef SCANPROFILE_H
+#define SCANPROFILE_H
+
+#include "scanoptions.h"
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+// roots and filter of a scan, kept as a JSON file:
+// {"roots": [...], "exclude": [...], "include": [...], "extensions": [...],
+//  "min_size": 1, "max_size": 0, "one_file_system": false}
+struct ScanProfile {
+    QStringList roots;
+    ScanFilter filter;
+
+    QJsonObject to_json() const;
+    // keys that are missing keep their defaults
+    static ScanProfile from_json(QJsonObject const& json);
+
+    bool load(QString const& path);
+    bool save(QString const& path) const;
+};
+
+// what a later run needs to resume an interrupted scan: the profile, how
+// files were hashed, and the hash cache that holds the digests done so
+// far. The walk is redone on resume, it only stats; files whose digests
+// are in the cache are not read again.
+struct ScanCheckpoint {
+    ScanProfile profile;
+    QString cache_path;
+    DigestType digest = DigestType::Sha3_512;
+    qint64 block_size = 0;
+    qint64 partial_min_size = 0;
+    // progress when it was written
+    int files_done = 0;
+    qint64 bytes_read = 0;
+    bool finished = false;
+
+    QJsonObject to_json() const;
+    static ScanCheckpoint from_json(QJsonObject const& json);
+
+    bool load(QString const& path);
+    // replaces the file atomically, a crash leaves the last checkpoint
+    bool save(QString const& path) const;
+};
+
+#endif // SCANPROFILE_H
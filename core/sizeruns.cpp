@@ -0,0 +1,325 @@
+#include "sizeruns.h"
+
+#include <QDir>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// runs are written in blocks of this size
+const int write_block = 1 << 20;
+// a name costs its header and allocation besides its bytes
+const qint64 name_overhead = 32;
+const qint64 least_memory = 16 * 1024 * 1024;
+// how often a wait for the engine looks at the stop flag
+const int poll_msecs = 100;
+
+}
+
+SizeRuns::SizeRuns() : directory(), run_memory(0), batch_memory(0), lock(), buffer(), buffer_bytes(0), run_files(),
+    run_count(0), next_run(0), spilled(0), readers(), heap(), head(), has_head(false), fed(), error_message(),
+    batch_count(0), single_count(0), single_byte_count(0) {}
+
+SizeRuns::~SizeRuns() {
+    clear();
+}
+
+bool SizeRuns::open(QString const& dir, qint64 memory) {
+    clear();
+    QString base = dir.isEmpty() ? QDir::tempPath() : dir;
+    QDir().mkpath(base);
+    directory.reset(new QTemporaryDir(base + "/finddups-runs-XXXXXX"));
+    if (!directory->isValid()) {
+        directory.reset();
+        fail("cannot create a run directory in " + base);
+        return false;
+    }
+    memory = qMax(memory, least_memory);
+    run_memory = memory / 2;
+    batch_memory = memory / 4;
+    return true;
+}
+
+void SizeRuns::clear() {
+    close_readers();
+    directory.reset(); // removes the runs with it
+    buffer = QVector<SpilledFile>();
+    buffer_bytes = 0;
+    run_files.clear();
+    run_count = 0;
+    next_run = 0;
+    spilled = 0;
+    head = SpilledFile();
+    has_head = false;
+    fed.acquire(fed.available());
+    error_message.clear();
+    batch_count = 0;
+    single_count = 0;
+    single_byte_count = 0;
+}
+
+// walkers wait while a full buffer is written, the walk slows down
+// instead of taking more memory
+void SizeRuns::add(quint32 dir, QVector<RecordStore::FileInfo> const& files) {
+    QMutexLocker locker(&lock);
+    if (!error_message.isEmpty()) { return; }
+    for (auto const& info : files) {
+        buffer.push_back({dir, info});
+        buffer_bytes += footprint(buffer.back());
+    }
+    if (buffer_bytes >= run_memory) {
+        write_buffer();
+    }
+}
+
+bool SizeRuns::finish() {
+    QMutexLocker locker(&lock);
+    if (!error_message.isEmpty() || !write_buffer()) {
+        return false;
+    }
+    buffer = QVector<SpilledFile>();
+
+    int first = 0;
+    while (run_files.size() - first > max_fan_in) {
+        if (!merge_pass(first, first + max_fan_in)) {
+            return false;
+        }
+        first += max_fan_in;
+    }
+    if (!open_readers(first, run_files.size())) {
+        return false;
+    }
+    has_head = pop(head);
+    return error_message.isEmpty();
+}
+
+bool SizeRuns::next_batch(QVector<SpilledFile>& batch) {
+    batch.clear();
+    qint64 bytes = 0;
+    while (has_head && (batch.empty() || bytes < batch_memory)) {
+        int first = batch.size();
+        qint64 size = head.info.size;
+        while (has_head && head.info.size == size) {
+            bytes += footprint(head);
+            batch.push_back(head);
+            has_head = pop(head);
+        }
+        if (batch.size() - first == 1) { // no other file has its size
+            bytes -= footprint(batch.back());
+            batch.removeLast();
+            single_count++;
+            single_byte_count += size;
+        }
+    }
+    if (!error_message.isEmpty()) {
+        batch.clear();
+        return false;
+    }
+    if (batch.empty()) {
+        close_readers();
+        return false;
+    }
+    batch_count++;
+    return true;
+}
+
+void SizeRuns::batch_done() {
+    fed.release();
+}
+
+bool SizeRuns::wait_batch(QAtomicInt const& stop_flag) {
+    while (!fed.tryAcquire(1, poll_msecs)) {
+        if (stop_flag != 0) { return false; }
+    }
+    return stop_flag == 0;
+}
+
+QString SizeRuns::error() const {
+    return error_message;
+}
+
+int SizeRuns::runs() const {
+    return run_count;
+}
+
+qint64 SizeRuns::bytes_spilled() const {
+    return spilled;
+}
+
+int SizeRuns::batches() const {
+    return batch_count;
+}
+
+int SizeRuns::singles() const {
+    return single_count;
+}
+
+qint64 SizeRuns::single_bytes() const {
+    return single_byte_count;
+}
+
+qint64 SizeRuns::footprint(SpilledFile const& file) {
+    return qint64(sizeof(SpilledFile)) + file.info.name.size() + name_overhead;
+}
+
+// names of one inode come together within a size
+bool SizeRuns::less(SpilledFile const& a, SpilledFile const& b) {
+    if (a.info.size != b.info.size) {
+        return a.info.size < b.info.size;
+    }
+    if (a.info.device != b.info.device) {
+        return a.info.device < b.info.device;
+    }
+    return a.info.inode < b.info.inode;
+}
+
+QString SizeRuns::run_path(int run) const {
+    return directory->path() + "/run-" + QString::number(run);
+}
+
+bool SizeRuns::write_buffer() {
+    if (buffer.empty()) { return true; }
+    std::sort(buffer.begin(), buffer.end(), less);
+
+    QString path = run_path(next_run++);
+    QFile out(path);
+    QByteArray pending;
+    pending.reserve(write_block + int(sizeof(Header)) + 256);
+    bool good = out.open(QIODevice::WriteOnly);
+    for (int i = 0; good && i < buffer.size(); i++) {
+        good = write_record(out, pending, buffer[i]);
+    }
+    good = good && flush_pending(out, pending);
+    buffer.clear(); // the capacity stays for the next run
+    buffer_bytes = 0;
+    if (!good) {
+        fail("cannot write run " + path);
+        return false;
+    }
+    run_files.push_back(path);
+    run_count++;
+    return true;
+}
+
+bool SizeRuns::write_record(QFile& out, QByteArray& pending, SpilledFile const& file) {
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.size = file.info.size;
+    header.device = file.info.device;
+    header.inode = file.info.inode;
+    header.mtime = file.info.mtime;
+    header.ctime = file.info.ctime;
+    header.dir = file.dir;
+    header.name_length = quint16(file.info.name.size());
+    header.flags = (file.info.unreadable ? Unreadable : 0) | (file.info.linked ? Linked : 0);
+    pending.append(reinterpret_cast<char const*>(&header), sizeof(header));
+    pending.append(file.info.name);
+    spilled += qint64(sizeof(header)) + file.info.name.size();
+    return pending.size() < write_block || flush_pending(out, pending);
+}
+
+bool SizeRuns::flush_pending(QFile& out, QByteArray& pending) {
+    bool written = out.write(pending) == pending.size();
+    pending.resize(0);
+    return written;
+}
+
+// false at the end of the run, and after a short record
+bool SizeRuns::read_record(Reader& reader) {
+    Header header;
+    qint64 got = reader.file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (got == 0) { return false; }
+    auto& info = reader.head.info;
+    if (got == qint64(sizeof(header))) {
+        info.name = reader.file.read(header.name_length);
+    }
+    if (got != qint64(sizeof(header)) || info.name.size() != header.name_length) {
+        fail("cannot read run " + reader.file.fileName());
+        return false;
+    }
+    reader.head.dir = header.dir;
+    info.size = header.size;
+    info.device = header.device;
+    info.inode = header.inode;
+    info.mtime = header.mtime;
+    info.ctime = header.ctime;
+    info.unreadable = (header.flags & Unreadable) != 0;
+    info.linked = (header.flags & Linked) != 0;
+    return true;
+}
+
+bool SizeRuns::open_readers(int first, int last) {
+    close_readers();
+    for (int i = first; i < last; i++) {
+        auto reader = new Reader;
+        reader->file.setFileName(run_files[i]);
+        readers.push_back(reader);
+        if (!reader->file.open(QIODevice::ReadOnly)) {
+            fail("cannot read run " + run_files[i]);
+            return false;
+        }
+        if (read_record(*reader)) {
+            heap.push_back(readers.size() - 1);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), [this](int a, int b) {
+        return less(readers[b]->head, readers[a]->head);
+    });
+    return error_message.isEmpty();
+}
+
+// the merged run takes the place of its inputs at the end of the list
+bool SizeRuns::merge_pass(int first, int last) {
+    if (!open_readers(first, last)) { return false; }
+    QString path = run_path(next_run++);
+    QFile out(path);
+    QByteArray pending;
+    pending.reserve(write_block + int(sizeof(Header)) + 256);
+    bool good = out.open(QIODevice::WriteOnly);
+    SpilledFile file;
+    while (good && pop(file)) {
+        good = write_record(out, pending, file);
+    }
+    good = good && flush_pending(out, pending) && error_message.isEmpty();
+    close_readers();
+    if (!good) {
+        fail("cannot write run " + path);
+        return false;
+    }
+    for (int i = first; i < last; i++) {
+        QFile::remove(run_files[i]);
+    }
+    run_files.push_back(path);
+    return true;
+}
+
+bool SizeRuns::pop(SpilledFile& file) {
+    if (heap.empty()) { return false; }
+    auto later = [this](int a, int b) {
+        return less(readers[b]->head, readers[a]->head);
+    };
+    std::pop_heap(heap.begin(), heap.end(), later);
+    int run = heap.back();
+    file = readers[run]->head;
+    if (read_record(*readers[run])) {
+        std::push_heap(heap.begin(), heap.end(), later);
+    } else {
+        heap.pop_back();
+    }
+    return true;
+}
+
+void SizeRuns::close_readers() {
+    qDeleteAll(readers);
+    readers.clear();
+    heap.clear();
+}
+
+// the first error is kept
+void SizeRuns::fail(QString const& message) {
+    if (error_message.isEmpty()) {
+        error_message = message;
+    }
+}
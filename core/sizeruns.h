@@ -0,0 +1,131 @@
+#ifndef SIZERUNS_H
+#define SIZERUNS_H
+
+#include "recordstore.h"
+
+#include <QAtomicInt>
+#include <QFile>
+#include <QMutex>
+#include <QScopedPointer>
+#include <QSemaphore>
+#include <QString>
+#include <QTemporaryDir>
+#include <QVector>
+
+// a walked file kept outside the store, its directory is in the store
+struct SpilledFile {
+    quint32 dir;
+    RecordStore::FileInfo info;
+};
+
+// out of core scans: walked files go to runs on disk sorted by size
+// instead of into the store, and come back from a merge of the runs one
+// size at a time. Sizes only one file has are counted and dropped there,
+// the rest are handed out in batches of whole sizes, so a batch is
+// grouped without any file of another batch.
+//
+// Half the memory budget holds the run being filled and a quarter the
+// batch handed out, the store and the groups of the batch take about
+// that again. A size with more files than a batch holds is handed out
+// whole, beyond the budget. Merges open at most max_fan_in runs at once,
+// more runs are merged in passes.
+class SizeRuns {
+public:
+    static const int max_fan_in = 64;
+
+    SizeRuns();
+    ~SizeRuns();
+
+    // runs go to a new directory under dir, the temp directory if empty
+    bool open(QString const& dir, qint64 memory);
+    // removes the runs and their directory
+    void clear();
+
+    // thread safe, a full buffer is sorted and written as a run
+    void add(quint32 dir, QVector<RecordStore::FileInfo> const& files);
+    // writes the last run and starts the merge
+    bool finish();
+    // false once every size was handed out, or after an error
+    bool next_batch(QVector<SpilledFile>& batch);
+
+    // the engine has grouped the batch and dropped its files
+    void batch_done();
+    // blocks until batch_done(), false if stop_flag is set first
+    bool wait_batch(QAtomicInt const& stop_flag);
+
+    // empty unless a run could not be written or read
+    QString error() const;
+    int runs() const;
+    qint64 bytes_spilled() const;
+    int batches() const;
+    // files whose size no other file has, and their bytes
+    int singles() const;
+    qint64 single_bytes() const;
+
+private:
+    // fixed part of a record, the name follows it
+    struct Header {
+        qint64 size;
+        quint64 device;
+        quint64 inode;
+        qint64 mtime;
+        qint64 ctime;
+        quint32 dir;
+        quint16 name_length;
+        quint8 flags;
+        quint8 reserved;
+    };
+
+    enum Flags : quint8 {
+        Unreadable = 1,
+        Linked = 2
+    };
+
+    // a run being merged and its smallest record not yet taken
+    struct Reader {
+        QFile file;
+        SpilledFile head;
+    };
+
+    static qint64 footprint(SpilledFile const& file);
+    static bool less(SpilledFile const& a, SpilledFile const& b);
+
+    QString run_path(int run) const;
+    bool write_buffer();
+    bool write_record(QFile& out, QByteArray& pending, SpilledFile const& file);
+    bool flush_pending(QFile& out, QByteArray& pending);
+    bool read_record(Reader& reader);
+    bool open_readers(int first, int last);
+    bool merge_pass(int first, int last);
+    // smallest head of the open readers, false when all are done
+    bool pop(SpilledFile& file);
+    void close_readers();
+    void fail(QString const& message);
+
+    QScopedPointer<QTemporaryDir> directory;
+    qint64 run_memory;
+    qint64 batch_memory;
+
+    QMutex lock;
+    QVector<SpilledFile> buffer;
+    qint64 buffer_bytes;
+    // paths of the runs written, passes replace them with merged ones
+    QVector<QString> run_files;
+    int run_count;
+    int next_run;
+    qint64 spilled;
+
+    QVector<Reader*> readers;
+    // indexes into readers, a heap on their heads
+    QVector<int> heap;
+    SpilledFile head;
+    bool has_head;
+
+    QSemaphore fed;
+    QString error_message;
+    int batch_count;
+    int single_count;
+    qint64 single_byte_count;
+};
+
+#endif // SIZERUNS_H
@@ -0,0 +1,200 @@
+#include "snapshot.h"
+
+#include <QHash>
+#include <QSaveFile>
+#include <QScopedPointer>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+bool record_less(SnapshotRecord const& a, SnapshotRecord const& b) {
+    if (a.size != b.size) {
+        return a.size < b.size;
+    }
+    return memcmp(a.full, b.full, Digest::width) < 0;
+}
+
+}
+
+Snapshot::Snapshot() : file(), header(), records(nullptr), names(nullptr) {}
+
+Snapshot::~Snapshot() {
+    close();
+}
+
+// a foreign, outdated or truncated file is refused
+bool Snapshot::open(QString const& path) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(Header))) {
+        file.close();
+        return false;
+    }
+    uchar* data = file.map(0, file.size());
+    if (data == nullptr) {
+        file.close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != magic || header.version != version || header.count < 0 || header.names_size < 0
+            || file.size() != qint64(sizeof(Header)) + header.count * qint64(sizeof(SnapshotRecord)) + header.names_size) {
+        close();
+        return false;
+    }
+    header.shard[sizeof(header.shard) - 1] = 0;
+    records = reinterpret_cast<SnapshotRecord const*>(data + sizeof(Header));
+    names = reinterpret_cast<char const*>(records + header.count);
+    return true;
+}
+
+void Snapshot::close() {
+    if (file.isOpen()) {
+        file.close(); // unmaps as well
+    }
+    memset(&header, 0, sizeof(header));
+    records = nullptr;
+    names = nullptr;
+}
+
+QString Snapshot::shard() const {
+    return QString::fromUtf8(header.shard);
+}
+
+DigestType Snapshot::digest() const {
+    return DigestType(header.digest);
+}
+
+qint64 Snapshot::block_size() const {
+    return header.block_size;
+}
+
+qint64 Snapshot::partial_min_size() const {
+    return header.partial_min_size;
+}
+
+qint64 Snapshot::count() const {
+    return header.count;
+}
+
+SnapshotRecord const& Snapshot::record(qint64 i) const {
+    return records[i];
+}
+
+QByteArray Snapshot::path(qint64 i) const {
+    quint64 offset = records[i].path;
+    if (offset >= quint64(header.names_size)) { return QByteArray(); }
+    return QByteArray(names + offset, int(strnlen(names + offset, header.names_size - offset)));
+}
+
+bool Snapshot::write(QString const& path, QString const& shard, DigestType digest, qint64 block_size,
+                     qint64 partial_min_size, QVector<SnapshotRecord>& records, QByteArray const& names) {
+    std::sort(records.begin(), records.end(), record_less);
+
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = magic;
+    header.version = version;
+    header.digest = quint32(digest);
+    header.block_size = block_size;
+    header.partial_min_size = partial_min_size;
+    header.count = records.size();
+    header.names_size = names.size();
+    QByteArray name = shard.toUtf8().left(sizeof(header.shard) - 1);
+    memcpy(header.shard, name.constData(), name.size());
+
+    out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    out.write(reinterpret_cast<char const*>(records.constData()), records.size() * qint64(sizeof(SnapshotRecord)));
+    out.write(names);
+    return out.commit();
+}
+
+Stage Snapshot::next_stage(qint64 size, qint64 block_size, qint64 partial_min_size) {
+    if (size < partial_min_size || size <= 2 * block_size) {
+        return Stage::Full;
+    }
+    return Stage::Partial;
+}
+
+bool Snapshot::hash_file(FileReader* reader, Digest* digest, QByteArray const& path, qint64 size, Stage stage,
+                         qint64 block_size, QByteArray& result) {
+    QVector<ReadRange> ranges = {{0, -1}};
+    if (stage == Stage::Partial) {
+        ranges = {{0, block_size}};
+        if (size > block_size) {
+            ranges.push_back({qMax(block_size, size - block_size), block_size});
+        }
+    }
+    digest->reset();
+    bool read = reader->read(path, ranges, digest);
+    result = digest->result();
+    return read;
+}
+
+// a file that changed since its scan keeps what it had, the next scan
+// of its shard sees it again
+bool Snapshot::refine(QString const& path, QString const& need_list, ReadStrategy strategy, int& hashed) {
+    hashed = 0;
+    QFile list(need_list);
+    if (!list.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QHash<QByteArray, Stage> needed;
+    while (!list.atEnd()) {
+        QByteArray line = list.readLine();
+        line.chop(line.endsWith('\n') ? 1 : 0);
+        int tab = line.indexOf('\t');
+        if (tab < 0) { continue; }
+        needed.insert(line.mid(tab + 1), line.left(tab) == "partial" ? Stage::Partial : Stage::Full);
+    }
+
+    Snapshot snapshot;
+    if (!snapshot.open(path)) {
+        return false;
+    }
+    QVector<SnapshotRecord> records(int(snapshot.count()));
+    if (!records.empty()) {
+        memcpy(records.data(), &snapshot.record(0), records.size() * sizeof(SnapshotRecord));
+    }
+    QByteArray names(snapshot.names, int(snapshot.header.names_size));
+    QString shard = snapshot.shard();
+    DigestType type = snapshot.digest();
+    qint64 block = snapshot.block_size();
+    qint64 partial_min = snapshot.partial_min_size();
+    snapshot.close();
+
+    QScopedPointer<FileReader> reader(FileReader::create(strategy, false));
+    QScopedPointer<Digest> digest(Digest::create(type));
+    for (auto& record : records) {
+        if (needed.empty()) { break; }
+        QByteArray file = names.constData() + record.path;
+        auto it = needed.find(file);
+        if (it == needed.end()) { continue; }
+        Stage stage = it.value();
+        needed.erase(it);
+
+        struct stat st;
+        if (stat(file.constData(), &st) != 0 || st.st_size != record.size) { continue; }
+        QByteArray result;
+        if (!hash_file(reader.data(), digest.data(), file, record.size, stage, block, result)) {
+            record.flags |= SnapshotRecord::Unreadable;
+            continue;
+        }
+        if (stage == Stage::Partial) {
+            memcpy(record.partial, result.constData(), Digest::width);
+            record.flags |= SnapshotRecord::HasPartial;
+        } else {
+            memcpy(record.full, result.constData(), Digest::width);
+            record.flags |= SnapshotRecord::HasFull;
+        }
+        hashed++;
+    }
+    return write(path, shard, type, block, partial_min, records, names);
+}
@@ -0,0 +1,90 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "digest.h"
+#include "filereader.h"
+#include "recordstore.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// one file of a snapshot, the digests it got in its own scan
+struct SnapshotRecord {
+    enum Flags : quint32 {
+        HasPartial = 1,
+        HasFull = 2,
+        Unreadable = 4,
+        // a hard link to another file of the snapshot, or laid out on its
+        // extents: its digests are those of that file, it frees nothing
+        Linked = 8,
+        Shared = 16
+    };
+
+    qint64 size;
+    // offset of the native path in the name block
+    quint64 path;
+    quint32 flags;
+    quint32 reserved;
+    char partial[Digest::width];
+    char full[Digest::width];
+};
+
+// size, partial and full digest index of one host or shard as a file:
+// a header, records sorted by size and full digest, then the paths.
+// The file is memory mapped and read in place, snapshots of several
+// shards are merged without reading any file content.
+class Snapshot {
+public:
+    Snapshot();
+    ~Snapshot();
+
+    bool open(QString const& path);
+    void close();
+
+    QString shard() const;
+    DigestType digest() const;
+    qint64 block_size() const;
+    qint64 partial_min_size() const;
+
+    qint64 count() const;
+    SnapshotRecord const& record(qint64 i) const;
+    QByteArray path(qint64 i) const;
+
+    // sorts the records, their paths point into names
+    static bool write(QString const& path, QString const& shard, DigestType digest, qint64 block_size,
+                      qint64 partial_min_size, QVector<SnapshotRecord>& records, QByteArray const& names);
+    // the stage that tells files of the size apart next, as the engine does
+    static Stage next_stage(qint64 size, qint64 block_size, qint64 partial_min_size);
+
+    // digest of the stage, head and tail blocks are read as the hash threads do
+    static bool hash_file(FileReader* reader, Digest* digest, QByteArray const& path, qint64 size, Stage stage,
+                          qint64 block_size, QByteArray& result);
+    // hashes the files a merge asked for, lines of "partial\tpath" or
+    // "full\tpath", and rewrites the snapshot with their digests
+    static bool refine(QString const& path, QString const& need_list, ReadStrategy strategy, int& hashed);
+
+private:
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint32 digest;
+        quint32 reserved;
+        qint64 block_size;
+        qint64 partial_min_size;
+        qint64 count;
+        qint64 names_size;
+        char shard[64];
+    };
+
+    static const quint32 magic = 0x4e534446; // "FDSN"
+    static const quint32 version = 1;
+
+    QFile file;
+    Header header;
+    SnapshotRecord const* records;
+    char const* names;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,188 @@
+#include "snapshotmerger.h"
+
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+
+#include <climits>
+
+SnapshotMerger::SnapshotMerger() : snapshots(), need_files(), need_dir(), out(nullptr), message(), merge_stats() {}
+
+SnapshotMerger::~SnapshotMerger() {
+    qDeleteAll(snapshots);
+    qDeleteAll(need_files);
+}
+
+QString SnapshotMerger::error() const {
+    return message;
+}
+
+MergeStats const& SnapshotMerger::stats() const {
+    return merge_stats;
+}
+
+// every snapshot is read once, in size order, a bucket at a time
+bool SnapshotMerger::merge(QStringList const& paths, QIODevice* out, QString const& need_dir) {
+    this->out = out;
+    this->need_dir = need_dir;
+    merge_stats = MergeStats();
+    QSet<QString> shards;
+    for (auto const& path : paths) {
+        auto snapshot = new Snapshot();
+        snapshots.push_back(snapshot);
+        need_files.push_back(nullptr);
+        if (!snapshot->open(path)) {
+            message = "cannot read snapshot " + path;
+            return false;
+        }
+        auto const& first = *snapshots.front();
+        if (snapshot->digest() != first.digest() || snapshot->block_size() != first.block_size()
+                || snapshot->partial_min_size() != first.partial_min_size()) {
+            message = path + " was made with another digest or block size than " + paths.front();
+            return false;
+        }
+        if (shards.contains(snapshot->shard())) {
+            message = "two snapshots of shard " + snapshot->shard();
+            return false;
+        }
+        shards.insert(snapshot->shard());
+    }
+    merge_stats.shards = snapshots.size();
+    if (!need_dir.isEmpty()) {
+        QDir().mkpath(need_dir);
+    }
+
+    QVector<qint64> next(snapshots.size(), 0);
+    QVector<Entry> bucket;
+    while (true) {
+        qint64 size = LLONG_MAX;
+        for (int i = 0; i < snapshots.size(); i++) {
+            if (next[i] < snapshots[i]->count()) {
+                size = qMin(size, snapshots[i]->record(next[i]).size);
+            }
+        }
+        if (size == LLONG_MAX) { break; }
+
+        bucket.clear();
+        for (int i = 0; i < snapshots.size(); i++) {
+            for (; next[i] < snapshots[i]->count() && snapshots[i]->record(next[i]).size == size; next[i]++) {
+                bucket.push_back({i, next[i]});
+            }
+        }
+        merge_bucket(size, bucket);
+    }
+
+    for (auto file : need_files) {
+        if (file != nullptr && file->isOpen() && !file->flush()) {
+            fail_need(*file);
+        }
+    }
+    return message.isEmpty();
+}
+
+void SnapshotMerger::merge_bucket(qint64 size, QVector<Entry> const& bucket) {
+    merge_stats.files += bucket.size();
+    if (bucket.size() < 2) { return; }
+
+    // full digests settle the bucket, within a shard and across shards
+    // links and shared extents stand for another file of their shard, a
+    // group of them would free nothing
+    auto skipped = SnapshotRecord::Unreadable | SnapshotRecord::Linked | SnapshotRecord::Shared;
+    QHash<QByteArray, QVector<Entry>> by_full;
+    QSet<int> shards;
+    for (auto const& entry : bucket) {
+        auto const& record = snapshots[entry.shard]->record(entry.index);
+        if (record.flags & skipped) { continue; }
+        shards.insert(entry.shard);
+        if (record.flags & SnapshotRecord::HasFull) {
+            by_full[QByteArray(record.full, Digest::width)].push_back(entry);
+        }
+    }
+    for (auto it = by_full.begin(); it != by_full.end(); ++it) {
+        auto const& entries = it.value();
+        if (entries.size() < 2) { continue; }
+        QJsonArray files;
+        QSet<int> group_shards;
+        for (auto const& entry : entries) {
+            auto snapshot = snapshots[entry.shard];
+            files.append(snapshot->shard() + ':' + QFile::decodeName(snapshot->path(entry.index)));
+            group_shards.insert(entry.shard);
+        }
+        QJsonObject line;
+        line["size"] = static_cast<double>(size);
+        line["digest"] = QString::fromLatin1(it.key().toHex());
+        line["shards"] = group_shards.size();
+        line["files"] = files;
+        out->write(QJsonDocument(line).toJson(QJsonDocument::Compact) + '\n');
+        merge_stats.groups++;
+        merge_stats.cross_groups += group_shards.size() > 1 ? 1 : 0;
+        merge_stats.bytes_duplicated += size * (entries.size() - 1);
+    }
+    if (shards.size() < 2) { return; }
+
+    // what each shard knows of the partial digests of the bucket
+    QHash<QByteArray, QSet<int>> partial_shards;
+    QSet<int> full_only;
+    for (auto const& entry : bucket) {
+        auto const& record = snapshots[entry.shard]->record(entry.index);
+        if (record.flags & skipped) { continue; }
+        if (record.flags & SnapshotRecord::HasPartial) {
+            partial_shards[QByteArray(record.partial, Digest::width)].insert(entry.shard);
+        } else if (record.flags & SnapshotRecord::HasFull) {
+            full_only.insert(entry.shard);
+        }
+    }
+    auto other_shard = [](QSet<int> const& set, int shard) {
+        return set.size() > 1 || (set.size() == 1 && !set.contains(shard));
+    };
+
+    auto const& first = *snapshots.front();
+    for (auto const& entry : bucket) {
+        auto const& record = snapshots[entry.shard]->record(entry.index);
+        if (record.flags & (skipped | SnapshotRecord::HasFull)) { continue; }
+        if (!(record.flags & SnapshotRecord::HasPartial)) { // unique by size in its own shard
+            need(entry, Snapshot::next_stage(size, first.block_size(), first.partial_min_size()));
+            continue;
+        }
+        // a file of another shard with the same head and tail, or one
+        // whose head and tail are not known
+        if (other_shard(partial_shards.value(QByteArray(record.partial, Digest::width)), entry.shard)
+                || other_shard(full_only, entry.shard)) {
+            need(entry, Stage::Full);
+        }
+    }
+}
+
+void SnapshotMerger::need(Entry const& entry, Stage stage) {
+    if (stage == Stage::Partial) {
+        merge_stats.need_partial++;
+    } else {
+        merge_stats.need_full++;
+    }
+    if (need_dir.isEmpty()) { return; }
+
+    auto& file = need_files[entry.shard];
+    if (file == nullptr) {
+        file = new QFile(need_dir + '/' + snapshots[entry.shard]->shard() + ".need");
+        if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            fail_need(*file);
+        }
+    }
+    if (!file->isOpen()) { return; }
+    QByteArray line = (stage == Stage::Partial ? "partial\t" : "full\t") + snapshots[entry.shard]->path(entry.index) + '\n';
+    if (file->write(line) != line.size()) {
+        fail_need(*file);
+        file->close(); // a list with lines missing would pass for a complete one
+    }
+}
+
+// the first error is kept, the merge goes on and fails at the end
+void SnapshotMerger::fail_need(QFile const& file) {
+    if (message.isEmpty()) {
+        message = "cannot write " + file.fileName() + ": " + file.errorString();
+    }
+}
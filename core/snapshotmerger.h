@@ -0,0 +1,58 @@
+#ifndef SNAPSHOTMERGER_H
+#define SNAPSHOTMERGER_H
+
+#include "snapshot.h"
+
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct MergeStats {
+    int shards = 0;
+    qint64 files = 0;
+    int groups = 0;
+    // groups with files of more than one shard
+    int cross_groups = 0;
+    qint64 bytes_duplicated = 0;
+    // files a shard has to hash before the next merge can tell
+    qint64 need_partial = 0;
+    qint64 need_full = 0;
+};
+
+// global duplicate groups of several snapshots. Records are merged by
+// size, a size bucket of one shard was settled by its own scan. A bucket
+// shared by shards is grouped by full digests, and its files that could
+// still match a file of another shard are listed for that shard to hash
+// one stage further (Snapshot::refine), then the snapshots are merged again.
+class SnapshotMerger {
+public:
+    SnapshotMerger();
+    ~SnapshotMerger();
+
+    // groups go to out as JSON lines with "shard:path" files, the lists
+    // of files to hash to need_dir/<shard>.need
+    bool merge(QStringList const& paths, QIODevice* out, QString const& need_dir);
+    QString error() const;
+    MergeStats const& stats() const;
+
+private:
+    struct Entry {
+        int shard;
+        qint64 index;
+    };
+
+    void merge_bucket(qint64 size, QVector<Entry> const& bucket);
+    void need(Entry const& entry, Stage stage);
+    void fail_need(QFile const& file);
+
+    QVector<Snapshot*> snapshots;
+    QVector<QFile*> need_files;
+    QString need_dir;
+    QIODevice* out;
+    QString message;
+    MergeStats merge_stats;
+};
+
+#endif // SNAPSHOTMERGER_H
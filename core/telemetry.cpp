@@ -0,0 +1,156 @@
+#include "telemetry.h"
+
+Histogram::Histogram() : total_nsecs(0) {
+    for (auto& count : counts) {
+        count.store(0);
+    }
+}
+
+void Histogram::add(qint64 nsecs) {
+    int bucket = 0;
+    for (qint64 usecs = nsecs / 1000; usecs > 0 && bucket < buckets - 1; usecs >>= 1) {
+        bucket++;
+    }
+    counts[bucket].fetchAndAddRelaxed(1);
+    total_nsecs.fetchAndAddRelaxed(nsecs);
+}
+
+void Histogram::clear() {
+    for (auto& count : counts) {
+        count.store(0);
+    }
+    total_nsecs.store(0);
+}
+
+QJsonObject Histogram::to_json() const {
+    qint64 values[buckets];
+    qint64 total = 0;
+    for (int i = 0; i < buckets; i++) {
+        values[i] = counts[i].load();
+        total += values[i];
+    }
+
+    // bucket i holds durations below 2^i microseconds
+    auto percentile = [&](int percent) {
+        qint64 seen = 0;
+        for (int i = 0; i < buckets; i++) {
+            seen += values[i];
+            if (seen * 100 >= total * percent) {
+                return qint64(1) << i;
+            }
+        }
+        return qint64(1) << (buckets - 1);
+    };
+
+    QJsonObject json;
+    json["count"] = total;
+    json["mean_us"] = total == 0 ? 0 : total_nsecs.load() / total / 1000;
+    json["p50_us"] = total == 0 ? 0 : percentile(50);
+    json["p90_us"] = total == 0 ? 0 : percentile(90);
+    json["p99_us"] = total == 0 ? 0 : percentile(99);
+    return json;
+}
+
+Telemetry::Telemetry() : on(0), walked(0), hashed(0), bytes_hashed(0), io_nsecs(0), cpu_nsecs(0), drained(0),
+    hash_latency(), apply_latency(), since(), last_walked(0), last_bytes(0), last_drained(0) {}
+
+void Telemetry::set_enabled(bool enabled) {
+    on.store(enabled ? 1 : 0);
+}
+
+// must not be called while a scan is under way
+void Telemetry::clear() {
+    walked.store(0);
+    hashed.store(0);
+    bytes_hashed.store(0);
+    io_nsecs.store(0);
+    cpu_nsecs.store(0);
+    drained.store(0);
+    hash_latency.clear();
+    apply_latency.clear();
+    since.start();
+    last_walked = 0;
+    last_bytes = 0;
+    last_drained = 0;
+}
+
+void Telemetry::add_walked(int files) {
+    if (!enabled()) { return; }
+    walked.fetchAndAddRelaxed(files);
+}
+
+void Telemetry::add_hashed(qint64 bytes, qint64 io, qint64 cpu) {
+    if (!enabled()) { return; }
+    hashed.fetchAndAddRelaxed(1);
+    bytes_hashed.fetchAndAddRelaxed(bytes);
+    io_nsecs.fetchAndAddRelaxed(io);
+    cpu_nsecs.fetchAndAddRelaxed(cpu);
+    hash_latency.add(io + cpu);
+}
+
+void Telemetry::add_drain(int files, qint64 nsecs) {
+    if (!enabled()) { return; }
+    drained.fetchAndAddRelaxed(files);
+    apply_latency.add(nsecs);
+}
+
+QJsonObject Telemetry::report(StageDepths const& depths) {
+    double seconds = qMax<qint64>(since.restart(), 1) / 1000.0;
+    qint64 now_walked = walked.load();
+    qint64 now_bytes = bytes_hashed.load();
+    qint64 now_drained = drained.load();
+
+    QJsonObject walk;
+    walk["files"] = now_walked;
+    walk["files_per_s"] = qRound64((now_walked - last_walked) / seconds);
+
+    QJsonObject hash;
+    hash["files"] = hashed.load();
+    hash["bytes"] = now_bytes;
+    hash["bytes_per_s"] = qRound64((now_bytes - last_bytes) / seconds);
+    hash["io_msecs"] = io_nsecs.load() / 1000000;
+    hash["cpu_msecs"] = cpu_nsecs.load() / 1000000;
+    hash["latency"] = hash_latency.to_json();
+
+    QJsonObject apply;
+    apply["files"] = now_drained;
+    apply["files_per_s"] = qRound64((now_drained - last_drained) / seconds);
+    apply["latency"] = apply_latency.to_json();
+
+    QJsonObject queues;
+    queues["result_ring"] = depths.result_ring;
+    queues["hash_queue"] = depths.hash_queue;
+    queues["compare_buckets"] = depths.compare_buckets;
+
+    last_walked = now_walked;
+    last_bytes = now_bytes;
+    last_drained = now_drained;
+
+    QJsonObject json;
+    json["walk"] = walk;
+    json["hash"] = hash;
+    json["apply"] = apply;
+    json["queues"] = queues;
+    json["in_flight"] = depths.hash_queue + depths.hash_busy;
+    return json;
+}
+
+TimedDigest::TimedDigest(Digest* digest) : digest(digest), length(0), spent(0) {}
+
+void TimedDigest::reset() {
+    digest->reset();
+    length = 0;
+    spent = 0;
+}
+
+void TimedDigest::add_data(char const* data, qint64 length) {
+    QElapsedTimer timer;
+    timer.start();
+    digest->add_data(data, length);
+    spent += timer.nsecsElapsed();
+    this->length += length;
+}
+
+QByteArray TimedDigest::result() {
+    return digest->result();
+}
@@ -0,0 +1,95 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "digest.h"
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+// durations in power of two buckets of microseconds, the last one
+// takes everything from about a second up
+class Histogram {
+public:
+    static const int buckets = 21;
+
+    Histogram();
+
+    void add(qint64 nsecs);
+    void clear();
+    // count, mean and upper bounds of the 50th, 90th and 99th percentiles
+    QJsonObject to_json() const;
+
+private:
+    QAtomicInteger<qint64> counts[buckets];
+    QAtomicInteger<qint64> total_nsecs;
+};
+
+// queue depths, sampled by the engine when it reports
+struct StageDepths {
+    int result_ring = 0;
+    int hash_queue = 0;
+    int hash_busy = 0;
+    int compare_buckets = 0;
+};
+
+// counters and timings of the scan stages, bumped by the threads of each
+// stage. While disabled every call returns after one relaxed load and
+// no clock is read.
+class Telemetry {
+public:
+    Telemetry();
+
+    void set_enabled(bool enabled);
+    bool enabled() const { return on.load() != 0; }
+    void clear();
+
+    void add_walked(int files);
+    // a file read and hashed, io is the time spent outside the digest
+    void add_hashed(qint64 bytes, qint64 io_nsecs, qint64 cpu_nsecs);
+    void add_drain(int files, qint64 nsecs);
+
+    // totals, rates since the previous report and the given depths
+    QJsonObject report(StageDepths const& depths);
+
+private:
+    QAtomicInt on;
+    QAtomicInteger<qint64> walked;
+    QAtomicInteger<qint64> hashed;
+    QAtomicInteger<qint64> bytes_hashed;
+    QAtomicInteger<qint64> io_nsecs;
+    QAtomicInteger<qint64> cpu_nsecs;
+    QAtomicInteger<qint64> drained;
+    Histogram hash_latency;
+    Histogram apply_latency;
+
+    // previous report, only touched by the reporting thread
+    QElapsedTimer since;
+    qint64 last_walked;
+    qint64 last_bytes;
+    qint64 last_drained;
+};
+
+// forwards to a digest and keeps the time spent in it, so a reader's
+// time splits into waiting for data and hashing it. Page faults of a
+// mapped file land on the digest side.
+class TimedDigest : public Digest {
+public:
+    explicit TimedDigest(Digest* digest);
+
+    using Digest::add_data;
+
+    void reset() override;
+    void add_data(char const* data, qint64 length) override;
+    QByteArray result() override;
+
+    qint64 bytes() const { return length; }
+    qint64 nsecs() const { return spent; }
+
+private:
+    Digest* digest;
+    qint64 length;
+    qint64 spent;
+};
+
+#endif // TELEMETRY_H
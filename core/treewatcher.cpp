@@ -0,0 +1,136 @@
+#include "treewatcher.h"
+
+#include <QFile>
+#include <QSocketNotifier>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+// a file counts as changed once it is closed after writing or moved in,
+// files created by link() alone are not seen until they are written
+const uint32_t watch_mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+        | IN_DELETE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+}
+
+TreeWatcher::TreeWatcher(QObject* parent) : QObject(parent), fd(-1), notifier(nullptr), paths(), descriptors(),
+    error_message() {}
+
+TreeWatcher::~TreeWatcher() {
+    stop();
+}
+
+bool TreeWatcher::start() {
+    stop();
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        error_message = "cannot watch the tree: " + QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &TreeWatcher::read_events);
+    return true;
+}
+
+void TreeWatcher::stop() {
+    delete notifier;
+    notifier = nullptr;
+    if (fd >= 0) {
+        close(fd); // drops all watches
+        fd = -1;
+    }
+    paths.clear();
+    descriptors.clear();
+    error_message.clear();
+}
+
+bool TreeWatcher::active() const {
+    return fd >= 0;
+}
+
+bool TreeWatcher::watch(QByteArray const& dir) {
+    if (fd < 0) { return false; }
+    int wd = inotify_add_watch(fd, dir.constData(), watch_mask);
+    if (wd < 0) {
+        if (error_message.isEmpty()) {
+            error_message = "cannot watch " + QFile::decodeName(dir) + ": " + QString::fromLocal8Bit(strerror(errno));
+        }
+        return false;
+    }
+    paths.insert(wd, dir); // a directory moved back gets its old descriptor
+    descriptors.insert(dir, wd);
+    return true;
+}
+
+void TreeWatcher::unwatch(QByteArray const& dir) {
+    QByteArray prefix = dir.endsWith('/') ? dir : dir + '/'; // the root "/"
+    for (auto it = descriptors.begin(); it != descriptors.end();) {
+        if (it.key() == dir || it.key().startsWith(prefix)) {
+            inotify_rm_watch(fd, it.value());
+            paths.remove(it.value());
+            it = descriptors.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+int TreeWatcher::watches() const {
+    return descriptors.size();
+}
+
+QString TreeWatcher::error() const {
+    return error_message;
+}
+
+void TreeWatcher::read_events() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    QVector<TreeChange> changes;
+    bool overflow = false;
+    while (true) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0) { break; } // EAGAIN once the queue is empty
+
+        for (char* at = buffer; at < buffer + length;) {
+            auto event = reinterpret_cast<inotify_event*>(at);
+            at += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            if (event->mask & IN_IGNORED) { // the directory is gone or unwatched
+                auto path = paths.take(event->wd);
+                if (descriptors.value(path, -1) == event->wd) {
+                    descriptors.remove(path);
+                }
+                continue;
+            }
+            auto path = paths.find(event->wd);
+            if (path == paths.end() || event->len == 0) { continue; }
+            QByteArray name(event->name);
+            if (name.startsWith('.')) { continue; } // hidden, as the walker skips them
+
+            bool is_dir = event->mask & IN_ISDIR;
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                changes.push_back({is_dir ? TreeChange::DirRemoved : TreeChange::FileRemoved, path.value(), name});
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                changes.push_back({is_dir ? TreeChange::DirAdded : TreeChange::FileWritten, path.value(), name});
+            } else if ((event->mask & IN_CREATE) && is_dir) {
+                changes.push_back({TreeChange::DirAdded, path.value(), name});
+            }
+        }
+    }
+
+    if (overflow) {
+        emit overflowed();
+        return;
+    }
+    if (!changes.empty()) {
+        emit changed(changes);
+    }
+}
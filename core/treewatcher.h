@@ -0,0 +1,63 @@
+#ifndef TREEWATCHER_H
+#define TREEWATCHER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class QSocketNotifier;
+
+// a change of one entry, name is relative to the watched directory dir
+struct TreeChange {
+    enum Kind {
+        FileWritten,
+        FileRemoved,
+        DirAdded,
+        DirRemoved
+    };
+
+    Kind kind;
+    QByteArray dir;
+    QByteArray name;
+};
+
+// inotify watches on the directories of a scanned tree. Events that are
+// read together reach the engine as one batch. Directories are watched
+// one by one, a new one has to be listed by the engine after watch().
+class TreeWatcher : public QObject {
+    Q_OBJECT
+public:
+    explicit TreeWatcher(QObject* parent = nullptr);
+    ~TreeWatcher() override;
+
+    bool start();
+    void stop();
+    bool active() const;
+
+    // false if the directory cannot be watched, error() says why
+    bool watch(QByteArray const& dir);
+    // drops the watches of dir and the directories under it
+    void unwatch(QByteArray const& dir);
+    int watches() const;
+    // the first failure since start(), inotify limits run out on large trees
+    QString error() const;
+
+signals:
+    void changed(QVector<TreeChange> const& changes);
+    // the kernel dropped events, the tree has to be walked again
+    void overflowed();
+
+private slots:
+    void read_events();
+
+private:
+    int fd;
+    QSocketNotifier* notifier;
+    QHash<int, QByteArray> paths;
+    QHash<QByteArray, int> descriptors;
+    QString error_message;
+};
+
+#endif // TREEWATCHER_H
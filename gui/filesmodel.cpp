@@ -0,0 +1,379 @@
+#include "filesmodel.h"
+
+#include <QLocale>
+
+#include <algorithm>
+
+namespace {
+
+// files of a group added to the view at a time
+const int fetch_batch = 256;
+
+}
+
+FilesModel::FilesModel() :
+    QAbstractItemModel(nullptr),
+    scan_engine(new ScanEngine()),
+    show_unique(true),
+    order(),
+    keys(),
+    fetched(),
+    pending(Pending::None),
+    pending_group(-1),
+    pending_first(0),
+    pending_last(-1)
+{
+    scan_engine->set_listener(this);
+    rebuild();
+}
+
+FilesModel::~FilesModel() {
+    scan_engine->set_listener(nullptr);
+    delete scan_engine;
+}
+
+ScanEngine* FilesModel::engine() const {
+    return scan_engine;
+}
+
+QVariant FilesModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid())
+        return QVariant();
+
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    if (is_file(index)) {
+        return file_path(index);
+    }
+    int group = group_at(index.row());
+    auto const& ptr = scan_engine->group(group);
+    int size = ptr.files.size();
+    if (group == ScanEngine::unique_group) {
+        return QString::number(size) + " unique files";
+    } else if (ptr.kind == GroupKind::Hardlinks) {
+        return QString::number(size) + " hard links to one file";
+    } else if (ptr.kind == GroupKind::SharedExtents) {
+        return QString::number(size) + " files sharing their extents";
+    } else if (ptr.kind == GroupKind::Directories && scan_engine->approximate(group)) {
+        return QString::number(size) + " directories of " + QString::number(scan_engine->directory_files(group))
+                + " same files, with hidden or left out entries not compared";
+    } else if (ptr.kind == GroupKind::Directories) {
+        return QString::number(size) + " same directories of " + QString::number(scan_engine->directory_files(group))
+                + " files, " + QLocale().formattedDataSize(reclaimable(group)) + " to free";
+    } else if (ptr.kind == GroupKind::Referenced) {
+        return QString::number(size) + (size == 1 ? " file" : " files") + " already in the reference as "
+                + scan_engine->reference_path(group) + ", " + QLocale().formattedDataSize(reclaimable(group)) + " to free";
+    } else {
+        return QString::number(size) + " same files, "
+                + QLocale().formattedDataSize(reclaimable(group)) + " to free";
+    }
+}
+
+bool FilesModel::deletable(QModelIndex const& index) const {
+    if (!is_file(index)) { return false; }
+    auto kind = scan_engine->group(group_of(index)).kind;
+    return kind == GroupKind::Copies || kind == GroupKind::Referenced;
+}
+
+QVector<int> FilesModel::groups_of(QModelIndexList const& indexes) const {
+    QVector<int> result;
+    for (auto const& index : indexes) {
+        if (!index.isValid()) { continue; }
+        int group = is_file(index) ? group_of(index) : group_at(index.row());
+        if (!result.contains(group)) {
+            result.push_back(group);
+        }
+    }
+    return result;
+}
+
+bool FilesModel::is_file(QModelIndex const& index) const {
+    return index.isValid() && index.internalId() != 0;
+}
+
+QString FilesModel::file_path(QModelIndex const& index) const {
+    if (!is_file(index)) {
+        return QString();
+    }
+    int group = group_of(index);
+    return scan_engine->member_path(group, scan_engine->group(group).files[index.row()]);
+}
+
+int FilesModel::group_of(QModelIndex const& index) const {
+    return int(index.internalId()) - 1;
+}
+
+int FilesModel::group_at(int row) const {
+    return order[row];
+}
+
+void FilesModel::set_show_unique(bool show) {
+    if (show == show_unique) { return; }
+    beginResetModel();
+    show_unique = show;
+    rebuild();
+    endResetModel();
+}
+
+qint64 FilesModel::reclaimable(int group) const {
+    if (group == ScanEngine::unique_group) {
+        return -1;
+    }
+    auto const& ptr = scan_engine->group(group);
+    if (ptr.kind == GroupKind::Referenced) { // the kept copy is in the reference
+        return ptr.size * ptr.files.size();
+    }
+    if (ptr.kind != GroupKind::Copies && ptr.kind != GroupKind::Directories) {
+        return 0;
+    }
+    if (scan_engine->approximate(group)) { // deleting one may lose what was not compared
+        return 0;
+    }
+    return ptr.size * qMax(ptr.files.size() - 1, 0);
+}
+
+// more to free first, ties in id order
+bool FilesModel::before(int first, int second) const {
+    qint64 first_key = keys[first];
+    qint64 second_key = keys[second];
+    return first_key > second_key || (first_key == second_key && first < second);
+}
+
+// where the group is, or goes with its key when it is not in order yet
+int FilesModel::position_of(int group) const {
+    auto it = std::lower_bound(order.begin(), order.end(), group, [this](int a, int b) { return before(a, b); });
+    return int(it - order.begin());
+}
+
+bool FilesModel::shown(int group) const {
+    return group != ScanEngine::unique_group || show_unique;
+}
+
+void FilesModel::add_group(int group) {
+    keys[group] = reclaimable(group);
+    fetched[group] = 0;
+    int row = position_of(group);
+    beginInsertRows(QModelIndex(), row, row);
+    order.insert(row, group);
+    endInsertRows();
+}
+
+// groups only grow or shrink by a few files at a time, so one move
+// keeps the order instead of sorting everything again
+void FilesModel::reposition(int group) {
+    if (!keys.contains(group)) { return; }
+    qint64 key = reclaimable(group);
+    if (key == keys[group]) { return; }
+
+    int from = position_of(group);
+    order.remove(from);
+    qint64 old_key = keys[group];
+    keys[group] = key;
+    int to = position_of(group);
+    if (to == from) {
+        order.insert(from, group);
+        return;
+    }
+    keys[group] = old_key;
+    order.insert(from, group);
+
+    beginMoveRows(QModelIndex(), from, from, QModelIndex(), to < from ? to : to + 1);
+    order.remove(from);
+    keys[group] = key;
+    order.insert(to, group);
+    endMoveRows();
+}
+
+void FilesModel::rebuild() {
+    order.clear();
+    keys.clear();
+    fetched.clear();
+    for (int row = 0; row < scan_engine->group_count(); row++) {
+        int group = scan_engine->group_at(row);
+        if (!shown(group)) { continue; }
+        order.push_back(group);
+        keys[group] = reclaimable(group);
+        fetched[group] = 0;
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) { return before(a, b); });
+}
+
+QVariant FilesModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    if (orientation != Qt::Horizontal) {
+        return QVariant();
+    }
+
+    if (section == 0) {
+        return "Name";
+    } else {
+        return QVariant();
+    }
+}
+
+QModelIndex FilesModel::index(int row, int column, const QModelIndex &parent) const {
+    if (!hasIndex(row, column, parent)) {
+        return QModelIndex();
+    }
+
+    if (!parent.isValid()) {
+        return createIndex(row, column, quintptr(0));
+    }
+    return createIndex(row, column, quintptr(group_at(parent.row()) + 1));
+}
+
+QModelIndex FilesModel::parent(const QModelIndex &index) const {
+    if (!is_file(index)) {
+        return QModelIndex();
+    }
+    return index_of(group_of(index));
+}
+
+QModelIndex FilesModel::index_of(int group) const {
+    if (group < 0 || !keys.contains(group)) {
+        return QModelIndex();
+    }
+    return createIndex(position_of(group), 0, quintptr(0));
+}
+
+int FilesModel::rowCount(const QModelIndex &parent) const {
+    if (!parent.isValid()) {
+        return order.size();
+    }
+    if (is_file(parent)) {
+        return 0;
+    }
+    return fetched.value(group_at(parent.row()));
+}
+
+bool FilesModel::hasChildren(const QModelIndex &parent) const {
+    if (!parent.isValid()) {
+        return !order.empty();
+    }
+    if (is_file(parent)) {
+        return false;
+    }
+    return !scan_engine->group(group_at(parent.row())).files.empty();
+}
+
+bool FilesModel::canFetchMore(const QModelIndex &parent) const {
+    if (!parent.isValid() || is_file(parent)) {
+        return false;
+    }
+    int group = group_at(parent.row());
+    return fetched.value(group) < scan_engine->group(group).files.size();
+}
+
+void FilesModel::fetchMore(const QModelIndex &parent) {
+    if (!canFetchMore(parent)) { return; }
+    int group = group_at(parent.row());
+    int first = fetched.value(group);
+    int last = qMin(scan_engine->group(group).files.size(), first + fetch_batch) - 1;
+    beginInsertRows(parent, first, last);
+    fetched[group] = last + 1;
+    endInsertRows();
+}
+
+int FilesModel::columnCount(const QModelIndex &parent) const {
+    return 1;
+}
+
+// new groups are placed once the engine has them. Files reach the view
+// right away only while their group fits in its first fetch, the
+// others wait for fetchMore.
+void FilesModel::begin_insert(int parent, int first, int last) {
+    pending = Pending::None;
+    pending_group = parent;
+    pending_first = first;
+    pending_last = last;
+    if (parent < 0) {
+        pending = Pending::NewGroups;
+    } else if (keys.contains(parent) && fetched[parent] == first && last < fetch_batch) {
+        pending = Pending::Forwarded;
+        beginInsertRows(index_of(parent), first, last);
+        fetched[parent] = last + 1;
+    }
+}
+
+void FilesModel::end_insert() {
+    if (pending == Pending::NewGroups) {
+        for (int row = pending_first; row <= pending_last; row++) {
+            int group = scan_engine->group_at(row);
+            if (shown(group)) {
+                add_group(group);
+            }
+        }
+    } else if (pending == Pending::Forwarded) {
+        endInsertRows();
+    }
+    if (pending_group >= 0) {
+        reposition(pending_group);
+    }
+    pending = Pending::None;
+}
+
+// removed groups leave the view at once, removed files only if fetched
+void FilesModel::begin_remove(int parent, int first, int last) {
+    pending = Pending::None;
+    pending_group = parent;
+    if (parent < 0) {
+        for (int row = last; row >= first; row--) {
+            int group = scan_engine->group_at(row);
+            if (!keys.contains(group)) { continue; }
+            int position = position_of(group);
+            beginRemoveRows(QModelIndex(), position, position);
+            order.remove(position);
+            keys.remove(group);
+            fetched.remove(group);
+            endRemoveRows();
+        }
+        return;
+    }
+    if (!keys.contains(parent) || first >= fetched[parent]) { return; }
+
+    int fetched_last = qMin(last, fetched[parent] - 1);
+    pending = Pending::Forwarded;
+    beginRemoveRows(index_of(parent), first, fetched_last);
+    fetched[parent] -= fetched_last - first + 1;
+}
+
+void FilesModel::end_remove() {
+    if (pending == Pending::Forwarded) {
+        endRemoveRows();
+    }
+    if (pending_group >= 0) {
+        reposition(pending_group);
+    }
+    pending = Pending::None;
+}
+
+void FilesModel::begin_reset() {
+    beginResetModel();
+}
+
+void FilesModel::end_reset() {
+    rebuild();
+    endResetModel();
+}
+
+void FilesModel::group_changed(int group) {
+    reposition(group);
+    auto group_index = index_of(group);
+    if (group_index.isValid()) {
+        emit dataChanged(group_index, group_index);
+    }
+}
+
+void FilesModel::delete_file(QModelIndex const& index) {
+    if (!is_file(index)) { return; }
+    scan_engine->delete_file(group_of(index), index.row());
+}
+
+void FilesModel::delete_same(QModelIndex const& index) {
+    if (!is_file(index)) { return; }
+    scan_engine->delete_same(group_of(index), index.row());
+}
@@ -0,0 +1,98 @@
+#ifndef FILESMODEL_H
+#define FILESMODEL_H
+
+#include "scanengine.h"
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QVector>
+
+// tree view of the groups kept by ScanEngine. Groups are sorted by the
+// bytes deleting their copies would free, the unique files bucket comes
+// last if it is shown at all. Files of a group are fetched in batches as
+// the view scrolls to them.
+class FilesModel :public QAbstractItemModel, public EngineListener
+{
+    Q_OBJECT
+public:
+    FilesModel();
+    ~FilesModel() override;
+
+    ScanEngine* engine() const;
+
+    QVariant data(const QModelIndex &index, int role) const override;
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+
+    QModelIndex parent(const QModelIndex &index) const override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+
+    bool canFetchMore(const QModelIndex &parent) const override;
+
+    void fetchMore(const QModelIndex &parent) override;
+
+    bool is_file(QModelIndex const& index) const;
+    QString file_path(QModelIndex const& index) const;
+    // other names of the same data free nothing and cannot be deleted
+    bool deletable(QModelIndex const& index) const;
+    // groups of the selected group rows and files, without repeats
+    QVector<int> groups_of(QModelIndexList const& indexes) const;
+
+    void set_show_unique(bool show);
+
+    void begin_insert(int parent, int first, int last) override;
+    void end_insert() override;
+    void begin_remove(int parent, int first, int last) override;
+    void end_remove() override;
+    void begin_reset() override;
+    void end_reset() override;
+    void group_changed(int group) override;
+
+public slots:
+    void delete_file(QModelIndex const& index);
+    void delete_same(QModelIndex const& index);
+
+private:
+    // engine change being applied between a begin and its end
+    enum class Pending {
+        None,
+        Forwarded,
+        NewGroups
+    };
+
+    // groups are top level items with id 0, files carry the id of their group + 1
+    QModelIndex index_of(int group) const;
+    int group_of(QModelIndex const& index) const;
+    int group_at(int row) const;
+
+    // bytes the copies of the group take, -1 puts the unique bucket last
+    qint64 reclaimable(int group) const;
+    bool before(int first, int second) const;
+    int position_of(int group) const;
+    void add_group(int group);
+    // moves a group whose files changed to its place in the order
+    void reposition(int group);
+    bool shown(int group) const;
+    void rebuild();
+
+    ScanEngine* scan_engine;
+    bool show_unique;
+
+    // shown groups in order, the key each is sorted by and its fetched files
+    QVector<int> order;
+    QHash<int, qint64> keys;
+    QHash<int, int> fetched;
+
+    Pending pending;
+    int pending_group;
+    int pending_first;
+    int pending_last;
+};
+#endif // FILESMODEL_H
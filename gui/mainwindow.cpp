@@ -0,0 +1,595 @@
+#include "mainwindow.h"
+#include "ui_mainwindow.h"
+
+#include "filesmodel.h"
+
+#include <QDesktopServices>
+#include <QFileInfo>
+#include <QUrl>
+#include <QFileDialog>
+#include <QLocale>
+#include <QActionGroup>
+#include <QMessageBox>
+#include <QInputDialog>
+#include <QStandardPaths>
+
+#include <climits>
+
+const QString homePath = QDir::homePath();
+
+FindWorker::FindWorker(QObject *parent) : QObject (parent) {}
+
+
+MainWindow::MainWindow(QWidget *parent) :
+    QMainWindow(parent),
+    scan(false),
+    ui(new Ui::MainWindow)
+{
+    ui->setupUi(this);
+    listModel = new QFileSystemModel(this);
+    listModel->setFilter(QDir::QDir::AllEntries);
+    listModel->setRootPath(homePath);
+    ui->lvSource->setModel(listModel);
+    ui->lvSource->setRootIndex(listModel->index(homePath));
+
+    model = new FilesModel();
+    ui->treeView->setModel(model);
+
+    auto engine = model->engine();
+    connect(engine, &ScanEngine::end_scan, this, &MainWindow::set_progress_complete);
+    connect(engine, &ScanEngine::progress_update, this, &MainWindow::set_progress_update);
+    connect(this, &MainWindow::scan_roots, engine, &ScanEngine::start_scan);
+    connect(this, &MainWindow::abort_scan, engine, &ScanEngine::stop_scan);
+    connect(this, &MainWindow::delete_file, model, &FilesModel::delete_file);
+    connect(this, &MainWindow::delete_same, model, &FilesModel::delete_same);
+    connect(engine, &ScanEngine::telemetry_update, this, &MainWindow::show_telemetry);
+    connect(this, &MainWindow::reclaim, engine, &ScanEngine::reclaim);
+    connect(engine, &ScanEngine::reclaim_update, this, &MainWindow::set_reclaim_update);
+    connect(engine, &ScanEngine::reclaimed, this, &MainWindow::set_reclaim_complete);
+    connect(engine, &ScanEngine::index_updated, this, &MainWindow::set_index_updated);
+
+    ui->treeView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    ui->treeView->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(ui->treeView, &QTreeView::customContextMenuRequested, this, &MainWindow::getContextMenu);
+
+    ui->progressBar->reset();
+
+    label = new QLabel(statusBar());
+    statusBar()->addWidget(label);
+
+    connect(ui->btn_start, &QPushButton::clicked, this, &MainWindow::click_start);
+    connect(ui->btn_stop, &QPushButton::clicked, this, &MainWindow::click_stop);
+
+    ui->btn_stop->setEnabled(false);
+
+    options.cache_path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/hashes.cache";
+    create_telemetry_panel();
+    create_settings_menu();
+    create_profile_menu();
+}
+
+// hidden by default, the engine only counts while it is shown
+void MainWindow::create_telemetry_panel() {
+    telemetry_text = new QPlainTextEdit(this);
+    telemetry_text->setReadOnly(true);
+    telemetry_dock = new QDockWidget("Stage telemetry", this);
+    telemetry_dock->setWidget(telemetry_text);
+    addDockWidget(Qt::RightDockWidgetArea, telemetry_dock);
+    telemetry_dock->hide();
+
+    connect(telemetry_dock->toggleViewAction(), &QAction::toggled, this, [this](bool checked) {
+        options.telemetry_msecs = checked ? 500 : 0;
+        if (!scan) { // applied at start otherwise
+            model->engine()->set_options(options);
+        }
+    });
+}
+
+// the list view directory is always scanned, extra roots and the filter
+// come from here or from a saved profile
+void MainWindow::create_profile_menu() {
+    QMenu* menu = menuBar()->addMenu("Profile");
+
+    QAction* act_root = menu->addAction("Add this directory as a root");
+    connect(act_root, &QAction::triggered, this, [this]() {
+        QString dir = listModel->filePath(ui->lvSource->rootIndex());
+        if (!profile.roots.contains(dir)) {
+            profile.roots.push_back(dir);
+        }
+    });
+    QAction* act_clear = menu->addAction("Clear extra roots");
+    connect(act_clear, &QAction::triggered, this, [this]() {
+        profile.roots.clear();
+    });
+    menu->addSeparator();
+
+    auto edit_list = [this](QString const& title, QString const& hint, QStringList& list) {
+        bool ok;
+        QString text = QInputDialog::getText(this, title, hint, QLineEdit::Normal, list.join("; "), &ok);
+        if (!ok) { return; }
+        list.clear();
+        for (auto const& item : text.split(';', Qt::SkipEmptyParts)) {
+            if (!item.trimmed().isEmpty()) {
+                list.push_back(item.trimmed());
+            }
+        }
+    };
+    QAction* act_exclude = menu->addAction("Exclude...");
+    connect(act_exclude, &QAction::triggered, this, [this, edit_list]() {
+        edit_list("Exclude", "Globs separated by ';', with a '/' they match whole paths:", profile.filter.exclude);
+    });
+    QAction* act_include = menu->addAction("Include file names...");
+    connect(act_include, &QAction::triggered, this, [this, edit_list]() {
+        edit_list("Include", "Globs separated by ';', empty scans every file:", profile.filter.include);
+    });
+    QAction* act_ext = menu->addAction("Extensions...");
+    connect(act_ext, &QAction::triggered, this, [this, edit_list]() {
+        edit_list("Extensions", "Extensions separated by ';', empty scans every file:", profile.filter.extensions);
+    });
+    QAction* act_sizes = menu->addAction("Size limits...");
+    connect(act_sizes, &QAction::triggered, this, [this]() {
+        bool ok;
+        int min_bytes = QInputDialog::getInt(this, "Size limits", "Smallest file, bytes (0 takes empty files):",
+                                             int(qMin<qint64>(profile.filter.min_size, INT_MAX)), 0, INT_MAX, 1, &ok);
+        if (!ok) { return; }
+        int max_mb = QInputDialog::getInt(this, "Size limits", "Largest file, MB (0 for any):",
+                                          int(qMin<qint64>(profile.filter.max_size >> 20, INT_MAX)), 0, INT_MAX, 1, &ok);
+        if (!ok) { return; }
+        profile.filter.min_size = min_bytes;
+        profile.filter.max_size = qint64(max_mb) << 20;
+    });
+    QAction* act_device = menu->addAction("Stay on one file system");
+    act_device->setCheckable(true);
+    act_device->setChecked(profile.filter.one_file_system);
+    connect(act_device, &QAction::toggled, this, [this](bool checked) {
+        profile.filter.one_file_system = checked;
+    });
+    menu->addSeparator();
+
+    // readers and walkers hold where they are, the scan goes on when unchecked
+    act_pause = menu->addAction("Pause scan");
+    act_pause->setCheckable(true);
+    connect(act_pause, &QAction::toggled, this, [this](bool checked) {
+        if (checked) {
+            model->engine()->pause_scan();
+        } else {
+            model->engine()->resume_scan();
+        }
+    });
+    QAction* act_checkpoint = menu->addAction("Keep a checkpoint to resume from");
+    act_checkpoint->setCheckable(true);
+    connect(act_checkpoint, &QAction::toggled, this, [this](bool checked) {
+        options.checkpoint_path = checked
+                ? QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/scan.checkpoint"
+                : QString();
+    });
+    QAction* act_resume = menu->addAction("Resume last scan");
+    connect(act_resume, &QAction::triggered, this, &MainWindow::resume_scan);
+    menu->addSeparator();
+
+    QAction* act_load = menu->addAction("Load profile...");
+    connect(act_load, &QAction::triggered, this, [this, act_device]() {
+        QString path = QFileDialog::getOpenFileName(this, "Load profile", homePath, "Profiles (*.json)");
+        if (path.isEmpty()) { return; }
+        if (!profile.load(path)) {
+            QMessageBox::warning(this, "Load profile", "Cannot read " + path);
+        }
+        act_device->setChecked(profile.filter.one_file_system);
+    });
+    QAction* act_save = menu->addAction("Save profile...");
+    connect(act_save, &QAction::triggered, this, [this]() {
+        QString path = QFileDialog::getSaveFileName(this, "Save profile", homePath, "Profiles (*.json)");
+        if (!path.isEmpty() && !profile.save(path)) {
+            QMessageBox::warning(this, "Save profile", "Cannot write " + path);
+        }
+    });
+}
+
+void MainWindow::create_settings_menu() {
+    QMenu* menu = menuBar()->addMenu("Settings");
+
+    QActionGroup* digests = new QActionGroup(menu);
+    for (auto type : Digest::types()) {
+        QAction* act = menu->addAction(Digest::name(type));
+        act->setCheckable(true);
+        act->setChecked(type == options.digest);
+        digests->addAction(act);
+        connect(act, &QAction::triggered, this, [this, type]() {
+            options.digest = type;
+        });
+    }
+    menu->addSeparator();
+
+    QMenu* read_menu = menu->addMenu("Read files with");
+    QActionGroup* readers = new QActionGroup(read_menu);
+    for (auto strategy : FileReader::strategies()) {
+        QAction* act = read_menu->addAction(FileReader::name(strategy));
+        act->setCheckable(true);
+        act->setChecked(strategy == options.read_strategy);
+        act->setEnabled(FileReader::available(strategy));
+        readers->addAction(act);
+        connect(act, &QAction::triggered, this, [this, strategy]() {
+            options.read_strategy = strategy;
+        });
+    }
+
+    QAction* act_bytes = menu->addAction("Compare bytes instead of hashing");
+    act_bytes->setCheckable(true);
+    act_bytes->setChecked(options.compare_bytes);
+    connect(act_bytes, &QAction::toggled, this, [this](bool checked) {
+        options.compare_bytes = checked;
+    });
+
+    QAction* act_drop = menu->addAction("Drop page cache behind reads");
+    act_drop->setCheckable(true);
+    act_drop->setChecked(options.drop_cache);
+    connect(act_drop, &QAction::toggled, this, [this](bool checked) {
+        options.drop_cache = checked;
+    });
+
+    QAction* act_watch = menu->addAction("Watch for changes after scan");
+    act_watch->setCheckable(true);
+    act_watch->setChecked(options.watch);
+    connect(act_watch, &QAction::toggled, this, [this](bool checked) {
+        options.watch = checked;
+    });
+
+    QAction* act_dirs = menu->addAction("Group identical directories");
+    act_dirs->setCheckable(true);
+    act_dirs->setChecked(options.group_dirs);
+    connect(act_dirs, &QAction::toggled, this, [this](bool checked) {
+        options.group_dirs = checked;
+    });
+    menu->addSeparator();
+
+    QAction* act_verify = menu->addAction("Verify before delete or link");
+    act_verify->setCheckable(true);
+    act_verify->setChecked(options.verify_delete);
+    connect(act_verify, &QAction::toggled, this, [this](bool checked) {
+        options.verify_delete = checked;
+        if (!scan) { // applied at start otherwise
+            model->engine()->set_options(options);
+        }
+    });
+
+    QAction* act_dry = menu->addAction("Dry run: only count what would be freed");
+    act_dry->setCheckable(true);
+    act_dry->setChecked(options.dry_run);
+    connect(act_dry, &QAction::toggled, this, [this](bool checked) {
+        options.dry_run = checked;
+        if (!scan) {
+            model->engine()->set_options(options);
+        }
+    });
+
+    QAction* act_cache = menu->addAction("Use hash cache");
+    act_cache->setCheckable(true);
+    act_cache->setChecked(true);
+    connect(act_cache, &QAction::toggled, this, [this](bool checked) {
+        options.cache_path = checked
+                ? QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/hashes.cache"
+                : QString();
+    });
+
+    QAction* act_compact = menu->addAction("Compact hash cache after scan");
+    act_compact->setCheckable(true);
+    act_compact->setChecked(options.compact_cache);
+    connect(act_compact, &QAction::toggled, this, [this](bool checked) {
+        options.compact_cache = checked;
+    });
+
+    menu->addSeparator();
+    QAction* act_unique = menu->addAction("Show unique files");
+    act_unique->setCheckable(true);
+    act_unique->setChecked(true);
+    connect(act_unique, &QAction::toggled, model, &FilesModel::set_show_unique);
+    menu->addAction(telemetry_dock->toggleViewAction());
+
+    QAction* act_compare = menu->addAction("Compare digests");
+    connect(act_compare, &QAction::triggered, this, [this]() {
+        if (!scan) {
+            model->engine()->set_options(options);
+        }
+        model->engine()->compare_digests(listModel->filePath(ui->lvSource->rootIndex()));
+    });
+    connect(model->engine(), &ScanEngine::digests_compared, this, [this](QString const& report) {
+        QMessageBox::information(this, "Read and digest throughput", report);
+    });
+
+    QAction* act_chunks = menu->addAction("Find files sharing chunks");
+    connect(act_chunks, &QAction::triggered, this, [this]() {
+        auto engine = model->engine();
+        if (scan || engine->busy_reclaiming() || engine->busy_analyzing()) { return; }
+        engine->set_options(options);
+        engine->analyze_chunks();
+        if (!engine->busy_analyzing()) { return; } // no finished scan to chunk
+        ui->progressBar->setMinimum(0);
+        ui->progressBar->setMaximum(0);
+        label->setText("Chunking");
+        enable_buttons(false);
+    });
+    connect(model->engine(), &ScanEngine::chunks_update, this, [this](int done, int total, qint64 bytes) {
+        ui->progressBar->setMaximum(qMax(total, 1));
+        ui->progressBar->setValue(done);
+        label->setText("Chunking: " + QString::number(done) + " of " + QString::number(total)
+                       + " files, " + QLocale().formattedDataSize(bytes) + " read");
+    });
+    connect(model->engine(), &ScanEngine::chunks_analyzed, this, [this]() {
+        auto engine = model->engine();
+        auto report = engine->chunk_report(20);
+        ui->progressBar->setMaximum(1);
+        ui->progressBar->setValue(1);
+        enable_buttons(true);
+        QString text = QString::number(report.files) + " files chunked, "
+                + QLocale().formattedDataSize(report.bytes_savable) + " more could be freed by block level dedupe"
+                + (report.sample_shift > 0 ? " (estimated from 1 chunk in " + QString::number(qint64(1) << report.sample_shift) + ")"
+                                           : QString())
+                + "\n";
+        for (auto const& pair : report.pairs) {
+            text += "\n" + QLocale().formattedDataSize(pair.shared) + " shared by " + engine->file_path(pair.first)
+                    + " and " + engine->file_path(pair.second);
+        }
+        label->setText(QString::number(report.files) + " files chunked");
+        QMessageBox::information(this, "Files sharing chunks", text);
+    });
+}
+
+MainWindow::~MainWindow()
+{
+    delete ui;
+}
+
+void FindWorker::runFind(QString path)
+{
+    QDir curDir = QDir(path);
+
+}
+
+QByteArray FindWorker::fileChecksum(const QString &fileName, QCryptographicHash::Algorithm hashAlgorithm)
+{
+    QFile file(fileName);
+    if (file.open(QFile::ReadOnly)) {
+           QCryptographicHash hash(hashAlgorithm);
+           if (hash.addData(&file)) {
+               return hash.result();
+           }
+       }
+       return QByteArray();
+}
+
+
+void MainWindow::on_lvSource_doubleClicked(const QModelIndex &index)
+{
+    QListView* listView = qobject_cast<QListView*>(sender());
+    QFileInfo fileInfo = listModel->fileInfo(index);
+    if (fileInfo.fileName() == ".."){
+        QDir dir = fileInfo.dir();
+        dir.cdUp();
+        listView->setRootIndex(listModel->index(dir.absolutePath()));
+    }
+    else if(fileInfo.fileName() == "."){
+        listView->setRootIndex(listModel->index(homePath));
+    }
+    else if(fileInfo.isDir()){
+        listView->setRootIndex(index);
+    }
+}
+
+
+void MainWindow::enable_buttons(bool state) {
+    ui->btn_start->setEnabled(state);
+    ui->lvSource->setEnabled(state);
+    ui->btn_stop->setEnabled(!state);
+}
+
+void MainWindow::set_progress_complete(int count) {
+    ui->progressBar->setMinimum(0);
+    ui->progressBar->setMaximum(1);
+    ui->progressBar->setValue(1);
+
+    enable_buttons(true);
+    act_pause->setChecked(false);
+
+    auto const& stats = model->engine()->stats();
+    label->setText("Files scanned: " + QString::number(count)
+                   + " in " + QString::number(stats.scan_msecs) + " ms"
+                   + ", unique by size: " + QString::number(stats.size_unique)
+                   + ", by head/tail: " + QString::number(stats.partial_unique)
+                   + ", fully hashed: " + QString::number(stats.full_hashed)
+                   + ", cached: " + QString::number(stats.cache_hits)
+                   + ", walked: " + QString::number(stats.entries_walked * 1000 / qMax<qint64>(stats.walk_msecs, 1))
+                   + " entries/s"
+                   + ", not read: " + QLocale().formattedDataSize(stats.bytes_skipped())
+                   + (stats.bytes_hash_path > 0
+                      ? ", hashing would read: " + QLocale().formattedDataSize(stats.bytes_hash_path) : QString())
+                   + ", hard links: " + QString::number(stats.hardlinks)
+                   + ", shared extents: " + QString::number(stats.shared_extents)
+                   + (stats.dir_groups > 0 ? ", directory groups: " + QString::number(stats.dir_groups)
+                      + ", file groups collapsed: " + QString::number(stats.groups_collapsed) : QString())
+                   + ", pruned: " + QString::number(stats.entries_pruned)
+                   + " entries, " + QLocale().formattedDataSize(stats.bytes_pruned)
+                   + ", " + QString::number(stats.record_bytes / qMax<qint64>(stats.records, 1)) + " bytes per file"
+                   + (stats.dirs_unwatched > 0 ? ", directories not watched: " + QString::number(stats.dirs_unwatched)
+                      + " (" + model->engine()->watch_error() + ")" : QString()));
+
+    scan = false;
+    ui->btn_stop->setEnabled(model->engine()->watching()); // stops watching
+}
+
+void MainWindow::set_index_updated(int count) {
+    auto const& stats = model->engine()->stats();
+    label->setText("Watching: " + QString::number(count) + " files"
+                   + ", changed: " + QString::number(stats.files_changed)
+                   + ", removed: " + QString::number(stats.files_removed)
+                   + (stats.dirs_unwatched > 0 ? ", not watched: " + QString::number(stats.dirs_unwatched) : QString()));
+}
+
+void MainWindow::set_progress_update(int count) {
+    label->setText("Files scanned: " + QString::number(count));
+}
+
+void MainWindow::click_start() {
+    QString dir = listModel->filePath(ui->lvSource->rootIndex());
+    options.filter = profile.filter;
+    start_scan(QStringList(dir) + profile.roots);
+}
+
+void MainWindow::start_scan(QStringList const& roots) {
+    ui->progressBar->setMinimum(0);
+    ui->progressBar->setMaximum(0);
+
+    label->setText("Files scanned: 0");
+    enable_buttons(false);
+    act_pause->setChecked(false);
+
+    model->engine()->set_options(options);
+    emit scan_roots(roots);
+    scan = true;
+}
+
+// the scan is redone as it was saved, files it hashed are not read again
+void MainWindow::resume_scan() {
+    if (scan) { return; }
+    QString path = options.checkpoint_path.isEmpty()
+            ? QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/scan.checkpoint"
+            : options.checkpoint_path;
+    ScanCheckpoint checkpoint;
+    if (!checkpoint.load(path)) {
+        QMessageBox::warning(this, "Resume scan", "No checkpoint in " + path);
+        return;
+    }
+    options.checkpoint_path = path;
+    options.cache_path = checkpoint.cache_path;
+    options.digest = checkpoint.digest;
+    options.block_size = checkpoint.block_size;
+    options.partial_min_size = checkpoint.partial_min_size;
+    options.filter = checkpoint.profile.filter;
+    start_scan(checkpoint.profile.roots);
+}
+
+void MainWindow::click_stop() {
+    act_pause->setChecked(false);
+    emit abort_scan();
+    ui->progressBar->setMaximum(1);
+    ui->progressBar->reset();
+
+    enable_buttons(true);
+
+    scan = false;
+}
+
+// the stop button cancels the files not yet done
+void MainWindow::start_reclaim() {
+    ui->progressBar->setMinimum(0);
+    ui->progressBar->setMaximum(0);
+    label->setText("Reclaiming");
+    enable_buttons(false);
+}
+
+void MainWindow::set_reclaim_update(int done, int total, qint64 bytes) {
+    ui->progressBar->setMaximum(qMax(total, 1));
+    ui->progressBar->setValue(done);
+    label->setText("Reclaiming: " + QString::number(done) + " of " + QString::number(total)
+                   + " files, " + QLocale().formattedDataSize(bytes) + " freed");
+}
+
+void MainWindow::set_reclaim_complete(int files, int failed, qint64 bytes, bool dry_run) {
+    ui->progressBar->setMaximum(1);
+    ui->progressBar->setValue(1);
+    enable_buttons(true);
+    label->setText((dry_run ? "Dry run: " + QString::number(files) + " files would free "
+                            : QString::number(files) + " files done, freed ")
+                   + QLocale().formattedDataSize(bytes)
+                   + (failed > 0 ? ", " + QString::number(failed) + " failed or differing" : QString()));
+}
+
+void MainWindow::getContextMenu(QPoint const& pos) {
+    QModelIndex index = ui->treeView->indexAt(pos);
+    if (!index.isValid()) { return; }
+
+    QMenu* menu = new QMenu(ui->treeView);
+    bool idle = !scan && !model->engine()->busy_reclaiming() && !model->engine()->busy_analyzing();
+    auto groups = model->groups_of(ui->treeView->selectionModel()->selectedIndexes());
+    if (groups.empty()) {
+        groups = model->groups_of({index});
+    }
+    QMenu* reclaim_menu = menu->addMenu("Reclaim selected groups");
+    reclaim_menu->setEnabled(idle);
+    for (auto action : {ReclaimAction::Delete, ReclaimAction::Hardlink, ReclaimAction::Dedupe}) {
+        QAction* act = reclaim_menu->addAction(Reclaimer::name(action));
+        connect(act, &QAction::triggered, this, [this, groups, action]() {
+            start_reclaim();
+            emit reclaim(groups, action);
+        });
+    }
+    if (!model->is_file(index)) {
+        menu->exec(ui->treeView->mapToGlobal(pos));
+        return;
+    }
+    menu->addSeparator();
+
+    QString filename = model->file_path(index);
+    QAction* act_open = menu->addAction("Open file");
+    connect(act_open, &QAction::triggered, this, [filename](){
+        QDesktopServices::openUrl(QUrl(filename));
+    });
+
+    QAction* act_folder = menu->addAction("Open folder");
+    connect(act_folder, &QAction::triggered, this, [filename](){
+        QFileInfo info(filename);
+        QDesktopServices::openUrl(QUrl(info.absolutePath()));
+    });
+
+    QAction* act_delete = menu->addAction("Delete file");
+    connect(act_delete, &QAction::triggered, this, [this, index]() {
+        start_reclaim();
+        emit this->delete_file(index);
+    });
+
+
+    QAction* act_delete_same = menu->addAction("Delete same except this");
+    connect(act_delete_same, &QAction::triggered, this, [this, index]() {
+        start_reclaim();
+        emit this->delete_same(index);
+    });
+
+    if (!idle || !model->deletable(index)) {
+        act_delete->setEnabled(false);
+        act_delete_same->setEnabled(false);
+    }
+
+    menu->exec(ui->treeView->mapToGlobal(pos));
+}
+
+
+void MainWindow::show_telemetry(QJsonObject const& report) {
+    auto walk = report["walk"].toObject();
+    auto hash = report["hash"].toObject();
+    auto apply = report["apply"].toObject();
+    auto queues = report["queues"].toObject();
+    auto number = [](QJsonValue const& value) {
+        return QString::number(qint64(value.toDouble()));
+    };
+    auto latency = [&](QJsonObject const& histogram) {
+        return "p50 " + number(histogram["p50_us"]) + " us"
+                + ", p90 " + number(histogram["p90_us"]) + " us"
+                + ", p99 " + number(histogram["p99_us"]) + " us";
+    };
+
+    QStringList lines;
+    lines << "Walk: " + number(walk["files"]) + " files, "
+             + number(walk["files_per_s"]) + " files/s";
+    lines << "Hash: " + number(hash["files"]) + " files, "
+             + QLocale().formattedDataSize(qint64(hash["bytes_per_s"].toDouble())) + "/s";
+    lines << "  waiting for I/O " + number(hash["io_msecs"]) + " ms, hashing "
+             + number(hash["cpu_msecs"]) + " ms";
+    lines << "  per file " + latency(hash["latency"].toObject());
+    lines << "Apply: " + number(apply["files"]) + " files, "
+             + number(apply["files_per_s"]) + " files/s";
+    lines << "  per batch " + latency(apply["latency"].toObject());
+    lines << "Queued: " + number(queues["result_ring"]) + " results, "
+             + number(queues["hash_queue"]) + " to hash, "
+             + number(queues["compare_buckets"]) + " buckets to compare";
+    lines << "In flight: " + number(report["in_flight"]) + " files";
+    telemetry_text->setPlainText(lines.join('\n'));
+}
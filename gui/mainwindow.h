@@ -8,11 +8,20 @@
 #include <QFileInfo>
 #include <QCryptographicHash>
 #include <QLabel>
+#include <QDockWidget>
+#include <QJsonObject>
+#include <QPlainTextEdit>
+
+#include "scanoptions.h"
+#include "reclaimer.h"
+#include "scanprofile.h"
 
 namespace Ui {
 class MainWindow;
 }
 
+class FilesModel;
+
 class FindWorker : public QObject{
     Q_OBJECT
 
@@ -43,22 +52,40 @@ public slots:
     void on_lvSource_doubleClicked(const QModelIndex &index);
     void set_progress_complete(int count);
     void set_progress_update(int count);
+    void set_index_updated(int count);
     void click_start();
     void click_stop();
     void getContextMenu(QPoint const& pos);
+    void show_telemetry(QJsonObject const& report);
+    void set_reclaim_update(int done, int total, qint64 bytes);
+    void set_reclaim_complete(int files, int failed, qint64 bytes, bool dry_run);
 
 signals:
-    void scan_directory(QString const& dir);
+    void scan_roots(QStringList const& roots);
     void abort_scan();
     void delete_file(QModelIndex const& index);
     void delete_same(QModelIndex const& index);
+    void reclaim(QVector<int> const& groups, ReclaimAction action);
 
 private:
     bool scan;
     Ui::MainWindow *ui;
     QLabel* label;
+    QAction* act_pause;
+    QDockWidget* telemetry_dock;
+    QPlainTextEdit* telemetry_text;
     QFileSystemModel *listModel;
+    FilesModel* model;
+    ScanOptions options;
+    // extra roots and the filter of the next scan
+    ScanProfile profile;
     void enable_buttons(bool state);
+    void start_scan(QStringList const& roots);
+    void resume_scan();
+    void start_reclaim();
+    void create_settings_menu();
+    void create_profile_menu();
+    void create_telemetry_panel();
 };
 
 #endif // MAINWINDOW_H